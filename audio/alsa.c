@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <alsa/asoundlib.h>
 #include "../general.h"
+#include "alsa_mmap.h"
 
 #define TRY_ALSA(x) if (x < 0) { \
                   goto error; \
@@ -31,6 +32,8 @@ typedef struct alsa
    bool has_float;
    bool can_pause;
    bool is_paused;
+   bool mmap;
+   snd_pcm_uframes_t buffer_frames;
 } alsa_t;
 
 static bool alsa_use_float(void *data)
@@ -64,6 +67,7 @@ static void *alsa_init(const char *device, unsigned rate, unsigned latency)
    unsigned channels = 2;
    unsigned periods = 4;
    snd_pcm_format_t format;
+   int access;
 
    const char *alsa_dev = "default";
    if (device)
@@ -77,7 +81,9 @@ static void *alsa_init(const char *device, unsigned rate, unsigned latency)
    format = alsa->has_float ? SND_PCM_FORMAT_FLOAT : SND_PCM_FORMAT_S16;
 
    TRY_ALSA(snd_pcm_hw_params_any(alsa->pcm, params));
-   TRY_ALSA(snd_pcm_hw_params_set_access(alsa->pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED));
+   access = alsa_mmap_set_access(alsa->pcm, params, g_settings.audio.mmap);
+   TRY_ALSA(access);
+   alsa->mmap = access > 0;
    TRY_ALSA(snd_pcm_hw_params_set_format(alsa->pcm, params, format));
    TRY_ALSA(snd_pcm_hw_params_set_channels(alsa->pcm, params, channels));
    TRY_ALSA(snd_pcm_hw_params_set_rate(alsa->pcm, params, rate, 0));
@@ -94,6 +100,7 @@ static void *alsa_init(const char *device, unsigned rate, unsigned latency)
    if (snd_pcm_hw_params_get_buffer_size(params, &buffer_size))
       snd_pcm_hw_params_get_buffer_size_max(params, &buffer_size);
    RARCH_LOG("ALSA: Buffer size: %d frames\n", (int)buffer_size);
+   alsa->buffer_frames = buffer_size;
    alsa->buffer_size = snd_pcm_frames_to_bytes(alsa->pcm, buffer_size);
    alsa->can_pause = snd_pcm_hw_params_can_pause(params);
    RARCH_LOG("ALSA: Can pause: %s.\n", alsa->can_pause ? "yes" : "no");
@@ -135,6 +142,12 @@ static ssize_t alsa_write(void *data, const void *buf_, size_t size_)
    snd_pcm_sframes_t written = 0;
    snd_pcm_sframes_t size    = snd_pcm_bytes_to_frames(alsa->pcm, size_);
 
+   if (alsa->mmap)
+   {
+      written = alsa_mmap_write(alsa->pcm, buf, size, alsa->buffer_frames, alsa->nonblock);
+      return written < 0 ? -1 : snd_pcm_frames_to_bytes(alsa->pcm, written);
+   }
+
    while (size)
    {
       if (!alsa->nonblock)
@@ -259,6 +272,10 @@ static size_t alsa_write_avail(void *data)
 {
    alsa_t *alsa = data;
 
+   if (alsa->mmap)
+      return snd_pcm_frames_to_bytes(alsa->pcm,
+            alsa_mmap_write_avail(alsa->pcm, alsa->buffer_frames));
+
    snd_pcm_sframes_t avail = snd_pcm_avail(alsa->pcm);
    if (avail < 0)
    {
@@ -0,0 +1,139 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alsa_mmap.h"
+#include "../general.h"
+#include <string.h>
+
+int alsa_mmap_set_access(snd_pcm_t *pcm, snd_pcm_hw_params_t *params, bool want_mmap)
+{
+   if (want_mmap)
+   {
+      if (snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0)
+      {
+         RARCH_LOG("ALSA: Using mmap transfers.\n");
+         return 1;
+      }
+      RARCH_WARN("ALSA: Device does not support mmap access, falling back to regular writes.\n");
+   }
+
+   int err = snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+   return err < 0 ? err : 0;
+}
+
+static snd_pcm_sframes_t alsa_mmap_avail(snd_pcm_t *pcm, snd_pcm_uframes_t buffer_frames)
+{
+   snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+   if (avail < 0)
+      return avail;
+
+   // Free-running PCM has played past the application pointer (underrun).
+   // Skip over the stale part so new data is next in line to be played.
+   if ((snd_pcm_uframes_t)avail > buffer_frames)
+   {
+      snd_pcm_forward(pcm, avail - buffer_frames);
+      avail = buffer_frames;
+   }
+
+   return avail;
+}
+
+snd_pcm_uframes_t alsa_mmap_write_avail(snd_pcm_t *pcm, snd_pcm_uframes_t buffer_frames)
+{
+   snd_pcm_sframes_t avail = alsa_mmap_avail(pcm, buffer_frames);
+   return avail < 0 ? buffer_frames : (snd_pcm_uframes_t)avail;
+}
+
+snd_pcm_sframes_t alsa_mmap_write(snd_pcm_t *pcm, const void *buf_,
+      snd_pcm_uframes_t frames, snd_pcm_uframes_t buffer_frames, bool nonblock)
+{
+   const uint8_t *buf = buf_;
+   size_t frame_size = snd_pcm_frames_to_bytes(pcm, 1);
+   snd_pcm_uframes_t written = 0;
+
+   while (written < frames)
+   {
+      snd_pcm_sframes_t avail = alsa_mmap_avail(pcm, buffer_frames);
+      if (avail < 0)
+      {
+         if (snd_pcm_recover(pcm, avail, 1) < 0)
+         {
+            RARCH_ERR("[ALSA]: (#1) Failed to recover from error (%s)\n",
+                  snd_strerror(avail));
+            return -1;
+         }
+         continue;
+      }
+
+      if (avail == 0)
+      {
+         if (nonblock)
+            break;
+
+         int rc = snd_pcm_wait(pcm, -1);
+         if (rc < 0 && snd_pcm_recover(pcm, rc, 1) < 0)
+         {
+            RARCH_ERR("[ALSA]: (#2) Failed to recover from error (%s)\n",
+                  snd_strerror(rc));
+            return -1;
+         }
+         continue;
+      }
+
+      const snd_pcm_channel_area_t *areas = NULL;
+      snd_pcm_uframes_t offset = 0;
+      snd_pcm_uframes_t chunk = min(frames - written, (snd_pcm_uframes_t)avail);
+
+      int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &chunk);
+      if (err < 0)
+      {
+         if (snd_pcm_recover(pcm, err, 1) < 0)
+         {
+            RARCH_ERR("[ALSA]: (#3) Failed to recover from error (%s)\n",
+                  snd_strerror(err));
+            return -1;
+         }
+         continue;
+      }
+
+      // Interleaved, so the first channel area describes the whole frame.
+      uint8_t *dst = (uint8_t*)areas[0].addr + (areas[0].first >> 3) + offset * (areas[0].step >> 3);
+      memcpy(dst, buf + written * frame_size, chunk * frame_size);
+
+      snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm, offset, chunk);
+      if (committed < 0 || (snd_pcm_uframes_t)committed != chunk)
+      {
+         if (snd_pcm_recover(pcm, committed >= 0 ? -EPIPE : committed, 1) < 0)
+         {
+            RARCH_ERR("[ALSA]: (#4) Failed to recover from error (%s)\n",
+                  snd_strerror(committed));
+            return -1;
+         }
+         continue;
+      }
+
+      written += chunk;
+
+      // Unlike snd_pcm_writei(), committing does not trigger the start threshold.
+      if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED)
+      {
+         snd_pcm_sframes_t left = snd_pcm_avail_update(pcm);
+         if (left >= 0 && buffer_frames - left >= buffer_frames / 2)
+            snd_pcm_start(pcm);
+      }
+   }
+
+   return written;
+}
@@ -0,0 +1,37 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RARCH_ALSA_MMAP_H__
+#define RARCH_ALSA_MMAP_H__
+
+#include <stdbool.h>
+#include <alsa/asoundlib.h>
+
+// Selects interleaved mmap access if asked for and supported, otherwise regular read/write access.
+// Returns 1 if mmap access was selected, 0 for read/write access, or a negative error code.
+int alsa_mmap_set_access(snd_pcm_t *pcm, snd_pcm_hw_params_t *params, bool want_mmap);
+
+// Copies frames straight into the device ring buffer with snd_pcm_mmap_begin()/commit().
+// The PCM is started once half of buffer_frames is queued. If the PCM is set up to free-run
+// through underruns (stop_threshold == boundary), the application pointer is moved past
+// what has already been played.
+// Returns number of frames written, or a negative value on unrecoverable error.
+snd_pcm_sframes_t alsa_mmap_write(snd_pcm_t *pcm, const void *buf,
+      snd_pcm_uframes_t frames, snd_pcm_uframes_t buffer_frames, bool nonblock);
+
+// Number of frames which can be written without blocking.
+snd_pcm_uframes_t alsa_mmap_write_avail(snd_pcm_t *pcm, snd_pcm_uframes_t buffer_frames);
+
+#endif
@@ -21,6 +21,7 @@
 #include "../general.h"
 #include "../thread.h"
 #include "../fifo_buffer.h"
+#include "alsa_mmap.h"
 
 #define TRY_ALSA(x) if (x < 0) { \
                   goto error; \
@@ -33,6 +34,11 @@ typedef struct alsa_thread
    bool has_float;
    volatile bool thread_dead;
 
+   // In mmap mode, writes go straight into the device ring buffer,
+   // which free-runs and plays silence on underrun. No fifo or worker thread is used.
+   bool mmap;
+   snd_pcm_uframes_t buffer_frames;
+
    size_t buffer_size;
    size_t period_size;
    snd_pcm_uframes_t period_frames;
@@ -158,7 +164,9 @@ static void *alsa_thread_init(const char *device, unsigned rate, unsigned latenc
    unsigned channels = 2;
    unsigned periods = 4;
    snd_pcm_uframes_t buffer_size;
+   snd_pcm_uframes_t boundary;
    snd_pcm_format_t format;
+   int access;
 
    TRY_ALSA(snd_pcm_open(&alsa->pcm, alsa_dev, SND_PCM_STREAM_PLAYBACK, 0));
 
@@ -167,7 +175,9 @@ static void *alsa_thread_init(const char *device, unsigned rate, unsigned latenc
    format = alsa->has_float ? SND_PCM_FORMAT_FLOAT : SND_PCM_FORMAT_S16;
 
    TRY_ALSA(snd_pcm_hw_params_any(alsa->pcm, params));
-   TRY_ALSA(snd_pcm_hw_params_set_access(alsa->pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED));
+   access = alsa_mmap_set_access(alsa->pcm, params, g_settings.audio.mmap);
+   TRY_ALSA(access);
+   alsa->mmap = access > 0;
    TRY_ALSA(snd_pcm_hw_params_set_format(alsa->pcm, params, format));
    TRY_ALSA(snd_pcm_hw_params_set_channels(alsa->pcm, params, channels));
    TRY_ALSA(snd_pcm_hw_params_set_rate(alsa->pcm, params, rate, 0));
@@ -185,17 +195,32 @@ static void *alsa_thread_init(const char *device, unsigned rate, unsigned latenc
       snd_pcm_hw_params_get_buffer_size_max(params, &buffer_size);
    RARCH_LOG("ALSA: Buffer size: %d frames\n", (int)buffer_size);
 
+   alsa->buffer_frames = buffer_size;
    alsa->buffer_size = snd_pcm_frames_to_bytes(alsa->pcm, buffer_size);
    alsa->period_size = snd_pcm_frames_to_bytes(alsa->pcm, alsa->period_frames);
 
    TRY_ALSA(snd_pcm_sw_params_malloc(&sw_params));
    TRY_ALSA(snd_pcm_sw_params_current(alsa->pcm, sw_params));
    TRY_ALSA(snd_pcm_sw_params_set_start_threshold(alsa->pcm, sw_params, buffer_size / 2));
+
+   if (alsa->mmap)
+   {
+      // Never stop on underrun, and let ALSA fill played out parts with silence.
+      // This replaces the silence padding done by the worker thread.
+      TRY_ALSA(snd_pcm_sw_params_get_boundary(sw_params, &boundary));
+      TRY_ALSA(snd_pcm_sw_params_set_stop_threshold(alsa->pcm, sw_params, boundary));
+      TRY_ALSA(snd_pcm_sw_params_set_silence_threshold(alsa->pcm, sw_params, 0));
+      TRY_ALSA(snd_pcm_sw_params_set_silence_size(alsa->pcm, sw_params, boundary));
+   }
+
    TRY_ALSA(snd_pcm_sw_params(alsa->pcm, sw_params));
 
    snd_pcm_hw_params_free(params);
    snd_pcm_sw_params_free(sw_params);
 
+   if (alsa->mmap)
+      return alsa;
+
    alsa->fifo_lock = slock_new();
    alsa->cond_lock = slock_new();
    alsa->cond = scond_new();
@@ -232,6 +257,18 @@ static ssize_t alsa_thread_write(void *data, const void *buf, size_t size)
    if (alsa->thread_dead)
       return -1;
 
+   if (alsa->mmap)
+   {
+      snd_pcm_sframes_t written = alsa_mmap_write(alsa->pcm, buf,
+            snd_pcm_bytes_to_frames(alsa->pcm, size), alsa->buffer_frames, alsa->nonblock);
+      if (written < 0)
+      {
+         alsa->thread_dead = true;
+         return -1;
+      }
+      return snd_pcm_frames_to_bytes(alsa->pcm, written);
+   }
+
    if (alsa->nonblock)
    {
       slock_lock(alsa->fifo_lock);
@@ -293,6 +330,11 @@ static size_t alsa_thread_write_avail(void *data)
 
    if (alsa->thread_dead)
       return 0;
+
+   if (alsa->mmap)
+      return snd_pcm_frames_to_bytes(alsa->pcm,
+            alsa_mmap_write_avail(alsa->pcm, alsa->buffer_frames));
+
    slock_lock(alsa->fifo_lock);
    size_t val = fifo_write_avail(alsa->buffer);
    slock_unlock(alsa->fifo_lock);
@@ -19,6 +19,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define REVERB_SIMD
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define REVERB_SIMD
+#endif
+
 struct comb
 {
    float *buffer;
@@ -297,8 +305,306 @@ static const struct dspfilter_implementation reverb_plug = {
    "reverb",
 };
 
+#ifdef REVERB_SIMD
+// Block based stereo variant of the model above for SSE and NEON.
+// Left and right channels use identical tunings, so every delay line stores both
+// channels interleaved. Combs are run in pairs, giving four lanes per vector:
+// { comb n left, comb n right, comb n + 1 left, comb n + 1 right }.
+// Input is processed in blocks which end before any delay line wraps around,
+// so the inner loop is free of index bookkeeping.
+
+static const unsigned combtuning[numcombs] = {
+   combtuningL1, combtuningL2, combtuningL3, combtuningL4,
+   combtuningL5, combtuningL6, combtuningL7, combtuningL8,
+};
+
+static const unsigned allpasstuning[numallpasses] = {
+   allpasstuningL1, allpasstuningL2, allpasstuningL3, allpasstuningL4,
+};
+
+struct delayline
+{
+   float *buffer;
+   unsigned bufsize;
+   unsigned bufidx;
+};
+
+struct reverb_simd_data
+{
+   struct delayline comb[numcombs];
+   struct delayline allpass[numallpasses];
+   float filterstore[2 * numcombs];
+
+   float gain;
+   float feedback;
+   float damp1, damp2;
+   float dry, wet1;
+
+   float *buffers;
+};
+
+static void reverb_simd_free(void *data)
+{
+   struct reverb_simd_data *rev = data;
+   if (!rev)
+      return;
+
+   free(rev->buffers);
+   free(rev);
+}
+
+static void *reverb_simd_init(const struct dspfilter_info *info,
+      const struct dspfilter_config *config, void *userdata)
+{
+   struct reverb_simd_data *rev = calloc(1, sizeof(*rev));
+   if (!rev)
+      return NULL;
+
+   unsigned total = 0;
+   for (unsigned i = 0; i < numcombs; i++)
+      total += combtuning[i];
+   for (unsigned i = 0; i < numallpasses; i++)
+      total += allpasstuning[i];
+
+   rev->buffers = calloc(2 * total, sizeof(float));
+   if (!rev->buffers)
+   {
+      free(rev);
+      return NULL;
+   }
+
+   float *buf = rev->buffers;
+   for (unsigned i = 0; i < numcombs; i++)
+   {
+      rev->comb[i].buffer = buf;
+      rev->comb[i].bufsize = combtuning[i];
+      buf += 2 * combtuning[i];
+   }
+
+   for (unsigned i = 0; i < numallpasses; i++)
+   {
+      rev->allpass[i].buffer = buf;
+      rev->allpass[i].bufsize = allpasstuning[i];
+      buf += 2 * allpasstuning[i];
+   }
+
+   float drytime, wettime, damping, roomwidth, roomsize;
+   config->get_float(userdata, "drytime", &drytime, 0.43f);
+   config->get_float(userdata, "wettime", &wettime, 0.4f);
+   config->get_float(userdata, "damping", &damping, 0.8f);
+   config->get_float(userdata, "roomwidth", &roomwidth, 0.56f);
+   config->get_float(userdata, "roomsize", &roomsize, 0.56f);
+
+   // Same parameter mapping as revmodel_update(). Freeze mode is never enabled.
+   rev->gain = fixedgain;
+   rev->feedback = roomsize * scaleroom + offsetroom;
+   rev->damp1 = damping * scaledamp;
+   rev->damp2 = 1.0f - rev->damp1;
+   rev->dry = drytime * scaledry;
+   rev->wet1 = wettime * scalewet * (roomwidth / 2.0f + 0.5f);
+
+   return rev;
+}
+
+static unsigned reverb_simd_block_frames(const struct reverb_simd_data *rev, unsigned frames)
+{
+   for (unsigned i = 0; i < numcombs; i++)
+   {
+      unsigned left = rev->comb[i].bufsize - rev->comb[i].bufidx;
+      if (left < frames)
+         frames = left;
+   }
+
+   for (unsigned i = 0; i < numallpasses; i++)
+   {
+      unsigned left = rev->allpass[i].bufsize - rev->allpass[i].bufidx;
+      if (left < frames)
+         frames = left;
+   }
+
+   return frames;
+}
+
+static inline void delayline_advance(struct delayline *line, unsigned frames)
+{
+   line->bufidx += frames;
+   if (line->bufidx >= line->bufsize)
+      line->bufidx = 0;
+}
+
+#if defined(__SSE__)
+static void reverb_block_sse(struct reverb_simd_data *rev, float *out, unsigned frames)
+{
+   float *comb[numcombs];
+   float *allpass[numallpasses];
+   __m128 filterstore[numcombs / 2];
+
+   for (unsigned i = 0; i < numcombs; i++)
+      comb[i] = rev->comb[i].buffer + 2 * rev->comb[i].bufidx;
+   for (unsigned i = 0; i < numallpasses; i++)
+      allpass[i] = rev->allpass[i].buffer + 2 * rev->allpass[i].bufidx;
+   for (unsigned i = 0; i < numcombs / 2; i++)
+      filterstore[i] = _mm_loadu_ps(rev->filterstore + 4 * i);
+
+   const __m128 zero     = _mm_setzero_ps();
+   const __m128 gain     = _mm_set1_ps(rev->gain);
+   const __m128 feedback = _mm_set1_ps(rev->feedback);
+   const __m128 damp1    = _mm_set1_ps(rev->damp1);
+   const __m128 damp2    = _mm_set1_ps(rev->damp2);
+   const __m128 dry      = _mm_set1_ps(rev->dry);
+   const __m128 wet1     = _mm_set1_ps(rev->wet1);
+   const __m128 half     = _mm_set1_ps(0.5f);
+
+   for (unsigned f = 0; f < frames; f++, out += 2)
+   {
+      __m128 in = _mm_loadl_pi(zero, (const __m64*)out);
+      __m128 input = _mm_mul_ps(_mm_movelh_ps(in, in), gain);
+      __m128 sum = zero;
+
+      for (unsigned i = 0; i < numcombs / 2; i++)
+      {
+         __m64 *lo = (__m64*)(comb[2 * i + 0] + 2 * f);
+         __m64 *hi = (__m64*)(comb[2 * i + 1] + 2 * f);
+
+         __m128 output = _mm_loadh_pi(_mm_loadl_pi(zero, lo), hi);
+         filterstore[i] = _mm_add_ps(_mm_mul_ps(output, damp2),
+               _mm_mul_ps(filterstore[i], damp1));
+
+         __m128 store = _mm_add_ps(input, _mm_mul_ps(filterstore[i], feedback));
+         _mm_storel_pi(lo, store);
+         _mm_storeh_pi(hi, store);
+
+         sum = _mm_add_ps(sum, output);
+      }
+
+      // Fold comb pairs, only the lower two lanes are used from here on.
+      sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+
+      for (unsigned i = 0; i < numallpasses; i++)
+      {
+         __m64 *line = (__m64*)(allpass[i] + 2 * f);
+         __m128 bufout = _mm_loadl_pi(zero, line);
+         _mm_storel_pi(line, _mm_add_ps(sum, _mm_mul_ps(bufout, half)));
+         sum = _mm_sub_ps(bufout, sum);
+      }
+
+      __m128 res = _mm_add_ps(_mm_mul_ps(in, dry), _mm_mul_ps(sum, wet1));
+      _mm_storel_pi((__m64*)out, res);
+   }
+
+   for (unsigned i = 0; i < numcombs / 2; i++)
+      _mm_storeu_ps(rev->filterstore + 4 * i, filterstore[i]);
+}
+#define reverb_block reverb_block_sse
+#elif defined(__ARM_NEON__)
+static void reverb_block_neon(struct reverb_simd_data *rev, float *out, unsigned frames)
+{
+   float *comb[numcombs];
+   float *allpass[numallpasses];
+   float32x4_t filterstore[numcombs / 2];
+
+   for (unsigned i = 0; i < numcombs; i++)
+      comb[i] = rev->comb[i].buffer + 2 * rev->comb[i].bufidx;
+   for (unsigned i = 0; i < numallpasses; i++)
+      allpass[i] = rev->allpass[i].buffer + 2 * rev->allpass[i].bufidx;
+   for (unsigned i = 0; i < numcombs / 2; i++)
+      filterstore[i] = vld1q_f32(rev->filterstore + 4 * i);
+
+   const float32x4_t gain     = vdupq_n_f32(rev->gain);
+   const float32x4_t feedback = vdupq_n_f32(rev->feedback);
+   const float32x4_t damp1    = vdupq_n_f32(rev->damp1);
+   const float32x4_t damp2    = vdupq_n_f32(rev->damp2);
+   const float32x2_t dry      = vdup_n_f32(rev->dry);
+   const float32x2_t wet1     = vdup_n_f32(rev->wet1);
+   const float32x2_t half     = vdup_n_f32(0.5f);
+
+   for (unsigned f = 0; f < frames; f++, out += 2)
+   {
+      float32x2_t in = vld1_f32(out);
+      float32x4_t input = vmulq_f32(vcombine_f32(in, in), gain);
+      float32x4_t sum = vdupq_n_f32(0.0f);
+
+      for (unsigned i = 0; i < numcombs / 2; i++)
+      {
+         float *lo = comb[2 * i + 0] + 2 * f;
+         float *hi = comb[2 * i + 1] + 2 * f;
+
+         float32x4_t output = vcombine_f32(vld1_f32(lo), vld1_f32(hi));
+         filterstore[i] = vmlaq_f32(vmulq_f32(output, damp2), filterstore[i], damp1);
+
+         float32x4_t store = vmlaq_f32(input, filterstore[i], feedback);
+         vst1_f32(lo, vget_low_f32(store));
+         vst1_f32(hi, vget_high_f32(store));
+
+         sum = vaddq_f32(sum, output);
+      }
+
+      // Fold comb pairs.
+      float32x2_t mono = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+
+      for (unsigned i = 0; i < numallpasses; i++)
+      {
+         float *line = allpass[i] + 2 * f;
+         float32x2_t bufout = vld1_f32(line);
+         vst1_f32(line, vmla_f32(mono, bufout, half));
+         mono = vsub_f32(bufout, mono);
+      }
+
+      vst1_f32(out, vmla_f32(vmul_f32(in, dry), mono, wet1));
+   }
+
+   for (unsigned i = 0; i < numcombs / 2; i++)
+      vst1q_f32(rev->filterstore + 4 * i, filterstore[i]);
+}
+#define reverb_block reverb_block_neon
+#endif
+
+static void reverb_simd_process(void *data, struct dspfilter_output *output,
+      const struct dspfilter_input *input)
+{
+   struct reverb_simd_data *rev = data;
+
+   output->samples = input->samples;
+   output->frames  = input->frames;
+
+   float *out = output->samples;
+   unsigned frames = input->frames;
+
+   while (frames)
+   {
+      unsigned block = reverb_simd_block_frames(rev, frames);
+      reverb_block(rev, out, block);
+
+      for (unsigned i = 0; i < numcombs; i++)
+         delayline_advance(&rev->comb[i], block);
+      for (unsigned i = 0; i < numallpasses; i++)
+         delayline_advance(&rev->allpass[i], block);
+
+      out += 2 * block;
+      frames -= block;
+   }
+}
+
+static const struct dspfilter_implementation reverb_plug_simd = {
+   reverb_simd_init,
+   reverb_simd_process,
+   reverb_simd_free,
+
+   DSPFILTER_API_VERSION,
+   "Reverb",
+   "reverb",
+};
+#endif
+
 const struct dspfilter_implementation *dspfilter_get_implementation(dspfilter_simd_mask_t mask)
 {
+#if defined(__SSE__)
+   if (mask & DSPFILTER_SIMD_SSE)
+      return &reverb_plug_simd;
+#elif defined(__ARM_NEON__)
+   if (mask & DSPFILTER_SIMD_NEON)
+      return &reverb_plug_simd;
+#endif
    (void)mask;
    return &reverb_plug;
 }
@@ -28,6 +28,9 @@
 #include "../general.h"
 #else
 #define RARCH_LOG(...) fprintf(stderr, __VA_ARGS__)
+
+// SIMD path picked by the last resampler_sinc_new(), for test tools to report.
+const char *resampler_sinc_simd = "c";
 #endif
 
 #ifdef __SSE__
@@ -470,12 +473,21 @@ static void *resampler_sinc_new(double bandwidth_mod)
 
 #if defined(__AVX__) && ENABLE_AVX
    RARCH_LOG("Sinc resampler [AVX]\n");
+#ifdef RESAMPLER_TEST
+   resampler_sinc_simd = "avx";
+#endif
 #elif defined(__SSE__)
    RARCH_LOG("Sinc resampler [SSE]\n");
+#ifdef RESAMPLER_TEST
+   resampler_sinc_simd = "sse";
+#endif
 #elif defined(__ARM_NEON__)
    unsigned cpu = rarch_get_cpu_features();
    process_sinc_func = cpu & RETRO_SIMD_NEON ? process_sinc_neon : process_sinc_C;
    RARCH_LOG("Sinc resampler [%s]\n", cpu & RETRO_SIMD_NEON ? "NEON" : "C");
+#ifdef RESAMPLER_TEST
+   resampler_sinc_simd = cpu & RETRO_SIMD_NEON ? "neon" : "c";
+#endif
 #else
    RARCH_LOG("Sinc resampler [C]\n");
 #endif
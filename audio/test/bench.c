@@ -0,0 +1,320 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Resampler throughput and accuracy benchmark.
+// One binary is built per resampler/quality/SIMD combination (see Makefile),
+// and every binary sweeps the same set of common sample rate conversions.
+// Results are written to stdout as CSV, one line per conversion.
+
+#include "../resampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLES
+#endif
+
+#ifndef BENCH_RESAMPLER
+#define BENCH_RESAMPLER "sinc"
+#endif
+
+#ifndef BENCH_QUALITY
+#define BENCH_QUALITY "normal"
+#endif
+
+// SIMD path the sinc resampler picked, see sinc.c.
+// Resamplers without SIMD paths are labelled with BENCH_SIMD instead.
+extern const char *resampler_sinc_simd;
+
+// Resampler is fed in chunks of this many frames, roughly what a core pushes per video frame.
+#define BENCH_CHUNK_FRAMES 1024
+
+// Minimum wall time spent on each throughput measurement.
+#define BENCH_MIN_SECONDS 0.25
+
+// Tones up to this fraction of the lower sample rate are considered to be in the passband.
+#define BENCH_PASSBAND 0.30
+
+struct bench_rate
+{
+   unsigned in_rate;
+   unsigned out_rate;
+};
+
+static const struct bench_rate bench_rates[] = {
+   { 32000, 48000 },
+   { 44100, 48000 },
+   { 48000, 44100 },
+   { 32000, 44100 },
+   { 96000, 48000 },
+   { 22050, 48000 },
+};
+
+static const float bench_tones[] = {
+   0.002, 0.005, 0.01, 0.02, 0.05, 0.10, 0.15, 0.20, 0.25, 0.30,
+};
+
+struct bench_result
+{
+   double msamples_per_sec;
+   double cycles_per_frame;
+   double snr_db;
+   double ripple_db;
+};
+
+static double bench_time(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1000000000.0;
+}
+
+static uint64_t bench_cycles(void)
+{
+#ifdef BENCH_HAVE_CYCLES
+   return __rdtsc();
+#else
+   return 0;
+#endif
+}
+
+static void gen_tone(float *out, double omega, size_t frames)
+{
+   for (size_t i = 0; i < frames; i++)
+   {
+      out[2 * i + 0] = cos(i * omega);
+      out[2 * i + 1] = out[2 * i + 0];
+   }
+}
+
+// Runs input through the resampler in chunks. Returns number of output frames.
+static size_t resample_chunked(const rarch_resampler_t *resampler, void *re,
+      const float *input, size_t frames, float *output, double ratio)
+{
+   size_t out_frames = 0;
+
+   while (frames)
+   {
+      size_t chunk = frames < BENCH_CHUNK_FRAMES ? frames : BENCH_CHUNK_FRAMES;
+
+      struct resampler_data data = {
+         .data_in = input,
+         .data_out = output + 2 * out_frames,
+         .input_frames = chunk,
+         .ratio = ratio,
+      };
+
+      rarch_resampler_process(resampler, re, &data);
+
+      out_frames += data.output_frames;
+      input += 2 * chunk;
+      frames -= chunk;
+   }
+
+   return out_frames;
+}
+
+// Least-squares fit of a sine with angular frequency omega to the left channel.
+// Returns fitted amplitude and phase, and the residual energy.
+static double fit_tone(const float *output, size_t frames, double omega,
+      double *amp, double *phase)
+{
+   double scc = 0.0, sss = 0.0, scs = 0.0;
+   double syc = 0.0, sys = 0.0, syy = 0.0;
+
+   for (size_t i = 0; i < frames; i++)
+   {
+      double val = output[2 * i];
+      double c = cos(i * omega);
+      double s = sin(i * omega);
+      scc += c * c;
+      sss += s * s;
+      scs += c * s;
+      syc += val * c;
+      sys += val * s;
+      syy += val * val;
+   }
+
+   double det = scc * sss - scs * scs;
+   double a = (syc * sss - sys * scs) / det;
+   double b = (sys * scc - syc * scs) / det;
+
+   *amp = sqrt(a * a + b * b);
+   *phase = atan2(-b, a);
+   return syy - (a * syc + b * sys);
+}
+
+// Fits a sine close to 'cycles' periods over 'frames' frames of the left channel.
+// The fixed point step of the resamplers introduces a minute pitch error,
+// so the frequency is refined from the phase drift between both halves first.
+// Everything which does not fit is considered noise.
+static void analyze_tone(const float *output, size_t frames, unsigned cycles,
+      double *snr_db, double *gain_db)
+{
+   double omega = 2.0 * M_PI * cycles / frames;
+   double amp, phase, noise;
+   size_t half = frames / 2;
+
+   for (unsigned iter = 0; iter < 3; iter++)
+   {
+      double phase_lo, phase_hi;
+      fit_tone(output, half, omega, &amp, &phase_lo);
+      fit_tone(output + 2 * half, half, omega, &amp, &phase_hi);
+
+      double drift = phase_hi - phase_lo - omega * half;
+      drift -= 2.0 * M_PI * floor(drift / (2.0 * M_PI) + 0.5);
+      omega += drift / half;
+   }
+
+   noise = fit_tone(output, frames, omega, &amp, &phase);
+   double signal = 0.5 * amp * amp * frames;
+   if (noise < 1e-20 * signal)
+      noise = 1e-20 * signal;
+
+   *snr_db = 10.0 * log10(signal / noise);
+   *gain_db = 20.0 * log10(amp);
+}
+
+static bool bench_rate(const struct bench_rate *rate, struct bench_result *res)
+{
+   const rarch_resampler_t *resampler = NULL;
+   void *re = NULL;
+   double ratio = (double)rate->out_rate / rate->in_rate;
+
+   // Three seconds of input. Only the second second of output is analyzed
+   // so that the filter has settled and chunk boundaries are well inside.
+   size_t in_frames = rate->in_rate * 3;
+   size_t out_max = (size_t)(in_frames * ratio) + 2 * BENCH_CHUNK_FRAMES * 8;
+
+   float *input = calloc(in_frames * 2, sizeof(float));
+   float *output = calloc(out_max * 2, sizeof(float));
+   if (!input || !output)
+      goto error;
+
+   unsigned min_rate = rate->in_rate < rate->out_rate ? rate->in_rate : rate->out_rate;
+   double min_gain = HUGE_VAL, max_gain = -HUGE_VAL;
+   res->snr_db = HUGE_VAL;
+
+   for (unsigned i = 0; i < sizeof(bench_tones) / sizeof(bench_tones[0]); i++)
+   {
+      if (bench_tones[i] > BENCH_PASSBAND)
+         continue;
+
+      // Integer Hz so the tone has an integer number of periods in one second of output.
+      unsigned freq = (unsigned)(bench_tones[i] * min_rate);
+      if (!freq)
+         freq = 1;
+
+      if (!rarch_resampler_realloc(&re, &resampler, BENCH_RESAMPLER, ratio))
+         goto error;
+
+      gen_tone(input, 2.0 * M_PI * freq / rate->in_rate, in_frames);
+      size_t out_frames = resample_chunked(resampler, re, input, in_frames, output, ratio);
+      if (out_frames < 2 * rate->out_rate)
+         goto error;
+
+      double snr, gain;
+      analyze_tone(output + 2 * rate->out_rate, rate->out_rate, freq, &snr, &gain);
+
+      if (snr < res->snr_db)
+         res->snr_db = snr;
+      if (gain < min_gain)
+         min_gain = gain;
+      if (gain > max_gain)
+         max_gain = gain;
+   }
+
+   res->ripple_db = max_gain - min_gain;
+
+   // Throughput. Reuse the last tone, content does not matter for speed.
+   if (!rarch_resampler_realloc(&re, &resampler, BENCH_RESAMPLER, ratio))
+      goto error;
+
+   size_t total_frames = 0;
+   uint64_t cycles = 0;
+   double start = bench_time();
+   double elapsed = 0.0;
+
+   do
+   {
+      uint64_t cycle_start = bench_cycles();
+      total_frames += resample_chunked(resampler, re, input, in_frames, output, ratio);
+      cycles += bench_cycles() - cycle_start;
+      elapsed = bench_time() - start;
+   } while (elapsed < BENCH_MIN_SECONDS);
+
+   res->msamples_per_sec = 2.0 * total_frames / elapsed / 1000000.0;
+#ifdef BENCH_HAVE_CYCLES
+   res->cycles_per_frame = (double)cycles / total_frames;
+#else
+   res->cycles_per_frame = NAN;
+#endif
+
+   rarch_resampler_freep(&resampler, &re);
+   free(input);
+   free(output);
+   return true;
+
+error:
+   rarch_resampler_freep(&resampler, &re);
+   free(input);
+   free(output);
+   return false;
+}
+
+int main(int argc, char *argv[])
+{
+   if (argc == 2 && strcmp(argv[1], "--header") == 0)
+   {
+      printf("resampler,quality,simd,in_rate,out_rate,msamples_per_sec,cycles_per_frame,snr_db,ripple_db\n");
+      return 0;
+   }
+   else if (argc != 1)
+   {
+      fprintf(stderr, "Usage: %s [--header]\n", argv[0]);
+      return 1;
+   }
+
+   int ret = 0;
+   const char *simd = NULL;
+#ifdef BENCH_SIMD
+   simd = BENCH_SIMD;
+#endif
+
+   for (unsigned i = 0; i < sizeof(bench_rates) / sizeof(bench_rates[0]); i++)
+   {
+      struct bench_result res = {0};
+      if (!bench_rate(&bench_rates[i], &res))
+      {
+         fprintf(stderr, "Benchmark failed for %u -> %u Hz.\n",
+               bench_rates[i].in_rate, bench_rates[i].out_rate);
+         ret = 1;
+         continue;
+      }
+
+      printf("%s,%s,%s,%u,%u,%.3f,%.2f,%.2f,%.6f\n",
+            BENCH_RESAMPLER, BENCH_QUALITY, simd ? simd : resampler_sinc_simd,
+            bench_rates[i].in_rate, bench_rates[i].out_rate,
+            res.msamples_per_sec, res.cycles_per_frame,
+            res.snr_db, res.ripple_db);
+      fflush(stdout);
+   }
+
+   return ret;
+}
@@ -45,9 +45,10 @@ void audio_convert_float_to_s16_C(int16_t *out,
 void audio_convert_s16_to_float_SSE2(float *out,
       const int16_t *in, size_t samples, float gain)
 {
+   size_t i;
    float fgain = gain / UINT32_C(0x80000000);
    __m128 factor = _mm_set1_ps(fgain);
-   for (size_t i = 0; i + 8 <= samples; i += 8, in += 8, out += 8)
+   for (i = 0; i + 8 <= samples; i += 8, in += 8, out += 8)
    {
       __m128i input = _mm_loadu_si128((const __m128i *)in);
       __m128i regs[2] = {
@@ -70,8 +71,9 @@ void audio_convert_s16_to_float_SSE2(float *out,
 void audio_convert_float_to_s16_SSE2(int16_t *out,
       const float *in, size_t samples)
 {
+   size_t i;
    __m128 factor = _mm_set1_ps((float)0x8000);
-   for (size_t i = 0; i + 8 <= samples; i += 8, in += 8, out += 8)
+   for (i = 0; i + 8 <= samples; i += 8, in += 8, out += 8)
    {
       __m128 input[2] = { _mm_loadu_ps(in + 0), _mm_loadu_ps(in + 4) };
       __m128 res[2] = { _mm_mul_ps(input[0], factor), _mm_mul_ps(input[1], factor) };
@@ -0,0 +1,291 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Virtual audio device. Discards samples like the null driver, but consumes them
+// period by period from a ring buffer against a controlled clock, so that rate control,
+// latency and blocking behaviour can be exercised without audio hardware.
+//
+// Configured through audio_device as a comma separated list of options:
+//    rate=<Hz>      Rate the device consumes frames at. Defaults to audio_out_rate.
+//    drift=<ppm>    Deviation of the device clock. Positive values consume faster.
+//    jitter=<usec>  Maximum random deviation of each period deadline, in either direction.
+//    periods=<n>    Number of periods in the buffer. Defaults to 4.
+//    seed=<n>       Seed for jitter, for reproducible runs.
+// E.g. audio_device = "drift=200,jitter=500".
+
+#include "../driver.h"
+#include "../general.h"
+#include "../performance.h"
+#include "../file_path.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct virtual_audio
+{
+   size_t buffer_size;
+   size_t period_size;
+   size_t fill;
+
+   double period_usec;
+   unsigned jitter_usec;
+   uint32_t seed;
+
+   // Nominal deadline of the next period, and the same deadline with jitter applied.
+   double next_nominal;
+   retro_time_t next_period;
+   bool running;
+   bool nonblock;
+   bool is_paused;
+
+   uint64_t periods;
+   uint64_t underruns;
+   uint64_t blocked_usec;
+} virtual_audio_t;
+
+// Small LCG so that jitter is reproducible regardless of libc.
+// Returns a deviation in [-jitter_usec, jitter_usec].
+static int virtual_audio_jitter(virtual_audio_t *vd)
+{
+   if (!vd->jitter_usec)
+      return 0;
+
+   vd->seed = vd->seed * 1664525u + 1013904223u;
+   return (int)((vd->seed >> 8) % (2 * vd->jitter_usec + 1)) - (int)vd->jitter_usec;
+}
+
+// Consumes every period whose deadline has passed.
+static void virtual_audio_update(virtual_audio_t *vd)
+{
+   if (!vd->running || vd->is_paused)
+      return;
+
+   retro_time_t now = rarch_get_time_usec();
+   while (now >= vd->next_period)
+   {
+      vd->periods++;
+
+      if (vd->fill < vd->period_size)
+      {
+         // Underrun. Like a real device, stop until refilled to start threshold.
+         vd->underruns++;
+         vd->fill = 0;
+         vd->running = false;
+         return;
+      }
+
+      vd->fill -= vd->period_size;
+      vd->next_nominal += vd->period_usec;
+      vd->next_period = (retro_time_t)vd->next_nominal + virtual_audio_jitter(vd);
+   }
+}
+
+static void virtual_audio_schedule(virtual_audio_t *vd)
+{
+   vd->next_nominal = rarch_get_time_usec() + vd->period_usec;
+   vd->next_period = (retro_time_t)vd->next_nominal + virtual_audio_jitter(vd);
+}
+
+static void virtual_audio_try_start(virtual_audio_t *vd)
+{
+   if (vd->running || vd->fill < vd->buffer_size / 2)
+      return;
+
+   vd->running = true;
+   virtual_audio_schedule(vd);
+}
+
+static void virtual_audio_parse_options(const char *device,
+      unsigned *rate, double *drift, unsigned *jitter, unsigned *periods, uint32_t *seed)
+{
+   if (!device || !*device)
+      return;
+
+   struct string_list *list = string_split(device, ",");
+   if (!list)
+      return;
+
+   for (size_t i = 0; i < list->size; i++)
+   {
+      const char *opt = list->elems[i].data;
+      const char *val = strchr(opt, '=');
+      if (!val)
+      {
+         RARCH_WARN("[Virtual audio]: Ignoring malformed option \"%s\".\n", opt);
+         continue;
+      }
+      val++;
+
+      if (strncmp(opt, "rate=", 5) == 0)
+         *rate = strtoul(val, NULL, 0);
+      else if (strncmp(opt, "drift=", 6) == 0)
+         *drift = strtod(val, NULL);
+      else if (strncmp(opt, "jitter=", 7) == 0)
+         *jitter = strtoul(val, NULL, 0);
+      else if (strncmp(opt, "periods=", 8) == 0)
+         *periods = strtoul(val, NULL, 0);
+      else if (strncmp(opt, "seed=", 5) == 0)
+         *seed = strtoul(val, NULL, 0);
+      else
+         RARCH_WARN("[Virtual audio]: Unknown option \"%s\".\n", opt);
+   }
+
+   string_list_free(list);
+}
+
+static void *virtual_audio_init(const char *device, unsigned rate, unsigned latency)
+{
+   virtual_audio_t *vd = calloc(1, sizeof(*vd));
+   if (!vd)
+      return NULL;
+
+   double drift = 0.0;
+   unsigned jitter = 0;
+   unsigned periods = 4;
+   uint32_t seed = 1;
+   virtual_audio_parse_options(device, &rate, &drift, &jitter, &periods, &seed);
+
+   if (!rate)
+      rate = 48000;
+   if (!periods)
+      periods = 1;
+   if (!latency)
+      latency = 1;
+
+   const size_t frame_size = 2 * sizeof(float);
+   size_t period_frames = (size_t)rate * latency / (1000 * periods);
+   if (!period_frames)
+      period_frames = 1;
+
+   vd->period_size = period_frames * frame_size;
+   vd->buffer_size = vd->period_size * periods;
+   vd->period_usec = 1000000.0 * period_frames / (rate * (1.0 + drift / 1000000.0));
+   vd->jitter_usec = jitter;
+   vd->seed = seed;
+
+   RARCH_LOG("[Virtual audio]: %u Hz, %.1f ppm drift, %u usec jitter.\n", rate, drift, jitter);
+   RARCH_LOG("[Virtual audio]: Period size: %u frames, buffer size: %u frames.\n",
+         (unsigned)period_frames, (unsigned)(period_frames * periods));
+
+   return vd;
+}
+
+static void virtual_audio_free(void *data)
+{
+   virtual_audio_t *vd = data;
+   if (!vd)
+      return;
+
+   RARCH_LOG("[Virtual audio]: %llu periods consumed, %llu underruns, %.1f ms spent blocking.\n",
+         (unsigned long long)vd->periods, (unsigned long long)vd->underruns,
+         vd->blocked_usec / 1000.0);
+   free(vd);
+}
+
+static ssize_t virtual_audio_write(void *data, const void *buf, size_t size)
+{
+   virtual_audio_t *vd = data;
+   size_t written = 0;
+   (void)buf;
+
+   while (size)
+   {
+      virtual_audio_update(vd);
+
+      size_t avail = vd->buffer_size - vd->fill;
+      if (!avail)
+      {
+         if (vd->nonblock || vd->is_paused)
+            break;
+
+         // Block until the next period has been consumed.
+         retro_time_t now = rarch_get_time_usec();
+         retro_time_t wait = vd->next_period - now;
+         if (wait > 0)
+         {
+            struct timespec tv = {0};
+            tv.tv_sec = wait / 1000000;
+            tv.tv_nsec = (wait % 1000000) * 1000;
+            nanosleep(&tv, NULL);
+            vd->blocked_usec += rarch_get_time_usec() - now;
+         }
+         continue;
+      }
+
+      size_t to_write = size < avail ? size : avail;
+      vd->fill += to_write;
+      written += to_write;
+      size -= to_write;
+
+      virtual_audio_try_start(vd);
+   }
+
+   return written;
+}
+
+static bool virtual_audio_stop(void *data)
+{
+   virtual_audio_t *vd = data;
+   virtual_audio_update(vd);
+   vd->is_paused = true;
+   return true;
+}
+
+static bool virtual_audio_start(void *data)
+{
+   virtual_audio_t *vd = data;
+   if (vd->is_paused && vd->running)
+      virtual_audio_schedule(vd);
+   vd->is_paused = false;
+   return true;
+}
+
+static void virtual_audio_set_nonblock_state(void *data, bool state)
+{
+   virtual_audio_t *vd = data;
+   vd->nonblock = state;
+}
+
+static bool virtual_audio_use_float(void *data)
+{
+   (void)data;
+   return true;
+}
+
+static size_t virtual_audio_write_avail(void *data)
+{
+   virtual_audio_t *vd = data;
+   virtual_audio_update(vd);
+   return vd->buffer_size - vd->fill;
+}
+
+static size_t virtual_audio_buffer_size(void *data)
+{
+   virtual_audio_t *vd = data;
+   return vd->buffer_size;
+}
+
+const audio_driver_t audio_virtual = {
+   .init = virtual_audio_init,
+   .write = virtual_audio_write,
+   .stop = virtual_audio_stop,
+   .start = virtual_audio_start,
+   .set_nonblock_state = virtual_audio_set_nonblock_state,
+   .free = virtual_audio_free,
+   .use_float = virtual_audio_use_float,
+   .ident = "virtual",
+   .write_avail = virtual_audio_write_avail,
+   .buffer_size = virtual_audio_buffer_size,
+};
@@ -141,6 +141,10 @@ static const bool hard_sync = false;
 // 2: Etc ...
 static const unsigned hard_sync_frames = 0;
 
+// Skips up to this many frames in a row while the frontend cannot keep up with the core's frame rate.
+// Audio and input keep running at full rate. 0 disables frameskip.
+static const unsigned auto_frameskip = 0;
+
 // Inserts a black frame inbetween frames.
 // Useful for 120 Hz monitors who want to play 60 Hz material with eliminated ghosting. video_refresh_rate should still be configured as if it is a 60 Hz monitor (divide refresh rate by 2).
 static bool black_frame_insertion = false;
@@ -209,12 +213,23 @@ static const uint32_t message_color = 0xffff00; // RGB hex value.
 // Record post-filtered (CPU filter) video rather than raw game output.
 static const bool post_filter_record = false;
 
+// Runs the CPU filter on a frame while the core emulates the next one.
+// Adds one frame of latency.
+static const bool video_filter_async = false;
+
+// Hashes every row of the frames a core outputs, so that work on rows which did not change
+// since the last frame is skipped. Frames which did not change at all are not redrawn.
+static const bool video_dirty_rows = false;
+
 // Screenshots post-shaded GPU output if available.
 static const bool gpu_screenshot = true;
 
 // Record post-shaded GPU output instead of raw game footage if available.
 static const bool gpu_record = false;
 
+// Compares recorded frames against a copy of the last one, and passes identical ones on to the recorder as dupes.
+static const bool record_dupe_detect = false;
+
 // OSD-messages
 static const bool font_enable = true;
 
@@ -251,12 +266,21 @@ static const int out_latency = 64;
 // Will sync audio. (recommended) 
 static const bool audio_sync = true;
 
+// Use memory mapped transfers into the audio device buffer where supported (ALSA).
+// Saves a copy per write, and the intermediate fifo in threaded ALSA.
+static const bool audio_mmap = false;
+
 // Audio rate control
 static const bool rate_control = true;
 
 // Rate control delta. Defines how much rate_control is allowed to adjust input rate.
 static const float rate_control_delta = 0.005;
 
+// Integral gain of rate control. When non-zero, rate control becomes a PI controller
+// which also corrects steady state clock drift, keeping the buffer close to half full.
+// This allows running with lower latency. 0.0 gives purely proportional control.
+static const float rate_control_integral = 0.0;
+
 // Default audio volume in dB. (0.0 dB == unity gain).
 static const float audio_volume = 0.0;
 
@@ -305,6 +329,13 @@ static const float slowmotion_ratio = 3.0;
 // Maximum fast forward ratio (Negative => no limit).
 static const float fastforward_ratio = -1.0;
 
+// While fast forwarding, only shows as many frames as the display refreshes,
+// and only plays the audio of those frames.
+static const bool fastforward_decimate = false;
+
+// Microseconds before a frame is due which the frame limiter busy-waits rather than sleeps.
+static const unsigned frame_limit_spin = 0;
+
 // Enable network/named pipe command interface
 static const bool network_cmd_enable = false;
 static const uint16_t network_cmd_port = 55355;
@@ -0,0 +1,55 @@
+#ifndef QB_CONFIG_H__
+#define QB_CONFIG_H__
+
+#define PACKAGE_NAME "retroarch"
+#define HAVE_RGUI 1
+/* #undef HAVE_ALSA */
+#define HAVE_OSS 1
+/* #undef HAVE_OSS_BSD */
+/* #undef HAVE_AL */
+/* #undef HAVE_JACK */
+/* #undef HAVE_PULSE */
+/* #undef HAVE_SDL */
+/* #undef HAVE_SDL2 */
+#define HAVE_OPENGL 1
+/* #undef HAVE_GLES */
+/* #undef HAVE_GLES3 */
+#define HAVE_EGL 1
+/* #undef HAVE_KMS */
+/* #undef HAVE_EXYNOS */
+/* #undef HAVE_GBM */
+/* #undef HAVE_DRM */
+#define HAVE_DYLIB 1
+#define HAVE_GETOPT_LONG 1
+#define HAVE_THREADS 1
+/* #undef HAVE_CG */
+#define HAVE_LIBXML2 1
+#define HAVE_ZLIB 1
+#define HAVE_DYNAMIC 1
+/* #undef HAVE_AVCODEC */
+/* #undef HAVE_AVFORMAT */
+/* #undef HAVE_AVUTIL */
+/* #undef HAVE_SWSCALE */
+#define HAVE_FREETYPE 1
+/* #undef HAVE_XKBCOMMON */
+/* #undef HAVE_XVIDEO */
+/* #undef HAVE_X11 */
+#define HAVE_XEXT 1
+/* #undef HAVE_XF86VM */
+/* #undef HAVE_XINERAMA */
+/* #undef HAVE_WAYLAND */
+/* #undef HAVE_MALI_FBDEV */
+#define HAVE_NETPLAY 1
+#define HAVE_NETWORK_CMD 1
+/* #undef HAVE_SOCKET_LEGACY */
+#define HAVE_FBO 1
+/* #undef HAVE_STRL */
+#define HAVE_STRCASESTR 1
+#define HAVE_MMAP 1
+/* #undef HAVE_PYTHON */
+/* #undef HAVE_NEON */
+/* #undef HAVE_FLOATHARD */
+/* #undef HAVE_FLOATSOFTFP */
+/* #undef HAVE_UDEV */
+/* #undef HAVE_AV_CHANNEL_LAYOUT */
+#endif
@@ -60,6 +60,9 @@ static const audio_driver_t *audio_drivers[] = {
 #ifdef HAVE_PULSE
    &audio_pulse,
 #endif
+#ifdef HAVE_VIRTUALAUDIO
+   &audio_virtual,
+#endif
 #ifdef HAVE_NULLAUDIO
    &audio_null,
 #endif
@@ -448,7 +451,13 @@ void rarch_deinit_filter()
 {
    rarch_softfilter_free(g_extern.filter.filter);
    free(g_extern.filter.buffer);
+   free(g_extern.filter.pending_buffer);
+   free(g_extern.filter.input_buffer);
+   free(g_extern.filter.input_spare);
    memset(&g_extern.filter, 0, sizeof(g_extern.filter));
+
+   // Rows were only skipped because the output of the old filter still held them.
+   rarch_dirty_rows_invalidate(&g_extern.dirty_rows.hashes);
 }
 
 static void deinit_pixel_converter()
@@ -457,6 +466,7 @@ static void deinit_pixel_converter()
    memset(&driver.scaler, 0, sizeof(driver.scaler));
    free(driver.scaler_out);
    driver.scaler_out = NULL;
+   rarch_dirty_rows_invalidate(&g_extern.dirty_rows.hashes);
 }
 
 static void deinit_shader_dir()
@@ -628,12 +638,48 @@ void init_audio()
    rarch_main_command(RARCH_CMD_DSP_FILTER_DEINIT);
 
    g_extern.measure_data.buffer_free_samples_count = 0;
+   g_extern.audio_data.rate_control_integral = 0.0;
 
    if (g_extern.audio_active && !g_extern.audio_data.mute && g_extern.system.audio_callback.callback) // Threaded driver is initially stopped.
       audio_start_func();
 }
 
 
+static int compare_unsigned(const void *a_, const void *b_)
+{
+   unsigned a = *(const unsigned*)a_;
+   unsigned b = *(const unsigned*)b_;
+   return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Detailed buffer occupancy for the perf log. Used to tune latency and rate control.
+static void log_audio_buffer_percentiles(unsigned samples)
+{
+   unsigned *sorted = (unsigned*)malloc((samples - 1) * sizeof(unsigned));
+   if (!sorted)
+      return;
+
+   memcpy(sorted, g_extern.measure_data.buffer_free_samples + 1, (samples - 1) * sizeof(unsigned));
+   qsort(sorted, samples - 1, sizeof(unsigned), compare_unsigned);
+
+   // Most free space is least filled, so percentiles of fill are mirrored.
+   float size = g_extern.audio_data.driver_buffer_size;
+   unsigned last = samples - 2;
+   RARCH_LOG("[PERF]: Audio buffer fill (%% of %u bytes): min %.1f, 1%% %.1f, median %.1f, 99%% %.1f, max %.1f.\n",
+         (unsigned)g_extern.audio_data.driver_buffer_size,
+         100.0f * (1.0f - sorted[last] / size),
+         100.0f * (1.0f - sorted[last - last / 100] / size),
+         100.0f * (1.0f - sorted[last / 2] / size),
+         100.0f * (1.0f - sorted[last / 100] / size),
+         100.0f * (1.0f - sorted[0] / size));
+
+   if (g_settings.audio.rate_control_integral > 0.0f)
+      RARCH_LOG("[PERF]: Audio rate control integral term: %+.5f (estimated clock skew).\n",
+            g_extern.audio_data.rate_control_integral);
+
+   free(sorted);
+}
+
 static void compute_audio_buffer_statistics()
 {
    unsigned samples = min(g_extern.measure_data.buffer_free_samples_count, AUDIO_BUFFER_FREE_SAMPLES_COUNT);
@@ -676,6 +722,9 @@ static void compute_audio_buffer_statistics()
    RARCH_LOG("Amount of time spent close to underrun: %.2f %%. Close to blocking: %.2f %%.\n",
          (100.0 * low_water_count) / (samples - 1),
          (100.0 * high_water_count) / (samples - 1));
+
+   if (g_extern.perfcnt_enable)
+      log_audio_buffer_percentiles(samples);
 }
 
 bool driver_monitor_fps_statistics(double *refresh_rate, double *deviation, unsigned *sample_points)
@@ -774,7 +823,7 @@ void rarch_init_filter(enum retro_pixel_format colfmt)
 
    RARCH_LOG("Loading softfilter from \"%s\"\n", g_settings.video.filter_path);
    g_extern.filter.filter = rarch_softfilter_new(g_settings.video.filter_path,
-         RARCH_SOFTFILTER_THREADS_AUTO, colfmt, width, height);
+         RARCH_SOFTFILTER_THREADS_AUTO, g_settings.video.filter_async, colfmt, width, height);
 
    if (!g_extern.filter.filter)
    {
@@ -782,6 +831,15 @@ void rarch_init_filter(enum retro_pixel_format colfmt)
       return;
    }
 
+   g_extern.filter.in_bpp = colfmt == RETRO_PIXEL_FORMAT_XRGB8888 ? sizeof(uint32_t) : sizeof(uint16_t);
+   if (g_settings.video.filter_async)
+   {
+      g_extern.filter.input_size = width * height * g_extern.filter.in_bpp;
+      g_extern.filter.input_buffer = malloc(g_extern.filter.input_size);
+      if (!g_extern.filter.input_buffer)
+         goto error;
+   }
+
    rarch_softfilter_get_max_output_size(g_extern.filter.filter, &width, &height);
    pow2_x  = next_pow2(width);
    pow2_y  = next_pow2(height);
@@ -796,6 +854,10 @@ void rarch_init_filter(enum retro_pixel_format colfmt)
       align_common(width * height * g_extern.filter.out_bpp, pagesize)))
       goto error;
 
+   if (g_settings.video.filter_async && posix_memalign((void**)&g_extern.filter.pending_buffer, pagesize,
+      align_common(width * height * g_extern.filter.out_bpp, pagesize)))
+      goto error;
+
    return;
 
 error:
@@ -1015,6 +1077,7 @@ void uninit_video_input()
    deinit_pixel_converter();
 
    rarch_deinit_filter();
+   rarch_dirty_rows_free(&g_extern.dirty_rows.hashes);
 
    deinit_shader_dir();
    compute_monitor_fps_statistics();
@@ -274,6 +274,11 @@ typedef struct video_poke_interface
    void (*grab_mouse_toggle)(void *data);
 
    struct gfx_shader *(*get_current_shader)(void *data);
+
+   // Memory the next frame() may be rendered into, so that it does not have to be copied.
+   // Returns NULL if there is none with room for height rows of pitch bytes.
+   // Whatever the memory held before is lost, even if the frame ends up elsewhere.
+   void *(*get_frame_buffer)(void *data, unsigned height, size_t pitch);
 } video_poke_interface_t;
 
 typedef struct video_driver
@@ -429,6 +434,7 @@ extern const audio_driver_t audio_jack;
 extern const audio_driver_t audio_sdl;
 extern const audio_driver_t audio_pulse;
 extern const audio_driver_t audio_null;
+extern const audio_driver_t audio_virtual;
 extern const video_driver_t video_gl;
 extern const video_driver_t video_xvideo;
 extern const video_driver_t video_sdl;
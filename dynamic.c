@@ -562,7 +562,7 @@ bool rarch_environment_cb(unsigned cmd, void *data)
          if (driver.video_poke && driver.video_poke->cfg_sw_fb && driver.video_data)
             return driver.video_poke->cfg_sw_fb(driver.video_data, data);
          else
-            return false;
+            return rarch_sw_fb_config(data);
          break;
 
       case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
@@ -33,6 +33,7 @@
 #include "core_options.h"
 #include "miscellaneous.h"
 #include "gfx/filter.h"
+#include "gfx/dirty_rows.h"
 
 #include "history.h"
 
@@ -134,6 +135,7 @@ struct settings
       bool black_frame_insertion;
       unsigned swap_interval;
       unsigned hard_sync_frames;
+      unsigned auto_frameskip;
       bool smooth;
       bool force_aspect;
       bool crop_overscan;
@@ -147,6 +149,8 @@ struct settings
       bool shader_enable;
 
       char filter_path[PATH_MAX];
+      bool filter_async;
+      bool dirty_rows;
       float refresh_rate;
       bool threaded;
 
@@ -164,6 +168,7 @@ struct settings
 
       bool post_filter_record;
       bool gpu_record;
+      bool record_dupe_detect;
       bool gpu_screenshot;
 
       bool allow_rotate;
@@ -186,12 +191,14 @@ struct settings
       char device[PATH_MAX];
       unsigned latency;
       bool sync;
+      bool mmap;
 
       char dsp_plugin[PATH_MAX];
       char filter_dir[PATH_MAX];
 
       bool rate_control;
       float rate_control_delta;
+      float rate_control_integral;
       float volume; // dB scale
       char resampler[32];
    } audio;
@@ -247,6 +254,8 @@ struct settings
 
    float slowmotion_ratio;
    float fastforward_ratio;
+   bool fastforward_decimate;
+   unsigned frame_limit_spin;
 
    bool pause_nonactive;
    unsigned autosave_interval;
@@ -371,6 +380,17 @@ struct global
       retro_time_t last_frame_time;
    } frame_limit;
 
+   // Auto frameskip. debt is how far behind the core's frame rate the frontend is.
+   struct
+   {
+      retro_time_t last;
+      retro_time_t debt;
+      retro_time_t blocked; // Spent waiting on drivers since last.
+      unsigned skipped; // In a row.
+      retro_time_t shown; // When fast forward last let a frame through.
+      bool skip; // Set while the core runs a frame which is not shown.
+   } frameskip;
+
    struct
    {
       struct retro_system_info info;
@@ -436,6 +456,7 @@ struct global
       rarch_dsp_filter_t *dsp;
 
       bool rate_control; 
+      double rate_control_integral;
       double orig_src_ratio;
       size_t driver_buffer_size;
 
@@ -462,6 +483,23 @@ struct global
       unsigned scale;
       unsigned out_bpp;
       bool out_rgb32;
+
+      // Pipelined mode. A frame is filtered into pending_buffer from a copy
+      // of the core's frame in input_buffer, and shown one frame later.
+      void *pending_buffer;
+      void *input_buffer;
+      // Lent to the core while the filter reads input_buffer. See sw_fb.
+      void *input_spare;
+      size_t input_size;
+      unsigned in_bpp;
+      unsigned pending_width, pending_height;
+      size_t pending_pitch;
+      bool pending;
+
+      // Input rows in which the frame last passed to the filter differs from the one before it.
+      unsigned dirty_first, dirty_last;
+      // Output rows pending_buffer got updated in.
+      unsigned pending_first, pending_last;
    } filter;
 
    msg_queue_t *msg_queue;
@@ -530,6 +568,11 @@ struct global
    size_t record_gpu_width;
    size_t record_gpu_height;
 
+   // Tightly packed copy of the last frame recorded, see video_record_dupe_detect.
+   uint8_t *record_last_frame;
+   size_t record_last_frame_size;
+   unsigned record_bpp;
+
    struct
    {
       const void *data;
@@ -538,6 +581,28 @@ struct global
       size_t pitch;
    } frame_cache;
 
+   // Row hashes of the last frame from the core, see video_dirty_rows.
+   // first and last are the range of rows in which the frame last handed to
+   // the video driver differs from the one before it.
+   struct
+   {
+      struct rarch_dirty_rows hashes;
+      unsigned first, last;
+   } dirty_rows;
+
+   // Framebuffers lent to the core through RETRO_ENVIRONMENT_CONFIG_SOFTWARE_FRAMEBUFFER.
+   // The core renders straight into memory the next stage consumes,
+   // which then does not have to copy the frame.
+   struct
+   {
+      bool enabled;
+      unsigned max_width, max_height;
+      unsigned width, height;
+      size_t pitch;
+      uint8_t *lent; // Handed out by the last get_current_addr().
+      void *buffer; // Lent if no later stage has memory to lend.
+   } sw_fb;
+
    unsigned frame_count;
    char title_buf[64];
 
@@ -649,6 +714,7 @@ void rarch_main_command(unsigned action);
 bool rarch_main_iterate();
 void rarch_main_deinit();
 void rarch_render_cached_frame();
+bool rarch_sw_fb_config(struct retro_framebuffer_config *fb_cfg);
 void rarch_deinit_msg_queue();
 void rarch_input_poll();
 void rarch_check_block_hotkey();
@@ -0,0 +1,222 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dirty_rows.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(DIRTY_ROWS_NO_SIMD)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+// Rows are hashed as four interleaved streams of 32-bit words.
+// Each stream keeps a running sum and a sum of sums (Fletcher style),
+// so both changed and moved words show up. Every path computes the same hash.
+// Words are scrambled before they are summed. Plain sums are linear,
+// so e.g. +1, -2 and +1 on words four apart would cancel out.
+#define DIRTY_ROWS_LANES 4
+#define DIRTY_ROWS_BLOCK (DIRTY_ROWS_LANES * sizeof(uint32_t))
+
+// Finalizer of MurmurHash3. A bijection, which no sum of differences survives.
+#define DIRTY_ROWS_MIX1 0x85ebca6bU
+#define DIRTY_ROWS_MIX2 0xc2b2ae35U
+
+static inline uint32_t dirty_rows_mix(uint32_t word)
+{
+   word ^= word >> 16;
+   word *= DIRTY_ROWS_MIX1;
+   word ^= word >> 13;
+   word *= DIRTY_ROWS_MIX2;
+   word ^= word >> 16;
+   return word;
+}
+
+#if defined(DIRTY_ROWS_NO_SIMD)
+#elif defined(__SSE2__)
+// SSE2 only multiplies every other 32-bit element.
+static inline __m128i dirty_rows_mul_sse2(__m128i a, __m128i b)
+{
+   __m128i even = _mm_mul_epu32(a, b);
+   __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+   return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+         _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i dirty_rows_mix_sse2(__m128i v)
+{
+   v = _mm_xor_si128(v, _mm_srli_epi32(v, 16));
+   v = dirty_rows_mul_sse2(v, _mm_set1_epi32(DIRTY_ROWS_MIX1));
+   v = _mm_xor_si128(v, _mm_srli_epi32(v, 13));
+   v = dirty_rows_mul_sse2(v, _mm_set1_epi32(DIRTY_ROWS_MIX2));
+   return _mm_xor_si128(v, _mm_srli_epi32(v, 16));
+}
+#elif defined(__ARM_NEON__)
+static inline uint32x4_t dirty_rows_mix_neon(uint32x4_t v)
+{
+   v = veorq_u32(v, vshrq_n_u32(v, 16));
+   v = vmulq_n_u32(v, DIRTY_ROWS_MIX1);
+   v = veorq_u32(v, vshrq_n_u32(v, 13));
+   v = vmulq_n_u32(v, DIRTY_ROWS_MIX2);
+   return veorq_u32(v, vshrq_n_u32(v, 16));
+}
+#endif
+
+static uint64_t dirty_rows_finish(uint32_t *sum, uint32_t *acc, const uint8_t *tail, size_t tail_size, size_t size)
+{
+   unsigned i;
+   uint32_t words[DIRTY_ROWS_LANES] = {0};
+   uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+
+   if (tail_size)
+   {
+      memcpy(words, tail, tail_size);
+      for (i = 0; i < DIRTY_ROWS_LANES; i++)
+      {
+         sum[i] += dirty_rows_mix(words[i]);
+         acc[i] += sum[i];
+      }
+   }
+
+   // FNV-1a over the lanes. Every step is a bijection of the word fed in.
+   for (i = 0; i < DIRTY_ROWS_LANES; i++)
+   {
+      hash = (hash ^ sum[i]) * 0x100000001b3ULL;
+      hash = (hash ^ acc[i]) * 0x100000001b3ULL;
+   }
+   return hash;
+}
+
+uint64_t rarch_dirty_rows_hash(const void *data_, size_t size)
+{
+   const uint8_t *data = (const uint8_t*)data_;
+   size_t blocks = size / DIRTY_ROWS_BLOCK;
+   uint32_t sum[DIRTY_ROWS_LANES], acc[DIRTY_ROWS_LANES];
+   size_t i;
+
+#if defined(DIRTY_ROWS_NO_SIMD)
+#define DIRTY_ROWS_C
+#elif defined(__SSE2__)
+   __m128i vsum = _mm_setzero_si128();
+   __m128i vacc = _mm_setzero_si128();
+   for (i = 0; i < blocks; i++)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)(data + i * DIRTY_ROWS_BLOCK));
+      vsum = _mm_add_epi32(vsum, dirty_rows_mix_sse2(v));
+      vacc = _mm_add_epi32(vacc, vsum);
+   }
+   _mm_storeu_si128((__m128i*)sum, vsum);
+   _mm_storeu_si128((__m128i*)acc, vacc);
+#elif defined(__ARM_NEON__)
+   uint32x4_t vsum = vdupq_n_u32(0);
+   uint32x4_t vacc = vdupq_n_u32(0);
+   for (i = 0; i < blocks; i++)
+   {
+      uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(data + i * DIRTY_ROWS_BLOCK));
+      vsum = vaddq_u32(vsum, dirty_rows_mix_neon(v));
+      vacc = vaddq_u32(vacc, vsum);
+   }
+   vst1q_u32(sum, vsum);
+   vst1q_u32(acc, vacc);
+#else
+#define DIRTY_ROWS_C
+#endif
+
+#ifdef DIRTY_ROWS_C
+   unsigned j;
+   memset(sum, 0, sizeof(sum));
+   memset(acc, 0, sizeof(acc));
+   for (i = 0; i < blocks; i++)
+   {
+      uint32_t words[DIRTY_ROWS_LANES];
+      memcpy(words, data + i * DIRTY_ROWS_BLOCK, sizeof(words));
+      for (j = 0; j < DIRTY_ROWS_LANES; j++)
+      {
+         sum[j] += dirty_rows_mix(words[j]);
+         acc[j] += sum[j];
+      }
+   }
+#endif
+
+   return dirty_rows_finish(sum, acc, data + blocks * DIRTY_ROWS_BLOCK,
+         size - blocks * DIRTY_ROWS_BLOCK, size);
+}
+
+bool rarch_dirty_rows_update(struct rarch_dirty_rows *dirty,
+      const void *frame, unsigned width, unsigned height, size_t pitch, unsigned bpp,
+      unsigned *first, unsigned *last)
+{
+   const uint8_t *src = (const uint8_t*)frame;
+   size_t row_size = width * bpp;
+   bool reset = !dirty->valid || width != dirty->width ||
+      height != dirty->height || bpp != dirty->bpp;
+   unsigned y, lo = height, hi = 0;
+
+   if (height > dirty->capacity)
+   {
+      uint64_t *hashes = (uint64_t*)realloc(dirty->hashes, height * sizeof(*hashes));
+      if (!hashes)
+      {
+         dirty->valid = false;
+         *first = 0;
+         *last = height;
+         return true;
+      }
+
+      dirty->hashes = hashes;
+      dirty->capacity = height;
+   }
+
+   for (y = 0; y < height; y++, src += pitch)
+   {
+      uint64_t hash = rarch_dirty_rows_hash(src, row_size);
+      if (reset || hash != dirty->hashes[y])
+      {
+         if (lo == height)
+            lo = y;
+         hi = y + 1;
+      }
+      dirty->hashes[y] = hash;
+   }
+
+   dirty->width = width;
+   dirty->height = height;
+   dirty->bpp = bpp;
+   dirty->valid = true;
+
+   if (!hi)
+   {
+      *first = *last = 0;
+      return false;
+   }
+
+   *first = lo;
+   *last = hi;
+   return true;
+}
+
+void rarch_dirty_rows_invalidate(struct rarch_dirty_rows *dirty)
+{
+   dirty->valid = false;
+}
+
+void rarch_dirty_rows_free(struct rarch_dirty_rows *dirty)
+{
+   free(dirty->hashes);
+   memset(dirty, 0, sizeof(*dirty));
+}
+
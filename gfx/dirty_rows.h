@@ -0,0 +1,52 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RARCH_DIRTY_ROWS_H__
+#define RARCH_DIRTY_ROWS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Remembers a hash of every row of the last frame,
+// so that the next frame can be compared against it without keeping a copy.
+struct rarch_dirty_rows
+{
+   uint64_t *hashes;
+   unsigned capacity;
+
+   unsigned width;
+   unsigned height;
+   unsigned bpp;
+   bool valid;
+};
+
+// Hashes size bytes of a single row.
+uint64_t rarch_dirty_rows_hash(const void *data, size_t size);
+
+// Hashes every row of a frame, and returns in [*first, *last) the range of rows
+// which changed since the previous call. Returns false if the frame is unchanged.
+// After a size or format change, or rarch_dirty_rows_invalidate(), the whole frame is dirty.
+bool rarch_dirty_rows_update(struct rarch_dirty_rows *dirty,
+      const void *frame, unsigned width, unsigned height, size_t pitch, unsigned bpp,
+      unsigned *first, unsigned *last);
+
+// Forgets the last frame, e.g. when whatever was derived from it got lost.
+void rarch_dirty_rows_invalidate(struct rarch_dirty_rows *dirty);
+
+void rarch_dirty_rows_free(struct rarch_dirty_rows *dirty);
+
+#endif
+
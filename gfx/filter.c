@@ -18,7 +18,9 @@
 #include "../dynamic.h"
 #include "../general.h"
 #include "../performance.h"
+#include "../file_path.h"
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef HAVE_CONFIG_H
 #include "../config.h"
@@ -26,115 +28,396 @@
 
 #ifdef HAVE_THREADS
 #include "../thread.h"
+#else
+// Bands are only ever claimed by the calling thread.
+#define satomic_add(ptr, val) (*(ptr) += (val))
+#endif
 
-struct filter_thread_data
-{
-   sthread_t *thread;
-   const struct softfilter_work_packet *packet;
-   scond_t *cond;
-   slock_t *lock;
-   void *userdata;
-   bool die;
-   bool done;
-};
+// Filters can be chained by separating paths with '|' in video_filter.
+#define FILTER_MAX_PASSES 8
 
-static void filter_thread_loop(void *data)
-{
-   struct filter_thread_data *thr = data;
+// A chain is processed in horizontal bands sized so that every intermediate
+// pass of a band stays within this budget, i.e. roughly in L2.
+#define FILTER_BAND_CACHE_SIZE (256 * 1024)
 
-   for (;;)
-   {
-      slock_lock(thr->lock);
-      while (thr->done && !thr->die)
-         scond_wait(thr->cond, thr->lock);
-      bool die = thr->die;
-      slock_unlock(thr->lock);
+// Rows of context on each side of a band a filter may look at.
+// Rows computed from this context are recomputed by neighbouring bands and discarded.
+#define FILTER_BAND_HALO 2
 
-      if (die)
-         break;
+struct softfilter_pass
+{
+#if defined(HAVE_DYLIB)
+   dylib_t lib;
+#endif
+   const struct softfilter_implementation *impl;
+   unsigned in_fmt, out_fmt;
+   unsigned scale; // Vertical scale.
+   unsigned max_rows; // Maximum output rows of one band.
+};
 
-      if (thr->packet && thr->packet->work)
-         thr->packet->work(thr->userdata, thr->packet->thread_data);
+// In a chain every worker owns a single threaded instance of every pass,
+// and takes whole bands through all of them.
+struct filter_band_worker
+{
+   void *impl_data[FILTER_MAX_PASSES];
+   uint8_t *buffer[FILTER_MAX_PASSES];
+   size_t pitch[FILTER_MAX_PASSES];
+};
 
-      slock_lock(thr->lock);
-      thr->done = true;
-      scond_signal(thr->cond);
-      slock_unlock(thr->lock);
-   }
-}
-#endif
+struct filter_band_frame
+{
+   void *output;
+   size_t output_stride;
+   const void *input;
+   size_t input_stride;
+
+   // Size of the input to each pass. The last entry is the size of the final output.
+   unsigned width[FILTER_MAX_PASSES + 1];
+   unsigned height[FILTER_MAX_PASSES + 1];
+   unsigned bands;
+   volatile unsigned next_band;
+
+   // Passed to set_band(), latched once per frame.
+   unsigned frame_count;
+};
 
 struct rarch_softfilter
 {
-#if defined(HAVE_DYLIB)
-   dylib_t lib;
-#endif
+   struct softfilter_pass passes[FILTER_MAX_PASSES];
+   unsigned num_passes;
+   char ident[256];
 
-   const struct softfilter_implementation *impl;
    void *impl_data;
+   void *userdata;
 
    unsigned max_width, max_height;
    enum retro_pixel_format pix_fmt, out_pix_fmt;
 
+   // Either one packet per thread, or one per tile if the filter supports tiles.
    struct softfilter_work_packet *packets;
+   unsigned num_packets;
    unsigned threads;
+   bool tiled;
+   // Output changes every frame, so neither tiles nor whole frames can be skipped.
+   bool frame_dependent;
+
+   // Limits the next frame to the tiles which depend on dirty input rows.
+   bool dirty;
+   unsigned dirty_first, dirty_last;
+   // Input rows the last frame updated the output for.
+   unsigned processed_first, processed_last;
+
+   // In async mode every packet runs on a pool thread, and the caller returns right away.
+   bool async;
+   bool busy;
+
+   struct filter_band_worker *band_workers;
+   struct filter_band_frame band_frame;
+   unsigned band_rows;
+   unsigned frame_count;
 
 #ifdef HAVE_THREADS
-   struct filter_thread_data *thread_data;
+   sthread_pool_t *pool;
+   unsigned workers;
 #endif
 };
 
+static unsigned softfilter_bpp(unsigned fmt)
+{
+   return fmt == SOFTFILTER_FMT_XRGB8888 ? SOFTFILTER_BPP_XRGB8888 : SOFTFILTER_BPP_RGB565;
+}
+
 const char *rarch_softfilter_get_name(void *data)
 {
    rarch_softfilter_t *filt = data;
-   if (!filt || !filt->impl)
+   if (!filt || !filt->num_passes)
       return NULL;
 
-   return filt->impl->ident;
+   return filt->ident;
 }
 
-rarch_softfilter_t *rarch_softfilter_new(const char *filter_path,
-      unsigned threads,
-      enum retro_pixel_format in_pixel_format,
-      unsigned max_width, unsigned max_height)
+static bool softfilter_load_pass(struct softfilter_pass *pass, const char *path,
+      unsigned input_fmt, unsigned cpu_features)
 {
-   unsigned cpu_features, output_fmts, input_fmts, input_fmt;
-   (void)filter_path;
-
-   rarch_softfilter_t *filt = calloc(1, sizeof(*filt));
-   if (!filt)
-      return NULL;
-
+   unsigned output_fmts;
    softfilter_get_implementation_t cb = NULL;
+   (void)path;
+
 #if defined(HAVE_DYLIB)
-   filt->lib = dylib_load(filter_path);
-   if (!filt->lib)
-      goto error;
+   pass->lib = dylib_load(path);
+   if (!pass->lib)
+      return false;
 
-   cb = (softfilter_get_implementation_t)dylib_proc(filt->lib, "softfilter_get_implementation");
+   cb = (softfilter_get_implementation_t)dylib_proc(pass->lib, "softfilter_get_implementation");
 #endif
    if (!cb)
    {
       RARCH_ERR("Couldn't find softfilter symbol.\n");
-      goto error;
+      return false;
    }
 
-   cpu_features = rarch_get_cpu_features();
-   filt->impl = cb(cpu_features);
-   if (!filt->impl)
-      goto error;
+   pass->impl = cb(cpu_features);
+   if (!pass->impl)
+      return false;
 
-   RARCH_LOG("Loaded softfilter \"%s\".\n", filt->impl->ident);
+   RARCH_LOG("Loaded softfilter \"%s\".\n", pass->impl->ident);
 
-   if (filt->impl->api_version != SOFTFILTER_API_VERSION)
+   if (pass->impl->api_version < 1 || pass->impl->api_version > SOFTFILTER_API_VERSION)
    {
       RARCH_ERR("Softfilter ABI mismatch.\n");
-      goto error;
+      return false;
    }
 
-   // Simple assumptions.
-   filt->pix_fmt = in_pixel_format;
-   input_fmts = filt->impl->query_input_formats();
+   if (!(input_fmt & pass->impl->query_input_formats()))
+   {
+      RARCH_ERR("Softfilter does not support input format.\n");
+      return false;
+   }
+
+   pass->in_fmt = input_fmt;
+
+   output_fmts = pass->impl->query_output_formats(input_fmt);
+   if (output_fmts & input_fmt) // If we have a match of input/output formats, use that.
+      pass->out_fmt = input_fmt;
+   else if (output_fmts & SOFTFILTER_FMT_XRGB8888)
+      pass->out_fmt = SOFTFILTER_FMT_XRGB8888;
+   else if (output_fmts & SOFTFILTER_FMT_RGB565)
+      pass->out_fmt = SOFTFILTER_FMT_RGB565;
+   else
+   {
+      RARCH_ERR("Did not find suitable output format for softfilter.\n");
+      return false;
+   }
+
+   return true;
+}
+
+// Computes the number of output rows every pass has to produce for bands of 'rows' final output rows.
+// Returns the combined size of all intermediate buffers of one worker.
+static size_t filter_band_footprint(rarch_softfilter_t *filt, unsigned rows)
+{
+   const struct filter_band_frame *frame = &filt->band_frame;
+   size_t size = 0;
+   int p;
+
+   for (p = filt->num_passes - 1; p >= 0; p--)
+   {
+      struct softfilter_pass *pass = &filt->passes[p];
+      unsigned in_rows = (rows + pass->scale - 1) / pass->scale + 1 + 2 * FILTER_BAND_HALO;
+      if (in_rows > frame->height[p])
+         in_rows = frame->height[p];
+
+      pass->max_rows = in_rows * pass->scale;
+      size += (size_t)pass->max_rows * frame->width[p + 1] * softfilter_bpp(pass->out_fmt);
+      rows = in_rows;
+   }
+
+   return size;
+}
+
+static void filter_band_query_size(rarch_softfilter_t *filt, unsigned width, unsigned height)
+{
+   struct filter_band_frame *frame = &filt->band_frame;
+   unsigned p;
+
+   frame->width[0] = width;
+   frame->height[0] = height;
+   for (p = 0; p < filt->num_passes; p++)
+   {
+      filt->passes[p].impl->query_output_size(filt->band_workers[0].impl_data[p],
+            &frame->width[p + 1], &frame->height[p + 1], frame->width[p], frame->height[p]);
+   }
+}
+
+static bool filter_band_init(rarch_softfilter_t *filt, unsigned threads, unsigned cpu_features)
+{
+   struct filter_band_frame *frame = &filt->band_frame;
+   unsigned i, p;
+
+   filt->band_workers = calloc(threads, sizeof(*filt->band_workers));
+   if (!filt->band_workers)
+      return false;
+
+   frame->width[0] = filt->max_width;
+   frame->height[0] = filt->max_height;
+
+   for (i = 0; i < threads; i++)
+   {
+      for (p = 0; p < filt->num_passes; p++)
+      {
+         const struct softfilter_pass *pass = &filt->passes[p];
+         unsigned width = frame->width[p];
+         unsigned height = frame->height[p];
+
+         void *data = pass->impl->create(pass->in_fmt, pass->out_fmt, width, height, 1, cpu_features);
+         filt->band_workers[i].impl_data[p] = data;
+         if (!data)
+         {
+            RARCH_ERR("Failed to create softfilter state.\n");
+            return false;
+         }
+
+         if (pass->impl->query_num_threads(data) != 1)
+         {
+            RARCH_ERR("Invalid number of threads.\n");
+            return false;
+         }
+
+         // Instances of the first worker are used to query sizes.
+         if (i == 0)
+         {
+            pass->impl->query_output_size(data, &frame->width[p + 1], &frame->height[p + 1],
+                  width, height);
+         }
+      }
+   }
+
+   for (p = 0; p < filt->num_passes; p++)
+   {
+      struct softfilter_pass *pass = &filt->passes[p];
+      pass->scale = frame->height[p + 1] / frame->height[p];
+      if (!pass->scale || pass->scale * frame->height[p] != frame->height[p + 1])
+      {
+         RARCH_ERR("Softfilter \"%s\" does not scale by an integer factor vertically, cannot be chained.\n",
+               pass->impl->ident);
+         return false;
+      }
+   }
+
+   // Largest band, in multiples of 8 rows, whose intermediates fit the cache budget.
+   unsigned out_height = frame->height[filt->num_passes];
+   filt->band_rows = 8;
+   while (filt->band_rows + 8 <= out_height &&
+         filter_band_footprint(filt, filt->band_rows + 8) <= FILTER_BAND_CACHE_SIZE)
+      filt->band_rows += 8;
+   if (filt->band_rows > out_height)
+      filt->band_rows = out_height;
+   filter_band_footprint(filt, filt->band_rows);
+
+   RARCH_LOG("Softfilter chain uses bands of %u rows.\n", filt->band_rows);
+
+   for (i = 0; i < threads; i++)
+   {
+      struct filter_band_worker *worker = &filt->band_workers[i];
+      for (p = 0; p < filt->num_passes; p++)
+      {
+         worker->pitch[p] = (size_t)frame->width[p + 1] * softfilter_bpp(filt->passes[p].out_fmt);
+         worker->buffer[p] = malloc(worker->pitch[p] * filt->passes[p].max_rows);
+         if (!worker->buffer[p])
+            return false;
+      }
+   }
+
+   return true;
+}
+
+// Takes band after band through every pass of the chain.
+static void filter_band_work(void *data, void *thread_data)
+{
+   rarch_softfilter_t *filt = data;
+   struct filter_band_worker *worker = thread_data;
+   const struct filter_band_frame *frame = &filt->band_frame;
+   unsigned num_passes = filt->num_passes;
+   unsigned out_height = frame->height[num_passes];
+   unsigned out_bpp = softfilter_bpp(filt->passes[num_passes - 1].out_fmt);
+   unsigned band;
+   int p;
+
+   // Bands are claimed one by one, so workers which are done early help out with the rest.
+   while ((band = satomic_add(&filt->band_frame.next_band, 1) - 1) < frame->bands)
+   {
+      unsigned win_start[FILTER_MAX_PASSES], win_end[FILTER_MAX_PASSES];
+      unsigned start = band * filt->band_rows;
+      unsigned end = start + filt->band_rows;
+      if (end > out_height)
+         end = out_height;
+
+      // Walk back through the chain to find which input rows each pass needs.
+      unsigned need_start = start, need_end = end;
+      for (p = num_passes - 1; p >= 0; p--)
+      {
+         unsigned scale = filt->passes[p].scale;
+         unsigned in_start = need_start / scale;
+         unsigned in_end = (need_end + scale - 1) / scale + FILTER_BAND_HALO;
+
+         in_start = in_start > FILTER_BAND_HALO ? in_start - FILTER_BAND_HALO : 0;
+         if (in_end > frame->height[p])
+            in_end = frame->height[p];
+
+         win_start[p] = need_start = in_start;
+         win_end[p] = need_end = in_end;
+      }
+
+      const uint8_t *src = (const uint8_t*)frame->input + win_start[0] * frame->input_stride;
+      size_t src_stride = frame->input_stride;
+
+      for (p = 0; p < (int)num_passes; p++)
+      {
+         const struct softfilter_pass *pass = &filt->passes[p];
+         struct softfilter_work_packet packet;
+
+         if (pass->impl->api_version >= 3 && pass->impl->set_band)
+            pass->impl->set_band(worker->impl_data[p], frame->frame_count, win_start[p]);
+         pass->impl->get_work_packets(worker->impl_data[p], &packet,
+               worker->buffer[p], worker->pitch[p],
+               src, frame->width[p], win_end[p] - win_start[p], src_stride);
+         if (packet.work)
+            packet.work(worker->impl_data[p], packet.thread_data);
+
+         // The buffer now holds output rows from win_start[p] * scale onwards.
+         unsigned next_start = p + 1 < (int)num_passes ? win_start[p + 1] : start;
+         src = worker->buffer[p] + (next_start - win_start[p] * pass->scale) * worker->pitch[p];
+         src_stride = worker->pitch[p];
+      }
+
+      uint8_t *dst = (uint8_t*)frame->output + start * frame->output_stride;
+      size_t row_size = frame->width[num_passes] * out_bpp;
+      unsigned y;
+      for (y = start; y < end; y++, src += src_stride, dst += frame->output_stride)
+         memcpy(dst, src, row_size);
+   }
+}
+
+#ifdef HAVE_THREADS
+// Runs a packet on whichever thread claimed it.
+static void filter_pool_job(void *data, unsigned index)
+{
+   rarch_softfilter_t *filt = data;
+   const struct softfilter_work_packet *packet = &filt->packets[index];
+   if (packet->work)
+      packet->work(filt->userdata, packet->thread_data);
+}
+
+static bool filter_pool_init(rarch_softfilter_t *filt, unsigned threads)
+{
+   // Unless running asynchronously, the calling thread processes packets itself.
+   unsigned first = filt->async ? 0 : 1;
+   if (threads <= first)
+      return true;
+
+   // Spinning only pays off if every thread has a core of its own.
+   // An async caller keeps its core busy with other work.
+   filt->pool = sthread_pool_new(threads - first,
+         rarch_get_cpu_cores() >= threads + (filt->async ? 1 : 0));
+   if (!filt->pool)
+      return false;
+
+   filt->workers = sthread_pool_workers(filt->pool);
+   return true;
+}
+#endif
+
+rarch_softfilter_t *rarch_softfilter_new(const char *filter_path,
+      unsigned threads, bool async,
+      enum retro_pixel_format in_pixel_format,
+      unsigned max_width, unsigned max_height)
+{
+   unsigned cpu_features, input_fmt, i;
+   struct string_list *paths = NULL;
+
+   rarch_softfilter_t *filt = calloc(1, sizeof(*filt));
+   if (!filt)
+      return NULL;
 
    switch (in_pixel_format)
    {
@@ -148,112 +431,162 @@ rarch_softfilter_t *rarch_softfilter_new(const char *filter_path,
          goto error;
    }
 
-   if (!(input_fmt & input_fmts))
+   paths = string_split(filter_path, "|");
+   if (!paths || !paths->size)
+      goto error;
+
+   if (paths->size > FILTER_MAX_PASSES)
    {
-      RARCH_ERR("Softfilter does not support input format.\n");
+      RARCH_ERR("Too many chained softfilters, maximum is %u.\n", FILTER_MAX_PASSES);
       goto error;
    }
 
-   output_fmts = filt->impl->query_output_formats(input_fmt);
-   if (output_fmts & input_fmt) // If we have a match of input/output formats, use that.
-      filt->out_pix_fmt = in_pixel_format;
-   else if (output_fmts & SOFTFILTER_FMT_XRGB8888)
-      filt->out_pix_fmt = RETRO_PIXEL_FORMAT_XRGB8888;
-   else if (output_fmts & SOFTFILTER_FMT_RGB565)
-      filt->out_pix_fmt = RETRO_PIXEL_FORMAT_RGB565;
-   else
+   cpu_features = rarch_get_cpu_features();
+   for (i = 0; i < paths->size; i++)
    {
-      RARCH_ERR("Did not find suitable output format for softfilter.\n");
-      goto error;
+      struct softfilter_pass *pass = &filt->passes[i];
+      if (!softfilter_load_pass(pass, paths->elems[i].data, input_fmt, cpu_features))
+         goto error;
+      filt->num_passes++;
+
+      if (i)
+         strlcat(filt->ident, " + ", sizeof(filt->ident));
+      strlcat(filt->ident, pass->impl->ident, sizeof(filt->ident));
+      input_fmt = pass->out_fmt;
    }
 
+   string_list_free(paths);
+   paths = NULL;
+
+   filt->async = async;
+   filt->pix_fmt = in_pixel_format;
+   filt->out_pix_fmt = input_fmt == SOFTFILTER_FMT_XRGB8888 ?
+      RETRO_PIXEL_FORMAT_XRGB8888 : RETRO_PIXEL_FORMAT_RGB565;
    filt->max_width = max_width;
    filt->max_height = max_height;
 
-   filt->impl_data = filt->impl->create(input_fmt, input_fmt, max_width, max_height,
-         threads != RARCH_SOFTFILTER_THREADS_AUTO ? threads : rarch_get_cpu_cores(), cpu_features);
-   if (!filt->impl_data)
+   if (threads == RARCH_SOFTFILTER_THREADS_AUTO)
+      threads = rarch_get_cpu_cores();
+
+   if (filt->num_passes == 1)
    {
-      RARCH_ERR("Failed to create softfilter state.\n");
-      goto error;
+      const struct softfilter_pass *pass = &filt->passes[0];
+      filt->impl_data = pass->impl->create(pass->in_fmt, pass->out_fmt,
+            max_width, max_height, threads, cpu_features);
+      if (!filt->impl_data)
+      {
+         RARCH_ERR("Failed to create softfilter state.\n");
+         goto error;
+      }
+
+      threads = pass->impl->query_num_threads(filt->impl_data);
+      if (!threads)
+      {
+         RARCH_ERR("Invalid number of threads.\n");
+         goto error;
+      }
+      filt->userdata = filt->impl_data;
+
+      if (pass->impl->api_version >= 2 && pass->impl->get_work_tiles && pass->impl->query_num_tiles)
+      {
+         filt->num_packets = pass->impl->query_num_tiles(filt->impl_data);
+         filt->tiled = filt->num_packets > 0;
+      }
+   }
+   else
+   {
+      if (!threads)
+         threads = 1;
+      filt->threads = threads;
+      if (!filter_band_init(filt, threads, cpu_features))
+         goto error;
+      filt->userdata = filt;
    }
 
-   threads = filt->impl->query_num_threads(filt->impl_data);
-   if (!threads)
+   for (i = 0; i < filt->num_passes; i++)
    {
-      RARCH_ERR("Invalid number of threads.\n");
-      goto error;
+      const struct softfilter_pass *pass = &filt->passes[i];
+      void *data = filt->band_workers ? filt->band_workers[0].impl_data[i] : filt->impl_data;
+      if (pass->impl->api_version >= 3 && pass->impl->query_frame_dependent &&
+            pass->impl->query_frame_dependent(data))
+         filt->frame_dependent = true;
    }
 
    RARCH_LOG("Using %u threads for softfilter.\n", threads);
+   if (filt->tiled)
+      RARCH_LOG("Softfilter is split into up to %u tiles.\n", filt->num_packets);
+   else
+      filt->num_packets = threads;
 
-   filt->packets = calloc(threads, sizeof(*filt->packets));
+   filt->packets = calloc(filt->num_packets, sizeof(*filt->packets));
    if (!filt->packets)
    {
       RARCH_ERR("Failed to allocate softfilter packets.\n");
       goto error;
    }
 
-#ifdef HAVE_THREADS
-   filt->thread_data = calloc(threads, sizeof(*filt->thread_data));
-   if (!filt->thread_data)
-      goto error;
    filt->threads = threads;
 
-   unsigned i;
-   for (i = 0; i < threads; i++)
+   // Every band worker has a packet of its own, which claims bands until none are left.
+   if (filt->band_workers)
    {
-      filt->thread_data[i].userdata = filt->impl_data;
-      filt->thread_data[i].done = true;
-
-      filt->thread_data[i].lock = slock_new();
-      if (!filt->thread_data[i].lock)
-         goto error;
-      filt->thread_data[i].cond = scond_new();
-      if (!filt->thread_data[i].cond)
-         goto error;
-      filt->thread_data[i].thread = sthread_create(filter_thread_loop, &filt->thread_data[i]);
-      if (!filt->thread_data[i].thread)
-         goto error;
+      for (i = 0; i < threads; i++)
+      {
+         filt->packets[i].work = filter_band_work;
+         filt->packets[i].thread_data = &filt->band_workers[i];
+      }
    }
+
+#ifdef HAVE_THREADS
+   if (!filter_pool_init(filt, threads))
+      goto error;
 #endif
 
    return filt;
 
 error:
+   string_list_free(paths);
    rarch_softfilter_free(filt);
    return NULL;
 }
 
 void rarch_softfilter_free(rarch_softfilter_t *filt)
 {
-   unsigned i;
-   i = 0;
-   (void)i;
+   unsigned i, p;
    if (!filt)
       return;
 
+   rarch_softfilter_wait(filt);
+
+#ifdef HAVE_THREADS
+   sthread_pool_free(filt->pool);
+#endif
+
    free(filt->packets);
-   if (filt->impl && filt->impl_data)
-      filt->impl->destroy(filt->impl_data);
+
+   if (filt->impl_data)
+      filt->passes[0].impl->destroy(filt->impl_data);
+
+   if (filt->band_workers)
+   {
+      for (i = 0; i < filt->threads; i++)
+      {
+         for (p = 0; p < filt->num_passes; p++)
+         {
+            if (filt->band_workers[i].impl_data[p])
+               filt->passes[p].impl->destroy(filt->band_workers[i].impl_data[p]);
+            free(filt->band_workers[i].buffer[p]);
+         }
+      }
+      free(filt->band_workers);
+   }
+
 #if defined(HAVE_DYLIB)
-   if (filt->lib)
-      dylib_close(filt->lib);
-#endif
-#ifdef HAVE_THREADS
-   for (i = 0; i < filt->threads; i++)
+   for (p = 0; p < FILTER_MAX_PASSES; p++)
    {
-      if (!filt->thread_data[i].thread)
-         continue;
-      slock_lock(filt->thread_data[i].lock);
-      filt->thread_data[i].die = true;
-      scond_signal(filt->thread_data[i].cond);
-      slock_unlock(filt->thread_data[i].lock);
-      sthread_join(filt->thread_data[i].thread);
-      slock_free(filt->thread_data[i].lock);
-      scond_free(filt->thread_data[i].cond);
+      if (filt->passes[p].lib)
+         dylib_close(filt->passes[p].lib);
    }
-   free(filt->thread_data);
 #endif
    free(filt);
 }
@@ -268,8 +601,22 @@ void rarch_softfilter_get_output_size(rarch_softfilter_t *filt,
       unsigned *out_width, unsigned *out_height,
       unsigned width, unsigned height)
 {
-   if (filt && filt->impl && filt->impl->query_output_size)
-      filt->impl->query_output_size(filt->impl_data, out_width, out_height, width, height);
+   unsigned p;
+   if (!filt || !filt->num_passes)
+      return;
+
+   if (filt->band_workers)
+   {
+      for (p = 0; p < filt->num_passes; p++)
+      {
+         filt->passes[p].impl->query_output_size(filt->band_workers[0].impl_data[p],
+               out_width, out_height, width, height);
+         width = *out_width;
+         height = *out_height;
+      }
+   }
+   else if (filt->passes[0].impl->query_output_size)
+      filt->passes[0].impl->query_output_size(filt->impl_data, out_width, out_height, width, height);
 }
 
 enum retro_pixel_format rarch_softfilter_get_output_format(rarch_softfilter_t *filt)
@@ -277,40 +624,166 @@ enum retro_pixel_format rarch_softfilter_get_output_format(rarch_softfilter_t *f
    return filt->out_pix_fmt;
 }
 
-void rarch_softfilter_process(rarch_softfilter_t *filt,
+bool rarch_softfilter_is_frame_dependent(rarch_softfilter_t *filt)
+{
+   return filt->frame_dependent;
+}
+
+void rarch_softfilter_set_dirty_rows(rarch_softfilter_t *filt, unsigned first, unsigned last)
+{
+   filt->dirty = true;
+   filt->dirty_first = first;
+   filt->dirty_last = last;
+}
+
+void rarch_softfilter_get_processed_rows(rarch_softfilter_t *filt, unsigned *first, unsigned *last)
+{
+   *first = filt->processed_first;
+   *last = filt->processed_last;
+}
+
+// Drops the packets of tiles which neither contain dirty rows,
+// nor have one within SOFTFILTER_TILE_MARGIN rows of them.
+static void filter_skip_clean_tiles(rarch_softfilter_t *filt, unsigned height)
+{
+   unsigned i, tiles = filt->num_packets, lo = tiles, hi = 0;
+
+   if (filt->dirty_first < filt->dirty_last)
+   {
+      for (i = 0; i < tiles; i++)
+      {
+         unsigned start = (height * i) / tiles;
+         unsigned end = (height * (i + 1)) / tiles;
+         if (end + SOFTFILTER_TILE_MARGIN > filt->dirty_first &&
+               start < filt->dirty_last + SOFTFILTER_TILE_MARGIN)
+         {
+            if (lo == tiles)
+               lo = i;
+            hi = i + 1;
+         }
+      }
+   }
+
+   if (lo >= hi)
+   {
+      filt->num_packets = 0;
+      filt->processed_first = filt->processed_last = 0;
+      return;
+   }
+
+   memmove(filt->packets, filt->packets + lo, (hi - lo) * sizeof(*filt->packets));
+   filt->num_packets = hi - lo;
+   filt->processed_first = (height * lo) / tiles;
+   filt->processed_last = (height * hi) / tiles;
+}
+
+static void filter_prepare(rarch_softfilter_t *filt,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride)
 {
-   unsigned i;
+   filt->processed_first = 0;
+   filt->processed_last = height;
 
-   if (filt && filt->impl && filt->impl->get_work_packets)
-      filt->impl->get_work_packets(filt->impl_data, filt->packets,
+   if (filt->band_workers)
+   {
+      struct filter_band_frame *frame = &filt->band_frame;
+      filter_band_query_size(filt, width, height);
+      frame->output = output;
+      frame->output_stride = output_stride;
+      frame->input = input;
+      frame->input_stride = input_stride;
+      frame->bands = (frame->height[filt->num_passes] + filt->band_rows - 1) / filt->band_rows;
+      frame->next_band = 0;
+      frame->frame_count = filt->frame_count++;
+   }
+   else if (filt->tiled)
+   {
+      filt->num_packets = filt->passes[0].impl->get_work_tiles(filt->impl_data, filt->packets,
+            output, output_stride, input, width, height, input_stride);
+      if (filt->dirty && !filt->frame_dependent)
+         filter_skip_clean_tiles(filt, height);
+   }
+   else if (filt->passes[0].impl->get_work_packets)
+      filt->passes[0].impl->get_work_packets(filt->impl_data, filt->packets,
             output, output_stride, input, width, height, input_stride);
-   
+
+   filt->dirty = false;
+}
+
+static void filter_run_serial(rarch_softfilter_t *filt)
+{
+   unsigned i;
+   for (i = 0; i < filt->num_packets; i++)
+   {
+      if (filt->packets[i].work)
+         filt->packets[i].work(filt->userdata, filt->packets[i].thread_data);
+   }
+}
+
+void rarch_softfilter_process(rarch_softfilter_t *filt,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   rarch_softfilter_wait(filt);
+   filter_prepare(filt, output, output_stride, input, width, height, input_stride);
+   if (filt->tiled && !filt->num_packets)
+      return; // Every tile is clean.
+
 #ifdef HAVE_THREADS
-   // Fire off workers
-   for (i = 0; i < filt->threads; i++)
+   if (filt->workers)
    {
-      //RARCH_LOG("Firing off filter thread %u ...\n", i);
-      filt->thread_data[i].packet = &filt->packets[i];
-      slock_lock(filt->thread_data[i].lock);
-      filt->thread_data[i].done = false;
-      scond_signal(filt->thread_data[i].cond);
-      slock_unlock(filt->thread_data[i].lock);
+      // Measures waking the workers and waiting for stragglers,
+      // but not the share of the work done by the calling thread.
+      RARCH_PERFORMANCE_INIT(softfilter_dispatch);
+      RARCH_PERFORMANCE_START(softfilter_dispatch);
+
+      sthread_pool_start(filt->pool, filter_pool_job, filt, filt->num_packets);
+
+      if (!filt->async)
+      {
+         retro_perf_tick_t work_start = rarch_get_perf_counter();
+         sthread_pool_help(filt->pool);
+         softfilter_dispatch.start += rarch_get_perf_counter() - work_start;
+      }
+
+      sthread_pool_wait(filt->pool);
+
+      RARCH_PERFORMANCE_STOP(softfilter_dispatch);
+      return;
    }
+#endif
+
+   filter_run_serial(filt);
+}
 
-   // Wait for workers
-   for (i = 0; i < filt->threads; i++)
+void rarch_softfilter_process_async(rarch_softfilter_t *filt,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   rarch_softfilter_wait(filt);
+   filter_prepare(filt, output, output_stride, input, width, height, input_stride);
+   if (filt->tiled && !filt->num_packets)
+      return; // Every tile is clean.
+
+#ifdef HAVE_THREADS
+   if (filt->async && filt->workers)
    {
-      //RARCH_LOG("Waiting for filter thread %u ...\n", i);
-      slock_lock(filt->thread_data[i].lock);
-      while (!filt->thread_data[i].done)
-         scond_wait(filt->thread_data[i].cond, filt->thread_data[i].lock);
-      slock_unlock(filt->thread_data[i].lock);
+      sthread_pool_start(filt->pool, filter_pool_job, filt, filt->num_packets);
+      filt->busy = true;
+      return;
    }
-#else
-   for (i = 0; i < filt->threads; i++)
-      filt->packets[i].work(filt->impl_data, filt->packets[i].thread_data);
 #endif
+
+   filter_run_serial(filt);
 }
 
+void rarch_softfilter_wait(rarch_softfilter_t *filt)
+{
+#ifdef HAVE_THREADS
+   if (filt->busy)
+   {
+      sthread_pool_wait(filt->pool);
+      filt->busy = false;
+   }
+#endif
+}
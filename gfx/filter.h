@@ -17,6 +17,7 @@
 #define RARCH_FILTER_H__
 
 #include "../libretro.h"
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "filters/softfilter.h"
@@ -24,8 +25,10 @@
 #define RARCH_SOFTFILTER_THREADS_AUTO 0
 typedef struct rarch_softfilter rarch_softfilter_t;
 
+// If async is set, rarch_softfilter_process_async() can be used to filter
+// a frame in the background while the caller goes on with other work.
 rarch_softfilter_t *rarch_softfilter_new(const char *filter_path,
-      unsigned threads,
+      unsigned threads, bool async,
       enum retro_pixel_format in_pixel_format,
       unsigned max_width, unsigned max_height);
 
@@ -44,6 +47,28 @@ void rarch_softfilter_process(rarch_softfilter_t *filt,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride);
 
+// Starts filtering a frame and returns immediately.
+// Input and output must be left alone until rarch_softfilter_wait() returns.
+// Falls back to synchronous processing if the filter was not created as async.
+void rarch_softfilter_process_async(rarch_softfilter_t *filt,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride);
+
+// Returns true if output changes every frame even if the input does not,
+// so an unchanged frame still has to be filtered rather than dropped as a dupe.
+bool rarch_softfilter_is_frame_dependent(rarch_softfilter_t *filt);
+
+// Lets the next process call skip work for output which only depends on input rows
+// outside of [first, last), provided the output buffer still holds the previous result.
+// Only takes effect for filters split into tiles whose output does not depend on the frame.
+void rarch_softfilter_set_dirty_rows(rarch_softfilter_t *filt, unsigned first, unsigned last);
+
+// Returns in [*first, *last) the input rows for which the last process call updated the output.
+void rarch_softfilter_get_processed_rows(rarch_softfilter_t *filt, unsigned *first, unsigned *last);
+
+// Waits for a frame started with rarch_softfilter_process_async() to complete.
+void rarch_softfilter_wait(rarch_softfilter_t *filt);
+
 const char *rarch_softfilter_get_name(void *data);
 
 #endif
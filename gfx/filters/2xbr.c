@@ -56,6 +56,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
    uint16_t RGBtoYUV[65536];
@@ -79,6 +80,12 @@ static unsigned twoxbr_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned twoxbr_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 #define RED_MASK565   0xF800
 #define GREEN_MASK565 0x07E0
 #define BLUE_MASK565  0x001F
@@ -223,8 +230,10 @@ static void *twoxbr_generic_create(unsigned in_fmt, unsigned out_fmt,
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -524,17 +533,25 @@ int eq8(uint32_t A, uint32_t B, uint32_t pg_red_mask, uint32_t pg_green_mask, ui
  
  
  
-#define twoxbr_declare_variables(typename_t, in, nextline) \
+// Offsets to the two rows above and below. Rows outside the frame are replaced by
+// the closest row inside it, so output does not depend on how the frame is split into slices.
+#define twoxbr_row_offsets(y, height, first, last, stride) \
+         prevline = (first) + (y) == 0 ? 0 : (stride); \
+         prevline2 = (first) + (y) < 2 ? prevline : prevline + (stride); \
+         nextline = ((last) && (y) + 1 >= (height)) ? 0 : (stride); \
+         nextline2 = ((last) && (y) + 2 >= (height)) ? nextline : nextline + (stride)
+
+#define twoxbr_declare_variables(typename_t, in, prevline, prevline2, nextline, nextline2) \
          typename_t E[4]; \
          typename_t ex, e, i, ke, ki, ex2, ex3, px; \
-         typename_t A1 = *(in - nextline - nextline - 1); \
-         typename_t B1 = *(in - nextline - nextline); \
-         typename_t C1 = *(in - nextline - nextline + 1); \
-         typename_t A0 = *(in - nextline - 2); \
-         typename_t PA = *(in - nextline - 1); \
-         typename_t PB = *(in - nextline); \
-         typename_t PC = *(in - nextline + 1); \
-         typename_t C4 = *(in - nextline + 2); \
+         typename_t A1 = *(in - prevline2 - 1); \
+         typename_t B1 = *(in - prevline2); \
+         typename_t C1 = *(in - prevline2 + 1); \
+         typename_t A0 = *(in - prevline - 2); \
+         typename_t PA = *(in - prevline - 1); \
+         typename_t PB = *(in - prevline); \
+         typename_t PC = *(in - prevline + 1); \
+         typename_t C4 = *(in - prevline + 2); \
          typename_t D0 = *(in - 2); \
          typename_t PD = *(in - 1); \
          typename_t PE = *(in); \
@@ -545,9 +562,9 @@ int eq8(uint32_t A, uint32_t B, uint32_t pg_red_mask, uint32_t pg_green_mask, ui
          typename_t PH = *(in + nextline); \
          typename_t PI = *(in + nextline + 1); \
          typename_t I4 = *(in + nextline + 2); \
-         typename_t G5 = *(in + nextline + nextline - 1); \
-         typename_t H5 = *(in + nextline + nextline); \
-         typename_t I5 = *(in + nextline + nextline + 1); \
+         typename_t G5 = *(in + nextline2 - 1); \
+         typename_t H5 = *(in + nextline2); \
+         typename_t I5 = *(in + nextline2 + 1); \
  
 #ifndef twoxbr_function
 #define twoxbr_function(FILTRO, Z) \
@@ -569,7 +586,7 @@ static void twoxbr_generic_xrgb8888(void *data, unsigned width, unsigned height,
       int first, int last, uint32_t *src,
       unsigned src_stride, uint32_t *dst, unsigned dst_stride)
 {
-   unsigned nextline, finish;
+   unsigned prevline, prevline2, nextline, nextline2, finish, y;
    uint32_t pg_red_mask      = RED_MASK8888;
    uint32_t pg_green_mask    = GREEN_MASK8888;
    uint32_t pg_blue_mask     = BLUE_MASK8888;
@@ -579,16 +596,16 @@ static void twoxbr_generic_xrgb8888(void *data, unsigned width, unsigned height,
 
    (void)filt;
 
-   nextline = (last) ? 0 : src_stride;
-   
-   for (; height; height--)
+
+   for (y = 0; y < height; y++)
    {
+      twoxbr_row_offsets(y, height, first, last, src_stride);
       uint32_t *in  = src;
       uint32_t *out = dst;
  
       for (finish = width; finish; finish -= 1)
       {
-         twoxbr_declare_variables(uint32_t, in, nextline);
+         twoxbr_declare_variables(uint32_t, in, prevline, prevline2, nextline, nextline2);
  
          //---------------------------------------
          // Map of the pixels:          A1 B1 C1
@@ -610,24 +627,23 @@ static void twoxbr_generic_rgb565(void *data, unsigned width, unsigned height,
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
    uint16_t pg_red_mask, pg_green_mask, pg_blue_mask, pg_lbmask;
-   unsigned nextline, finish;
+   unsigned prevline, prevline2, nextline, nextline2, finish, y;
    struct filter_data *filt = data;
 
    pg_red_mask   = RED_MASK565;
    pg_green_mask = GREEN_MASK565;
    pg_blue_mask  = BLUE_MASK565;
    pg_lbmask     = PG_LBMASK565;
-   nextline = (last) ? 0 : src_stride;
-   
- 
-   for (; height; height--)
+
+   for (y = 0; y < height; y++)
    {
+      twoxbr_row_offsets(y, height, first, last, src_stride);
       uint16_t *in  = src;
       uint16_t *out = dst;
  
       for (finish = width; finish; finish -= 1)
       {
-         twoxbr_declare_variables(uint16_t, in, nextline);
+         twoxbr_declare_variables(uint16_t, in, prevline, prevline2, nextline, nextline2);
  
          //---------------------------------------
          // Map of the pixels:          A1 B1 C1
@@ -668,19 +684,19 @@ static void twoxbr_work_cb_xrgb8888(void *data, void *thread_data)
          thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_XRGB8888, output, thr->out_pitch / SOFTFILTER_BPP_XRGB8888);
 }
  
-static void twoxbr_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void twoxbr_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride)
 {
    struct filter_data *filt = data;
    unsigned i;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
  
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * TWOXBR_SCALE * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -701,6 +717,26 @@ static void twoxbr_generic_packets(void *data,
       packets[i].thread_data = thr;
    }
 }
+
+static void twoxbr_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   twoxbr_setup_packets(data, packets, twoxbr_generic_threads(data),
+         output, output_stride, input, width, height, input_stride);
+}
+
+static unsigned twoxbr_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   twoxbr_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride);
+   return tiles;
+}
  
 static const struct softfilter_implementation twoxbr_generic = {
    twoxbr_generic_input_fmts,
@@ -714,6 +750,8 @@ static const struct softfilter_implementation twoxbr_generic = {
    twoxbr_generic_packets,
    "2xBR",
    SOFTFILTER_API_VERSION,
+   twoxbr_generic_num_tiles,
+   twoxbr_generic_tiles,
 };
  
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
@@ -17,6 +17,7 @@
 // Compile: gcc -o twoxsai.so -shared twoxsai.c -std=c99 -O3 -Wall -pedantic -fPIC
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 
 #define TWOXSAI_SCALE 2
@@ -37,6 +38,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
 };
@@ -57,6 +59,12 @@ static unsigned twoxsai_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned twoxsai_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void *twoxsai_generic_create(unsigned in_fmt, unsigned out_fmt,
       unsigned max_width, unsigned max_height,
       unsigned threads, softfilter_simd_mask_t simd)
@@ -66,8 +74,10 @@ static void *twoxsai_generic_create(unsigned in_fmt, unsigned out_fmt,
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -104,12 +114,19 @@ static void twoxsai_generic_destroy(void *data)
 
 #define twoxsai_result(A, B, C, D) (((A) != (C) || (A) != (D)) - ((B) != (C) || (B) != (D)));
 
-#define twoxsai_declare_variables(typename_t, in, nextline) \
+// Offsets to the row above, and the two rows below. Rows outside the frame are replaced by
+// the closest row inside it, so output does not depend on how the frame is split into slices.
+#define twoxsai_row_offsets(y, height, first, last, stride) \
+         prevline = (first) + (y) == 0 ? 0 : (stride); \
+         nextline = ((last) && (y) + 1 >= (height)) ? 0 : (stride); \
+         nextline2 = ((last) && (y) + 2 >= (height)) ? nextline : nextline + (stride)
+
+#define twoxsai_declare_variables(typename_t, in, prevline, nextline, nextline2) \
          typename_t product, product1, product2; \
-         typename_t colorI = *(in - nextline - 1); \
-         typename_t colorE = *(in - nextline + 0); \
-         typename_t colorF = *(in - nextline + 1); \
-         typename_t colorJ = *(in - nextline + 2); \
+         typename_t colorI = *(in - prevline - 1); \
+         typename_t colorE = *(in - prevline + 0); \
+         typename_t colorF = *(in - prevline + 1); \
+         typename_t colorJ = *(in - prevline + 2); \
          typename_t colorG = *(in - 1); \
          typename_t colorA = *(in + 0); \
          typename_t colorB = *(in + 1); \
@@ -118,10 +135,10 @@ static void twoxsai_generic_destroy(void *data)
          typename_t colorC = *(in + nextline + 0); \
          typename_t colorD = *(in + nextline + 1); \
          typename_t colorL = *(in + nextline + 2); \
-         typename_t colorM = *(in + nextline + nextline - 1); \
-         typename_t colorN = *(in + nextline + nextline + 0); \
-         typename_t colorO = *(in + nextline + nextline + 1); \
-         //typename_t colorP = *(in + nextline + nextline + 2);
+         typename_t colorM = *(in + nextline2 - 1); \
+         typename_t colorN = *(in + nextline2 + 0); \
+         typename_t colorO = *(in + nextline2 + 1); \
+         //typename_t colorP = *(in + nextline2 + 2);
 
 #ifndef twoxsai_function
 #define twoxsai_function(result_cb, interpolate_cb, interpolate2_cb) \
@@ -215,17 +232,17 @@ static void twoxsai_generic_xrgb8888(unsigned width, unsigned height,
       int first, int last, uint32_t *src, 
       unsigned src_stride, uint32_t *dst, unsigned dst_stride)
 {
-   unsigned nextline, finish;
-   nextline = (last) ? 0 : src_stride;
+   unsigned prevline, nextline, nextline2, finish, y;
 
-   for (; height; height--)
+   for (y = 0; y < height; y++)
    {
+      twoxsai_row_offsets(y, height, first, last, src_stride);
       uint32_t *in  = src;
       uint32_t *out = dst;
 
       for (finish = width; finish; finish -= 1)
       {
-         twoxsai_declare_variables(uint32_t, in, nextline);
+         twoxsai_declare_variables(uint32_t, in, prevline, nextline, nextline2);
 
          //---------------------------------------
          // Map of the pixels:           I|E F|J
@@ -245,17 +262,17 @@ static void twoxsai_generic_rgb565(unsigned width, unsigned height,
       int first, int last, uint16_t *src, 
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
-   unsigned nextline, finish;
-   nextline = (last) ? 0 : src_stride;
+   unsigned prevline, nextline, nextline2, finish, y;
 
-   for (; height; height--)
+   for (y = 0; y < height; y++)
    {
+      twoxsai_row_offsets(y, height, first, last, src_stride);
       uint16_t *in  = src;
       uint16_t *out = dst;
 
       for (finish = width; finish; finish -= 1)
       {
-         twoxsai_declare_variables(uint16_t, in, nextline);
+         twoxsai_declare_variables(uint16_t, in, prevline, nextline, nextline2);
 
          //---------------------------------------
          // Map of the pixels:           I|E F|J
@@ -271,43 +288,158 @@ static void twoxsai_generic_rgb565(unsigned width, unsigned height,
    }
 }
 
-static void twoxsai_work_cb_rgb565(void *data, void *thread_data)
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+// Vector version of twoxsai_function for 'lanes' consecutive pixels.
+// Every branch of the C version is turned into a lane mask. The four top-level cases
+// are disjoint, so each output is a chain of selects.
+// The colorA == colorB special case needs no mask of its own, as all interpolations
+// of four equal colors return that color.
+#define twoxsai_simd_block(V, S, load, store2, interpolate_cb, interpolate2_cb) \
+         const V colorI = load(in - prevline - 1); \
+         const V colorE = load(in - prevline + 0); \
+         const V colorF = load(in - prevline + 1); \
+         const V colorJ = load(in - prevline + 2); \
+         const V colorG = load(in - 1); \
+         const V colorA = load(in + 0); \
+         const V colorB = load(in + 1); \
+         const V colorK = load(in + 2); \
+         const V colorH = load(in + nextline - 1); \
+         const V colorC = load(in + nextline + 0); \
+         const V colorD = load(in + nextline + 1); \
+         const V colorL = load(in + nextline + 2); \
+         const V colorM = load(in + nextline2 - 1); \
+         const V colorN = load(in + nextline2 + 0); \
+         const V colorO = load(in + nextline2 + 1); \
+         const V a_eq_d = SF_EQ(V, colorA, colorD); \
+         const V b_eq_c = SF_EQ(V, colorB, colorC); \
+         const V case1 = a_eq_d & ~b_eq_c; \
+         const V case2 = b_eq_c & ~a_eq_d; \
+         const V case3 = a_eq_d & b_eq_c; \
+         const V case4 = ~(a_eq_d | b_eq_c); \
+         const V prod_a = SF_EQ(V, colorA, colorC) & SF_EQ(V, colorA, colorF) & SF_NE(V, colorB, colorE) & SF_EQ(V, colorB, colorJ); \
+         const V prod_b = SF_EQ(V, colorB, colorE) & SF_EQ(V, colorB, colorD) & SF_NE(V, colorA, colorF) & SF_EQ(V, colorA, colorI); \
+         const V prod1_a = SF_EQ(V, colorA, colorB) & SF_EQ(V, colorA, colorH) & SF_NE(V, colorG, colorC) & SF_EQ(V, colorC, colorM); \
+         const V prod1_c = SF_EQ(V, colorC, colorG) & SF_EQ(V, colorC, colorD) & SF_NE(V, colorA, colorH) & SF_EQ(V, colorA, colorI); \
+         const S r = twoxsai_simd_result(S, colorA, colorB, colorG, colorE) + \
+            twoxsai_simd_result(S, colorB, colorA, colorK, colorF) + \
+            twoxsai_simd_result(S, colorB, colorA, colorH, colorN) + \
+            twoxsai_simd_result(S, colorA, colorB, colorL, colorO); \
+         const V r_pos = (V)(r > 0); \
+         const V r_neg = (V)(r < 0); \
+         const V sel_a = (case1 & ((SF_EQ(V, colorA, colorE) & SF_EQ(V, colorB, colorL)) | prod_a)) | (case4 & prod_a); \
+         const V sel_b = (case2 & ((SF_EQ(V, colorB, colorF) & SF_EQ(V, colorA, colorH)) | prod_b)) | (case4 & ~prod_a & prod_b); \
+         const V sel1_a = (case1 & ((SF_EQ(V, colorA, colorG) & SF_EQ(V, colorC, colorO)) | prod1_a)) | (case4 & prod1_a); \
+         const V sel1_c = (case2 & ((SF_EQ(V, colorC, colorH) & SF_EQ(V, colorA, colorF)) | prod1_c)) | (case4 & ~prod1_a & prod1_c); \
+         const V product = SF_SELECT(sel_a, colorA, SF_SELECT(sel_b, colorB, interpolate_cb(colorA, colorB))); \
+         const V product1 = SF_SELECT(sel1_a, colorA, SF_SELECT(sel1_c, colorC, interpolate_cb(colorA, colorC))); \
+         const V product2 = SF_SELECT(case1 | (case3 & r_pos), colorA, \
+               SF_SELECT(case2 | (case3 & r_neg), colorB, interpolate2_cb(colorA, colorB, colorC, colorD))); \
+         store2(out, colorA, product); \
+         store2(out + dst_stride, product1, product2)
+
+// Same as twoxsai_result, with lane masks (-1) in place of booleans.
+#define twoxsai_simd_result(S, A, B, C, D) ((S)((B) != (C)) | (S)((B) != (D))) - ((S)((A) != (C)) | (S)((A) != (D)))
+
+// Vectorized twoxsai_generic_*. Trailing pixels which do not fill a vector go through the C version.
+#define twoxsai_simd_frame(name, target, typename_t, V, S, lanes, load, store2, interpolate_cb, interpolate2_cb) \
+static target void name(unsigned width, unsigned height, \
+      int first, int last, typename_t *src, \
+      unsigned src_stride, typename_t *dst, unsigned dst_stride) \
+{ \
+   unsigned prevline, nextline, nextline2, x, y; \
+ \
+   for (y = 0; y < height; y++) \
+   { \
+      twoxsai_row_offsets(y, height, first, last, src_stride); \
+      typename_t *in  = src; \
+      typename_t *out = dst; \
+ \
+      for (x = 0; x + lanes <= width; x += lanes, in += lanes, out += 2 * lanes) \
+      { \
+         twoxsai_simd_block(V, S, load, store2, interpolate_cb, interpolate2_cb); \
+      } \
+ \
+      for (; x < width; x++) \
+      { \
+         twoxsai_declare_variables(typename_t, in, prevline, nextline, nextline2); \
+         twoxsai_function(twoxsai_result, interpolate_cb, interpolate2_cb); \
+      } \
+ \
+      src += src_stride; \
+      dst += 2 * dst_stride; \
+   } \
+}
+
+twoxsai_simd_frame(twoxsai_sse2_rgb565, SOFTFILTER_TARGET_SSE2, uint16_t, sf_sse2_u16, sf_sse2_s16,
+      SF_SSE2_LANES_16, sf_sse2_load_u16, sf_sse2_store2_u16,
+      twoxsai_interpolate_rgb565, twoxsai_interpolate2_rgb565)
+twoxsai_simd_frame(twoxsai_sse2_xrgb8888, SOFTFILTER_TARGET_SSE2, uint32_t, sf_sse2_u32, sf_sse2_s32,
+      SF_SSE2_LANES_32, sf_sse2_load_u32, sf_sse2_store2_u32,
+      twoxsai_interpolate_xrgb8888, twoxsai_interpolate2_xrgb8888)
+twoxsai_simd_frame(twoxsai_avx2_rgb565, SOFTFILTER_TARGET_AVX2, uint16_t, sf_avx2_u16, sf_avx2_s16,
+      SF_AVX2_LANES_16, sf_avx2_load_u16, sf_avx2_store2_u16,
+      twoxsai_interpolate_rgb565, twoxsai_interpolate2_rgb565)
+twoxsai_simd_frame(twoxsai_avx2_xrgb8888, SOFTFILTER_TARGET_AVX2, uint32_t, sf_avx2_u32, sf_avx2_s32,
+      SF_AVX2_LANES_32, sf_avx2_load_u32, sf_avx2_store2_u32,
+      twoxsai_interpolate_xrgb8888, twoxsai_interpolate2_xrgb8888)
+#endif
+
+typedef void (*twoxsai_rgb565_t)(unsigned width, unsigned height,
+      int first, int last, uint16_t *src,
+      unsigned src_stride, uint16_t *dst, unsigned dst_stride);
+
+typedef void (*twoxsai_xrgb8888_t)(unsigned width, unsigned height,
+      int first, int last, uint32_t *src,
+      unsigned src_stride, uint32_t *dst, unsigned dst_stride);
+
+static void twoxsai_work_rgb565(void *thread_data, twoxsai_rgb565_t process)
 {
    struct softfilter_thread_data *thr = thread_data;
-   uint16_t *input = thr->in_data;
+   uint16_t *input = (uint16_t*)thr->in_data;
    uint16_t *output = thr->out_data;
    unsigned width = thr->width;
    unsigned height = thr->height;
 
-   twoxsai_generic_rgb565(width, height,
+   process(width, height,
          thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
 }
 
-static void twoxsai_work_cb_xrgb8888(void *data, void *thread_data)
+static void twoxsai_work_xrgb8888(void *thread_data, twoxsai_xrgb8888_t process)
 {
    struct softfilter_thread_data *thr = thread_data;
-   uint32_t *input = thr->in_data;
+   uint32_t *input = (uint32_t*)thr->in_data;
    uint32_t *output = thr->out_data;
    unsigned width = thr->width;
    unsigned height = thr->height;
 
-   twoxsai_generic_xrgb8888(width, height,
+   process(width, height,
          thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_XRGB8888, output, thr->out_pitch / SOFTFILTER_BPP_XRGB8888);
 }
 
-static void twoxsai_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void twoxsai_work_cb_rgb565(void *data, void *thread_data)
+{
+   twoxsai_work_rgb565(thread_data, twoxsai_generic_rgb565);
+}
+
+static void twoxsai_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   twoxsai_work_xrgb8888(thread_data, twoxsai_generic_xrgb8888);
+}
+
+static void twoxsai_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
-      const void *input, unsigned width, unsigned height, size_t input_stride)
+      const void *input, unsigned width, unsigned height, size_t input_stride,
+      softfilter_work_t work_rgb565, softfilter_work_t work_xrgb8888)
 {
    struct filter_data *filt = data;
    unsigned i;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
 
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * TWOXSAI_SCALE * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -320,15 +452,37 @@ static void twoxsai_generic_packets(void *data,
       thr->last = y_end == height;
 
       if (filt->in_fmt == SOFTFILTER_FMT_RGB565)
-         packets[i].work = twoxsai_work_cb_rgb565;
+         packets[i].work = work_rgb565;
       //else if (filt->in_fmt == SOFTFILTER_FMT_RGB4444)
          //packets[i].work = twoxsai_work_cb_rgb4444;
       else if (filt->in_fmt == SOFTFILTER_FMT_XRGB8888)
-         packets[i].work = twoxsai_work_cb_xrgb8888;
+         packets[i].work = work_xrgb8888;
       packets[i].thread_data = thr;
    }
 }
 
+static void twoxsai_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   twoxsai_setup_packets(data, packets, twoxsai_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         twoxsai_work_cb_rgb565, twoxsai_work_cb_xrgb8888);
+}
+
+static unsigned twoxsai_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   twoxsai_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         twoxsai_work_cb_rgb565, twoxsai_work_cb_xrgb8888);
+   return tiles;
+}
+
 static const struct softfilter_implementation twoxsai_generic = {
    twoxsai_generic_input_fmts,
    twoxsai_generic_output_fmts,
@@ -341,10 +495,117 @@ static const struct softfilter_implementation twoxsai_generic = {
    twoxsai_generic_packets,
    "2xSaI",
    SOFTFILTER_API_VERSION,
+   twoxsai_generic_num_tiles,
+   twoxsai_generic_tiles,
 };
 
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+static void twoxsai_sse2_work_cb_rgb565(void *data, void *thread_data)
+{
+   twoxsai_work_rgb565(thread_data, twoxsai_sse2_rgb565);
+}
+
+static void twoxsai_sse2_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   twoxsai_work_xrgb8888(thread_data, twoxsai_sse2_xrgb8888);
+}
+
+static void twoxsai_sse2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   twoxsai_setup_packets(data, packets, twoxsai_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         twoxsai_sse2_work_cb_rgb565, twoxsai_sse2_work_cb_xrgb8888);
+}
+
+static unsigned twoxsai_sse2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   twoxsai_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         twoxsai_sse2_work_cb_rgb565, twoxsai_sse2_work_cb_xrgb8888);
+   return tiles;
+}
+
+static const struct softfilter_implementation twoxsai_sse2 = {
+   twoxsai_generic_input_fmts,
+   twoxsai_generic_output_fmts,
+
+   twoxsai_generic_create,
+   twoxsai_generic_destroy,
+
+   twoxsai_generic_threads,
+   twoxsai_generic_output,
+   twoxsai_sse2_packets,
+   "2xSaI (SSE2)",
+   SOFTFILTER_API_VERSION,
+   twoxsai_generic_num_tiles,
+   twoxsai_sse2_tiles,
+};
+
+static void twoxsai_avx2_work_cb_rgb565(void *data, void *thread_data)
+{
+   twoxsai_work_rgb565(thread_data, twoxsai_avx2_rgb565);
+}
+
+static void twoxsai_avx2_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   twoxsai_work_xrgb8888(thread_data, twoxsai_avx2_xrgb8888);
+}
+
+static void twoxsai_avx2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   twoxsai_setup_packets(data, packets, twoxsai_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         twoxsai_avx2_work_cb_rgb565, twoxsai_avx2_work_cb_xrgb8888);
+}
+
+static unsigned twoxsai_avx2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   twoxsai_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         twoxsai_avx2_work_cb_rgb565, twoxsai_avx2_work_cb_xrgb8888);
+   return tiles;
+}
+
+static const struct softfilter_implementation twoxsai_avx2 = {
+   twoxsai_generic_input_fmts,
+   twoxsai_generic_output_fmts,
+
+   twoxsai_generic_create,
+   twoxsai_generic_destroy,
+
+   twoxsai_generic_threads,
+   twoxsai_generic_output,
+   twoxsai_avx2_packets,
+   "2xSaI (AVX2)",
+   SOFTFILTER_API_VERSION,
+   twoxsai_generic_num_tiles,
+   twoxsai_avx2_tiles,
+};
+#endif
+
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
 {
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+   if (simd & SOFTFILTER_SIMD_AVX2)
+      return &twoxsai_avx2;
+   if (simd & SOFTFILTER_SIMD_SSE2)
+      return &twoxsai_sse2;
+#else
    (void)simd;
+#endif
    return &twoxsai_generic;
 }
@@ -31,16 +31,19 @@ struct softfilter_thread_data
    unsigned height;
    int first;
    int last;
+   int burst;
 };
 
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
    struct snes_ntsc_t *ntsc;
    int burst;
    int burst_toggle;
+   unsigned first_row;
 };
 
 
@@ -60,6 +63,12 @@ static unsigned blargg_ntsc_snes_composite_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned blargg_ntsc_snes_composite_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void blargg_ntsc_snes_composite_initialize(void *data)
 {
    snes_ntsc_setup_t setup;
@@ -83,8 +92,10 @@ static void *blargg_ntsc_snes_composite_generic_create(unsigned in_fmt, unsigned
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -114,24 +125,22 @@ static void blargg_ntsc_snes_composite_generic_destroy(void *data)
 }
 
 static void blargg_ntsc_snes_composite_render_rgb565(void *data, int width, int height,
-      int first, int last,
+      int first, int last, int burst,
       uint16_t *input, int pitch, uint16_t *output, int outpitch)
 {
    struct filter_data *filt = data;
    if(width <= 256)
-      snes_ntsc_blit(filt->ntsc, input, pitch, filt->burst, width, height, output, outpitch * 2, first, last);
+      snes_ntsc_blit(filt->ntsc, input, pitch, burst, width, height, output, outpitch * 2, first, last);
    else
-      snes_ntsc_blit_hires(filt->ntsc, input, pitch, filt->burst, width, height, output, outpitch * 2, first, last);
-
-   filt->burst ^= filt->burst_toggle;
+      snes_ntsc_blit_hires(filt->ntsc, input, pitch, burst, width, height, output, outpitch * 2, first, last);
 }
 
 static void blargg_ntsc_snes_composite_rgb565(void *data, unsigned width, unsigned height,
-      int first, int last, uint16_t *src, 
+      int first, int last, int burst, uint16_t *src, 
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
    blargg_ntsc_snes_composite_render_rgb565(data, width, height,
-         first, last,
+         first, last, burst,
          src, src_stride,
          dst, dst_stride);
 }
@@ -145,22 +154,22 @@ static void blargg_ntsc_snes_composite_work_cb_rgb565(void *data, void *thread_d
    unsigned height = thr->height;
 
    blargg_ntsc_snes_composite_rgb565(data, width, height,
-         thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
+         thr->first, thr->last, thr->burst, input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
 }
 
-static void blargg_ntsc_snes_composite_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void blargg_ntsc_snes_composite_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride)
 {
    struct filter_data *filt = data;
    unsigned i;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
 
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -172,10 +181,51 @@ static void blargg_ntsc_snes_composite_generic_packets(void *data,
       thr->first = y_start;
       thr->last = y_end == height;
 
+      // The burst phase advances every row, so slices start where the previous one left off.
+      thr->burst = (filt->burst + filt->first_row + y_start) % snes_ntsc_burst_count;
+
       if (filt->in_fmt == SOFTFILTER_FMT_RGB565)
          packets[i].work = blargg_ntsc_snes_composite_work_cb_rgb565;
       packets[i].thread_data = thr;
    }
+
+   filt->burst ^= filt->burst_toggle;
+   filt->first_row = 0;
+}
+
+static void blargg_ntsc_snes_composite_generic_band(void *data, unsigned frame_count, unsigned first_row)
+{
+   struct filter_data *filt = data;
+
+   // Same phase as toggling once per frame, but shared by every instance filtering a band of the frame.
+   filt->burst = (frame_count & 1) ? filt->burst_toggle : 0;
+   filt->first_row = first_row;
+}
+
+static bool blargg_ntsc_snes_composite_generic_frame_dependent(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->burst_toggle != 0;
+}
+
+static void blargg_ntsc_snes_composite_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   blargg_ntsc_snes_composite_setup_packets(data, packets, blargg_ntsc_snes_composite_generic_threads(data),
+         output, output_stride, input, width, height, input_stride);
+}
+
+static unsigned blargg_ntsc_snes_composite_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   blargg_ntsc_snes_composite_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride);
+   return tiles;
 }
 
 static const struct softfilter_implementation blargg_ntsc_snes_composite_generic = {
@@ -190,6 +240,10 @@ static const struct softfilter_implementation blargg_ntsc_snes_composite_generic
    blargg_ntsc_snes_composite_generic_packets,
    "Blargg NTSC SNES Composite",
    SOFTFILTER_API_VERSION,
+   blargg_ntsc_snes_composite_generic_num_tiles,
+   blargg_ntsc_snes_composite_generic_tiles,
+   blargg_ntsc_snes_composite_generic_band,
+   blargg_ntsc_snes_composite_generic_frame_dependent,
 };
 
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
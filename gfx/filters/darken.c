@@ -37,6 +37,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
 };
@@ -57,6 +58,12 @@ static unsigned darken_threads(void *data)
    return filt->threads;
 }
 
+static unsigned darken_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void *darken_create(unsigned in_fmt, unsigned out_fmt,
       unsigned max_width, unsigned max_height,
       unsigned threads, softfilter_simd_mask_t simd)
@@ -66,8 +73,10 @@ static void *darken_create(unsigned in_fmt, unsigned out_fmt,
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -119,18 +128,18 @@ static void darken_work_cb_rgb565(void *data, void *thread_data)
          output[x] = (input[x] >> 2) & ((0x7 << 0) | (0xf << 5) | (0x7 << 11));
 }
 
-static void darken_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void darken_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride)
 {
    unsigned i;
    struct filter_data *filt = data;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -146,6 +155,26 @@ static void darken_packets(void *data,
    }
 }
 
+static void darken_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   darken_setup_packets(data, packets, darken_threads(data),
+         output, output_stride, input, width, height, input_stride);
+}
+
+static unsigned darken_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   darken_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride);
+   return tiles;
+}
+
 static const struct softfilter_implementation darken = {
    darken_input_fmts,
    darken_output_fmts,
@@ -158,6 +187,8 @@ static const struct softfilter_implementation darken = {
    darken_packets,
    "Darken",
    SOFTFILTER_API_VERSION,
+   darken_num_tiles,
+   darken_tiles,
 };
 
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
@@ -17,6 +17,7 @@
 // Compile: gcc -o epx.so -shared epx.c -std=c99 -O3 -Wall -pedantic -fPIC
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 
 #define EPX_SCALE 2
@@ -37,6 +38,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
 };
@@ -57,6 +59,12 @@ static unsigned epx_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned epx_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void *epx_generic_create(unsigned in_fmt, unsigned out_fmt,
       unsigned max_width, unsigned max_height,
       unsigned threads, softfilter_simd_mask_t simd)
@@ -66,8 +74,10 @@ static void *epx_generic_create(unsigned in_fmt, unsigned out_fmt,
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -91,107 +101,79 @@ static void epx_generic_destroy(void *data)
    free(filt);
 }
 
+// Processes inner columns of a row from cur[0] onwards, with the same output as
+// the inner loops of EPX_16. Returns the number of pixels done, which can be less than count.
+// The top and bottom edges pass cur as up or down row respectively, as a missing
+// neighbor equal to the center pixel yields the same conditions and results.
+typedef unsigned (*epx_row_t)(const uint16_t *up, const uint16_t *cur, const uint16_t *down,
+      uint32_t *dst0, uint32_t *dst1, unsigned count);
+
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+#define epx_simd_row(name, target, V, lanes, load, store2) \
+static target unsigned name(const uint16_t *up, const uint16_t *cur, const uint16_t *down, \
+      uint32_t *dst0, uint32_t *dst1, unsigned count) \
+{ \
+   unsigned x; \
+   for (x = 0; x + lanes <= count; x += lanes) \
+   { \
+      const V colorA = load(cur + x - 1); \
+      const V colorX = load(cur + x); \
+      const V colorC = load(cur + x + 1); \
+      const V colorB = load(down + x); \
+      const V colorD = load(up + x); \
+      const V active = SF_NE(V, colorA, colorC) & SF_NE(V, colorB, colorD); \
+      store2((uint16_t*)(dst0 + x), \
+            SF_SELECT(active & SF_EQ(V, colorD, colorA), colorD, colorX), \
+            SF_SELECT(active & SF_EQ(V, colorC, colorD), colorC, colorX)); \
+      store2((uint16_t*)(dst1 + x), \
+            SF_SELECT(active & SF_EQ(V, colorA, colorB), colorA, colorX), \
+            SF_SELECT(active & SF_EQ(V, colorB, colorC), colorB, colorX)); \
+   } \
+   return x; \
+}
+
+epx_simd_row(epx_sse2_row, SOFTFILTER_TARGET_SSE2, sf_sse2_u16,
+      SF_SSE2_LANES_16, sf_sse2_load_u16, sf_sse2_store2_u16)
+epx_simd_row(epx_avx2_row, SOFTFILTER_TARGET_AVX2, sf_avx2_u16,
+      SF_AVX2_LANES_16, sf_avx2_load_u16, sf_avx2_store2_u16)
+#endif
+
+// Lets the row callback do the start of an inner loop of EPX_16, then continues after it.
+#define EPX_ROW() \
+	if (row) \
+	{ \
+		unsigned done = row(uP, sP, lP, dP1, dP2, width - 2); \
+		sP  += done; \
+		uP  += done; \
+		lP  += done; \
+		dP1 += done; \
+		dP2 += done; \
+		w   -= done; \
+		colorX = *(sP - 1); \
+		colorC = *sP; \
+	}
+
 static void EPX_16 (int width, int height,
       int first, int last,
-      uint16_t *src, int src_stride, uint16_t *dst, int dst_stride)
+      uint16_t *src, int src_stride, uint16_t *dst, int dst_stride, epx_row_t row)
 {
 	uint16_t	colorX, colorA, colorB, colorC, colorD;
 	uint16_t	*sP, *uP, *lP;
 	uint32_t	*dP1, *dP2;
-	int		w, prevline;
-
-	prevline = (first) ? 0 : src_stride;
-
-	height -= 2;
+	int		y, w;
 
 	//   D
 	// A X C
 	//   B
 
-	// top edge
+	// Neighbors outside the frame are replaced by the center pixel, which gives the same
+	// results as treating them as missing. Rows outside the slice are read like any other.
 
-	sP  = src - prevline);
-	lP  = src + src_stride;
-	dP1 = (uint32_t *) dst;
-	dP2 = (uint32_t *) (dst + dst_stride);
-
-	// left edge
-
-	colorX = *sP;
-	colorC = *++sP;
-	colorB = *lP++;
-
-	if ((colorX != colorC) && (colorB != colorX))
-	{
-	#ifdef MSB_FIRST
-		*dP1 = (colorX << 16) + colorX;
-		*dP2 = (colorX << 16) + ((colorB == colorC) ? colorB : colorX);
-	#else
-		*dP1 = colorX + (colorX << 16);
-		*dP2 = colorX + (((colorB == colorC) ? colorB : colorX) << 16);
-	#endif
-	}
-	else
-		*dP1 = *dP2 = (colorX << 16) + colorX;
-
-	dP1++;
-	dP2++;
-
-	//
-
-	for (w = width - 2; w; w--)
-	{
-		colorA = colorX;
-		colorX = colorC;
-		colorC = *++sP;
-		colorB = *lP++;
-
-		if ((colorA != colorC) && (colorB != colorX))
-		{
-		#ifdef MSB_FIRST
-			*dP1 = (colorX << 16) + colorX;
-			*dP2 = (((colorA == colorB) ? colorA : colorX) << 16) + ((colorB == colorC) ? colorB : colorX);
-		#else
-			*dP1 = colorX + (colorX << 16);
-			*dP2 = ((colorA == colorB) ? colorA : colorX) + (((colorB == colorC) ? colorB : colorX) << 16);
-		#endif
-		}
-		else
-			*dP1 = *dP2 = (colorX << 16) + colorX;
-
-		dP1++;
-		dP2++;
-	}
-
-	// right edge
-
-	colorA = colorX;
-	colorX = colorC;
-	colorB = *lP;
-
-	if ((colorA != colorX) && (colorB != colorX))
-	{
-	#ifdef MSB_FIRST
-		*dP1 = (colorX << 16) + colorX;
-		*dP2 = (((colorA == colorB) ? colorA : colorX) << 16) + colorX;
-	#else
-		*dP1 = colorX + (colorX << 16);
-		*dP2 = ((colorA == colorB) ? colorA : colorX) + (colorX << 16);
-	#endif
-	}
-	else
-		*dP1 = *dP2 = (colorX << 16) + colorX;
-
-	src += src_stride;
-	dst += dst_stride << 1;
-
-	//
-
-	for (; height; height--)
+	for (y = 0; y < height; y++)
 	{
 		sP  = src;
-		uP  = src - src_stride;
-		lP  = src + src_stride;
+		uP  = (first + y == 0) ? src : src - src_stride;
+		lP  = (last && y == height - 1) ? src : src + src_stride;
 		dP1 = (uint32_t *) dst;
 		dP2 = (uint32_t *) (dst + dst_stride);
 
@@ -220,7 +202,10 @@ static void EPX_16 (int width, int height,
 
 		//
 
-		for (w = width - 2; w; w--)
+		w = width - 2;
+		EPX_ROW();
+
+		for (; w; w--)
 		{
 			colorA = colorX;
 			colorX = colorC;
@@ -268,117 +253,38 @@ static void EPX_16 (int width, int height,
 		src += src_stride;
 		dst += dst_stride << 1;
 	}
-
-	// bottom edge
-
-	sP  = src;
-	uP  = src - src_stride;
-	dP1 = (uint32_t *) dst;
-	dP2 = (uint32_t *) (dst + dst_stride);
-
-	// left edge
-
-	colorX = *sP;
-	colorC = *++sP;
-	colorD = *uP++;
-
-	if ((colorX != colorC) && (colorX != colorD))
-	{
-	#ifdef MSB_FIRST
-		*dP1 = (colorX << 16) + ((colorC == colorD) ? colorC : colorX);
-		*dP2 = (colorX << 16) + colorX;
-	#else
-		*dP1 = colorX + (((colorC == colorD) ? colorC : colorX) << 16);
-		*dP2 = colorX + (colorX << 16);
-	#endif
-	}
-	else
-		*dP1 = *dP2 = (colorX << 16) + colorX;
-
-	dP1++;
-	dP2++;
-
-	//
-
-	for (w = width - 2; w; w--)
-	{
-		colorA = colorX;
-		colorX = colorC;
-		colorC = *++sP;
-		colorD = *uP++;
-
-		if ((colorA != colorC) && (colorX != colorD))
-		{
-		#ifdef MSB_FIRST
-			*dP1 = (((colorD == colorA) ? colorD : colorX) << 16) + ((colorC == colorD) ? colorC : colorX);
-			*dP2 = (colorX << 16) + colorX;
-		#else
-			*dP1 = ((colorD == colorA) ? colorD : colorX) + (((colorC == colorD) ? colorC : colorX) << 16);
-			*dP2 = colorX + (colorX << 16);
-		#endif
-		}
-		else
-			*dP1 = *dP2 = (colorX << 16) + colorX;
-
-		dP1++;
-		dP2++;
-	}
-
-	// right edge
-
-	colorA = colorX;
-	colorX = colorC;
-	colorD = *uP;
-
-	if ((colorA != colorX) && (colorX != colorD))
-	{
-	#ifdef MSB_FIRST
-		*dP1 = (((colorD == colorA) ? colorD : colorX) << 16) + colorX;
-		*dP2 = (colorX << 16) + colorX;
-	#else
-		*dP1 = ((colorD == colorA) ? colorD : colorX) + (colorX << 16);
-		*dP2 = colorX + (colorX << 16);
-	#endif
-	}
-	else
-		*dP1 = *dP2 = (colorX << 16) + colorX;
 }
 
-static void epx_generic_rgb565(unsigned width, unsigned height,
-      int first, int last, uint16_t *src, 
-      unsigned src_stride, uint16_t *dst, unsigned dst_stride)
-{
-   EPX_16(width, height,
-         first, last,
-         src, src_stride,
-         dst, dst_stride);
-}
-
-static void epx_work_cb_rgb565(void *data, void *thread_data)
+static void epx_work_rgb565(void *thread_data, epx_row_t row)
 {
    struct softfilter_thread_data *thr = thread_data;
-   uint16_t *input = thr->in_data;
+   uint16_t *input = (uint16_t*)thr->in_data;
    uint16_t *output = thr->out_data;
    unsigned width = thr->width;
    unsigned height = thr->height;
 
-   epx_generic_rgb565(width, height,
-         thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
+   EPX_16(width, height,
+         thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565, row);
 }
 
+static void epx_work_cb_rgb565(void *data, void *thread_data)
+{
+   epx_work_rgb565(thread_data, NULL);
+}
 
-static void epx_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void epx_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
-      const void *input, unsigned width, unsigned height, size_t input_stride)
+      const void *input, unsigned width, unsigned height, size_t input_stride,
+      softfilter_work_t work_rgb565)
 {
    struct filter_data *filt = data;
-   for (unsigned i = 0; i < filt->threads; i++)
+   for (unsigned i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
 
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * EPX_SCALE * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -391,11 +297,33 @@ static void epx_generic_packets(void *data,
       thr->last = y_end == height;
 
       if (filt->in_fmt == SOFTFILTER_FMT_RGB565)
-         packets[i].work = epx_work_cb_rgb565;
+         packets[i].work = work_rgb565;
       packets[i].thread_data = thr;
    }
 }
 
+static void epx_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   epx_setup_packets(data, packets, epx_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         epx_work_cb_rgb565);
+}
+
+static unsigned epx_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   epx_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         epx_work_cb_rgb565);
+   return tiles;
+}
+
 static const struct softfilter_implementation epx_generic = {
    epx_generic_input_fmts,
    epx_generic_output_fmts,
@@ -408,10 +336,107 @@ static const struct softfilter_implementation epx_generic = {
    epx_generic_packets,
    "EPX",
    SOFTFILTER_API_VERSION,
+   epx_generic_num_tiles,
+   epx_generic_tiles,
+};
+
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+static void epx_sse2_work_cb_rgb565(void *data, void *thread_data)
+{
+   epx_work_rgb565(thread_data, epx_sse2_row);
+}
+
+static void epx_sse2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   epx_setup_packets(data, packets, epx_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         epx_sse2_work_cb_rgb565);
+}
+
+static unsigned epx_sse2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   epx_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         epx_sse2_work_cb_rgb565);
+   return tiles;
+}
+
+static const struct softfilter_implementation epx_sse2 = {
+   epx_generic_input_fmts,
+   epx_generic_output_fmts,
+
+   epx_generic_create,
+   epx_generic_destroy,
+
+   epx_generic_threads,
+   epx_generic_output,
+   epx_sse2_packets,
+   "EPX (SSE2)",
+   SOFTFILTER_API_VERSION,
+   epx_generic_num_tiles,
+   epx_sse2_tiles,
+};
+
+static void epx_avx2_work_cb_rgb565(void *data, void *thread_data)
+{
+   epx_work_rgb565(thread_data, epx_avx2_row);
+}
+
+static void epx_avx2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   epx_setup_packets(data, packets, epx_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         epx_avx2_work_cb_rgb565);
+}
+
+static unsigned epx_avx2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   epx_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         epx_avx2_work_cb_rgb565);
+   return tiles;
+}
+
+static const struct softfilter_implementation epx_avx2 = {
+   epx_generic_input_fmts,
+   epx_generic_output_fmts,
+
+   epx_generic_create,
+   epx_generic_destroy,
+
+   epx_generic_threads,
+   epx_generic_output,
+   epx_avx2_packets,
+   "EPX (AVX2)",
+   SOFTFILTER_API_VERSION,
+   epx_generic_num_tiles,
+   epx_avx2_tiles,
 };
+#endif
 
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
 {
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+   if (simd & SOFTFILTER_SIMD_AVX2)
+      return &epx_avx2;
+   if (simd & SOFTFILTER_SIMD_SSE2)
+      return &epx_sse2;
+#else
    (void)simd;
+#endif
    return &epx_generic;
 }
@@ -37,6 +37,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
 };
@@ -57,6 +58,12 @@ static unsigned lq2x_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned lq2x_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void *lq2x_generic_create(unsigned in_fmt, unsigned out_fmt,
       unsigned max_width, unsigned max_height,
       unsigned threads, softfilter_simd_mask_t simd)
@@ -66,8 +73,10 @@ static void *lq2x_generic_create(unsigned in_fmt, unsigned out_fmt,
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -101,9 +110,10 @@ static void lq2x_generic_rgb565(unsigned width, unsigned height,
 
    for (unsigned y = 0; y < height; y++)
    {
+      // Only rows outside the frame are replaced, not rows outside the slice.
       int prevline, nextline;
-      prevline = (y == 0 ? 0 : src_stride);
-      nextline = (y == height - 1 || last) ? 0 : src_stride;
+      prevline = (first + y == 0) ? 0 : src_stride;
+      nextline = (last && y == height - 1) ? 0 : src_stride;
 
       for (unsigned x = 0; x < width; x++)
       {
@@ -148,8 +158,8 @@ static void lq2x_generic_xrgb8888(unsigned width, unsigned height,
 
    for(y = 0; y < height; y++)
    {
-      int prevline = (y == 0 ? 0 : src_stride);
-      int nextline = (y == height - 1 || last) ? 0 : src_stride;
+      int prevline = (first + y == 0) ? 0 : src_stride;
+      int nextline = (last && y == height - 1) ? 0 : src_stride;
 
       for(x = 0; x < width; x++)
       {
@@ -208,19 +218,19 @@ static void lq2x_work_cb_xrgb8888(void *data, void *thread_data)
          thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_XRGB8888, output, thr->out_pitch / SOFTFILTER_BPP_XRGB8888);
 }
 
-static void lq2x_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void lq2x_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride)
 {
    struct filter_data *filt = data;
    unsigned i;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
 
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * LQ2X_SCALE * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -242,6 +252,26 @@ static void lq2x_generic_packets(void *data,
    }
 }
 
+static void lq2x_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   lq2x_setup_packets(data, packets, lq2x_generic_threads(data),
+         output, output_stride, input, width, height, input_stride);
+}
+
+static unsigned lq2x_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   lq2x_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride);
+   return tiles;
+}
+
 static const struct softfilter_implementation lq2x_generic = {
    lq2x_generic_input_fmts,
    lq2x_generic_output_fmts,
@@ -254,6 +284,8 @@ static const struct softfilter_implementation lq2x_generic = {
    lq2x_generic_packets,
    "LQ2x",
    SOFTFILTER_API_VERSION,
+   lq2x_generic_num_tiles,
+   lq2x_generic_tiles,
 };
 
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
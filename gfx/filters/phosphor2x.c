@@ -40,6 +40,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
    float phosphor_bleed;
@@ -210,6 +211,12 @@ static unsigned phosphor2x_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned phosphor2x_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void *phosphor2x_generic_create(unsigned in_fmt, unsigned out_fmt,
       unsigned max_width, unsigned max_height,
       unsigned threads, softfilter_simd_mask_t simd)
@@ -220,12 +227,13 @@ static void *phosphor2x_generic_create(unsigned in_fmt, unsigned out_fmt,
    (void)simd;
    (void)out_fmt;
    (void)max_width;
-   (void)max_height;
 
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -368,19 +376,19 @@ static void phosphor2x_work_cb_rgb565(void *data, void *thread_data)
          thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
 }
 
-static void phosphor2x_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void phosphor2x_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride)
 {
    struct filter_data *filt = data;
    unsigned i;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
 
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * PHOSPHOR2X_SCALE * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -402,6 +410,26 @@ static void phosphor2x_generic_packets(void *data,
    }
 }
 
+static void phosphor2x_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   phosphor2x_setup_packets(data, packets, phosphor2x_generic_threads(data),
+         output, output_stride, input, width, height, input_stride);
+}
+
+static unsigned phosphor2x_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   phosphor2x_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride);
+   return tiles;
+}
+
 static const struct softfilter_implementation phosphor2x_generic = {
    phosphor2x_generic_input_fmts,
    phosphor2x_generic_output_fmts,
@@ -414,6 +442,8 @@ static const struct softfilter_implementation phosphor2x_generic = {
    phosphor2x_generic_packets,
    "Phosphor2x",
    SOFTFILTER_API_VERSION,
+   phosphor2x_generic_num_tiles,
+   phosphor2x_generic_tiles,
 };
 
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
@@ -17,6 +17,7 @@
 // Compile: gcc -o scale2x.so -shared scale2x.c -std=c99 -O3 -Wall -pedantic -fPIC
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -58,6 +59,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
 };
@@ -121,6 +123,70 @@ static void scale2x_generic_xrgb8888(unsigned width, unsigned height,
    SCALE2X_GENERIC(uint32_t, width, height, first, last, src, src_stride, dst, dst_stride, out0, out1);
 }
 
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+// One output pixel pair of SCALE2X_GENERIC at column x. Used for the columns
+// the vector loop does not cover, i.e. both edges and the tail.
+#define scale2x_simd_pixel(typename_t, x) \
+   { \
+      const typename_t A = *(src + (x) - prevline); \
+      const typename_t B = ((x) > 0) ? *(src + (x) - 1) : *(src + (x)); \
+      const typename_t C = *(src + (x)); \
+      const typename_t D = ((x) < (int)width - 1) ? *(src + (x) + 1) : *(src + (x)); \
+      const typename_t E = *(src + (x) + nextline); \
+      const int active = A != E && B != D; \
+      out0[2 * (x) + 0] = (active && A == B) ? A : C; \
+      out0[2 * (x) + 1] = (active && A == D) ? A : C; \
+      out1[2 * (x) + 0] = (active && E == B) ? E : C; \
+      out1[2 * (x) + 1] = (active && E == D) ? E : C; \
+   }
+
+// Vectorized SCALE2X_GENERIC. Inner columns have both horizontal neighbors,
+// so they need no clamping and are processed 'lanes' pixels at a time.
+#define scale2x_simd_frame(name, target, typename_t, V, lanes, load, store2) \
+static target void name(unsigned width, unsigned height, \
+      int first, int last, \
+      const typename_t *src, unsigned src_stride, \
+      typename_t *dst, unsigned dst_stride) \
+{ \
+   unsigned y; \
+   for (y = 0; y < height; ++y) \
+   { \
+      const int prevline = ((y == 0) && first) ? 0 : src_stride; \
+      const int nextline = ((y == height - 1) && last) ? 0 : src_stride; \
+      typename_t *out0 = dst; \
+      typename_t *out1 = dst + dst_stride; \
+      int x; \
+      \
+      scale2x_simd_pixel(typename_t, 0); \
+      for (x = 1; x + lanes < (int)width; x += lanes) \
+      { \
+         const V A = load(src + x - prevline); \
+         const V B = load(src + x - 1); \
+         const V C = load(src + x); \
+         const V D = load(src + x + 1); \
+         const V E = load(src + x + nextline); \
+         const V active = SF_NE(V, A, E) & SF_NE(V, B, D); \
+         store2(out0 + 2 * x, SF_SELECT(active & SF_EQ(V, A, B), A, C), SF_SELECT(active & SF_EQ(V, A, D), A, C)); \
+         store2(out1 + 2 * x, SF_SELECT(active & SF_EQ(V, E, B), E, C), SF_SELECT(active & SF_EQ(V, E, D), E, C)); \
+      } \
+      for (; x < (int)width; x++) \
+         scale2x_simd_pixel(typename_t, x); \
+      \
+      src += src_stride; \
+      dst += dst_stride + dst_stride; \
+   } \
+}
+
+scale2x_simd_frame(scale2x_sse2_rgb565, SOFTFILTER_TARGET_SSE2, uint16_t, sf_sse2_u16,
+      SF_SSE2_LANES_16, sf_sse2_load_u16, sf_sse2_store2_u16)
+scale2x_simd_frame(scale2x_sse2_xrgb8888, SOFTFILTER_TARGET_SSE2, uint32_t, sf_sse2_u32,
+      SF_SSE2_LANES_32, sf_sse2_load_u32, sf_sse2_store2_u32)
+scale2x_simd_frame(scale2x_avx2_rgb565, SOFTFILTER_TARGET_AVX2, uint16_t, sf_avx2_u16,
+      SF_AVX2_LANES_16, sf_avx2_load_u16, sf_avx2_store2_u16)
+scale2x_simd_frame(scale2x_avx2_xrgb8888, SOFTFILTER_TARGET_AVX2, uint32_t, sf_avx2_u32,
+      SF_AVX2_LANES_32, sf_avx2_load_u32, sf_avx2_store2_u32)
+#endif
+
 static unsigned scale2x_generic_input_fmts()
 {
    return SOFTFILTER_FMT_XRGB8888 | SOFTFILTER_FMT_RGB565;
@@ -137,6 +203,12 @@ static unsigned scale2x_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned scale2x_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void *scale2x_generic_create(unsigned in_fmt, unsigned out_fmt,
       unsigned max_width, unsigned max_height,
       unsigned threads, softfilter_simd_mask_t simd)
@@ -148,8 +220,10 @@ static void *scale2x_generic_create(unsigned in_fmt, unsigned out_fmt,
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -173,7 +247,17 @@ static void scale2x_generic_destroy(void *data)
    free(filt);
 }
 
-static void scale2x_work_cb_xrgb8888(void *data, void *thread_data)
+typedef void (*scale2x_rgb565_t)(unsigned width, unsigned height,
+      int first, int last,
+      const uint16_t *src, unsigned src_stride,
+      uint16_t *dst, unsigned dst_stride);
+
+typedef void (*scale2x_xrgb8888_t)(unsigned width, unsigned height,
+      int first, int last,
+      const uint32_t *src, unsigned src_stride,
+      uint32_t *dst, unsigned dst_stride);
+
+static void scale2x_work_xrgb8888(void *thread_data, scale2x_xrgb8888_t process)
 {
    struct softfilter_thread_data *thr = thread_data;
    const uint32_t *input = thr->in_data;
@@ -181,35 +265,46 @@ static void scale2x_work_cb_xrgb8888(void *data, void *thread_data)
    unsigned width = thr->width;
    unsigned height = thr->height;
 
-   scale2x_generic_xrgb8888(width, height, thr->access & first_line_access, thr->access & last_line_access,
-                            input, thr->in_pitch / SOFTFILTER_BPP_XRGB8888, output, thr->out_pitch / SOFTFILTER_BPP_XRGB8888);
+   process(width, height, thr->access & first_line_access, thr->access & last_line_access,
+         input, thr->in_pitch / SOFTFILTER_BPP_XRGB8888, output, thr->out_pitch / SOFTFILTER_BPP_XRGB8888);
 }
 
-static void scale2x_work_cb_rgb565(void *data, void *thread_data)
+static void scale2x_work_rgb565(void *thread_data, scale2x_rgb565_t process)
 {
    struct softfilter_thread_data *thr = thread_data;
    const uint16_t *input = thr->in_data;
-   uint16_t *output = hr->out_data;
+   uint16_t *output = thr->out_data;
    unsigned width = thr->width;
    unsigned height = thr->height;
 
-   scale2x_generic_rgb565(width, height, thr->access & first_line_access, thr->access & last_line_access,
-                          input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
+   process(width, height, thr->access & first_line_access, thr->access & last_line_access,
+         input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
 }
 
-static void scale2x_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void scale2x_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   scale2x_work_xrgb8888(thread_data, scale2x_generic_xrgb8888);
+}
+
+static void scale2x_work_cb_rgb565(void *data, void *thread_data)
+{
+   scale2x_work_rgb565(thread_data, scale2x_generic_rgb565);
+}
+
+static void scale2x_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
-      const void *input, unsigned width, unsigned height, size_t input_stride)
+      const void *input, unsigned width, unsigned height, size_t input_stride,
+      softfilter_work_t work_xrgb8888, softfilter_work_t work_rgb565)
 {
    struct filter_data *filt = data;
    unsigned i;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
 
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * SCALE2X_SCALE * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -219,16 +314,38 @@ static void scale2x_generic_packets(void *data,
 
       // Workers need to know if they can access pixels outside their given buffer.
       thr->access = (y_start == 0 ? first_line_access : 0);
-      if (y_end == height) thr->access &= last_line_access;
+      if (y_end == height) thr->access |= last_line_access;
 
       if (filt->in_fmt == SOFTFILTER_FMT_XRGB8888)
-         packets[i].work = scale2x_work_cb_xrgb8888;
+         packets[i].work = work_xrgb8888;
       else if (filt->in_fmt == SOFTFILTER_FMT_RGB565)
-         packets[i].work = scale2x_work_cb_rgb565;
+         packets[i].work = work_rgb565;
       packets[i].thread_data = thr;
    }
 }
 
+static void scale2x_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   scale2x_setup_packets(data, packets, scale2x_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         scale2x_work_cb_xrgb8888, scale2x_work_cb_rgb565);
+}
+
+static unsigned scale2x_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   scale2x_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         scale2x_work_cb_xrgb8888, scale2x_work_cb_rgb565);
+   return tiles;
+}
+
 static const struct softfilter_implementation scale2x_generic = {
    scale2x_generic_input_fmts,
    scale2x_generic_output_fmts,
@@ -241,6 +358,8 @@ static const struct softfilter_implementation scale2x_generic = {
    scale2x_generic_packets,
    "Scale2x",
    SOFTFILTER_API_VERSION,
+   scale2x_generic_num_tiles,
+   scale2x_generic_tiles,
 };
 
 static void scale2x_neon_work_cb_rgb565(void *data, void *thread_data)
@@ -254,8 +373,8 @@ static void scale2x_neon_work_cb_rgb565(void *data, void *thread_data)
                       thr->access);
 }
 
-static void scale2x_neon_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void scale2x_neon_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride)
 {
@@ -272,9 +391,9 @@ static void scale2x_neon_packets(void *data,
       }
    }
 
-   for (i = 0; i < filt->threads; i++) {
-      const unsigned y_start = (height * i) / filt->threads;
-      const unsigned y_end = (height * (i + 1)) / filt->threads;
+   for (i = 0; i < slices; i++) {
+      const unsigned y_start = (height * i) / slices;
+      const unsigned y_end = (height * (i + 1)) / slices;
 
       thr = &filt->workers[i];
 
@@ -286,7 +405,7 @@ static void scale2x_neon_packets(void *data,
       thr->height = y_end - y_start;
 
       thr->access = (y_start == 0 ? first_line_access : 0);
-      if (y_end == height) thr->access &= last_line_access;
+      if (y_end == height) thr->access |= last_line_access;
 
       /* Fall back to the generic C implementation when the input format is XRGB8888. *
        * Note that applying the Scale2x filter to this kind of data is useless anyway *
@@ -300,6 +419,26 @@ static void scale2x_neon_packets(void *data,
    }
 }
 
+static void scale2x_neon_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   scale2x_neon_setup_packets(data, packets, scale2x_generic_threads(data),
+         output, output_stride, input, width, height, input_stride);
+}
+
+static unsigned scale2x_neon_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   scale2x_neon_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride);
+   return tiles;
+}
+
 static const struct softfilter_implementation scale2x_neon = {
    scale2x_generic_input_fmts,
    scale2x_generic_output_fmts,
@@ -312,13 +451,118 @@ static const struct softfilter_implementation scale2x_neon = {
    scale2x_neon_packets,
    "Scale2x (NEON)",
    SOFTFILTER_API_VERSION,
+   scale2x_generic_num_tiles,
+   scale2x_neon_tiles,
+};
+
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+static void scale2x_sse2_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   scale2x_work_xrgb8888(thread_data, scale2x_sse2_xrgb8888);
+}
+
+static void scale2x_sse2_work_cb_rgb565(void *data, void *thread_data)
+{
+   scale2x_work_rgb565(thread_data, scale2x_sse2_rgb565);
+}
+
+static void scale2x_sse2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   scale2x_setup_packets(data, packets, scale2x_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         scale2x_sse2_work_cb_xrgb8888, scale2x_sse2_work_cb_rgb565);
+}
+
+static unsigned scale2x_sse2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   scale2x_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         scale2x_sse2_work_cb_xrgb8888, scale2x_sse2_work_cb_rgb565);
+   return tiles;
+}
+
+static const struct softfilter_implementation scale2x_sse2 = {
+   scale2x_generic_input_fmts,
+   scale2x_generic_output_fmts,
+
+   scale2x_generic_create,
+   scale2x_generic_destroy,
+
+   scale2x_generic_threads,
+   scale2x_generic_output,
+   scale2x_sse2_packets,
+   "Scale2x (SSE2)",
+   SOFTFILTER_API_VERSION,
+   scale2x_generic_num_tiles,
+   scale2x_sse2_tiles,
 };
 
+static void scale2x_avx2_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   scale2x_work_xrgb8888(thread_data, scale2x_avx2_xrgb8888);
+}
+
+static void scale2x_avx2_work_cb_rgb565(void *data, void *thread_data)
+{
+   scale2x_work_rgb565(thread_data, scale2x_avx2_rgb565);
+}
+
+static void scale2x_avx2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   scale2x_setup_packets(data, packets, scale2x_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         scale2x_avx2_work_cb_xrgb8888, scale2x_avx2_work_cb_rgb565);
+}
+
+static unsigned scale2x_avx2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   scale2x_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         scale2x_avx2_work_cb_xrgb8888, scale2x_avx2_work_cb_rgb565);
+   return tiles;
+}
+
+static const struct softfilter_implementation scale2x_avx2 = {
+   scale2x_generic_input_fmts,
+   scale2x_generic_output_fmts,
+
+   scale2x_generic_create,
+   scale2x_generic_destroy,
+
+   scale2x_generic_threads,
+   scale2x_generic_output,
+   scale2x_avx2_packets,
+   "Scale2x (AVX2)",
+   SOFTFILTER_API_VERSION,
+   scale2x_generic_num_tiles,
+   scale2x_avx2_tiles,
+};
+#endif
+
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
 {
-#ifdef USE_NEON
+#if defined(USE_NEON)
    if (simd & SOFTFILTER_SIMD_NEON)
       return &scale2x_neon;
+#elif defined(SOFTFILTER_HAVE_X86_SIMD)
+   if (simd & SOFTFILTER_SIMD_AVX2)
+      return &scale2x_avx2;
+   if (simd & SOFTFILTER_SIMD_SSE2)
+      return &scale2x_sse2;
 #else
    (void)simd;
 #endif
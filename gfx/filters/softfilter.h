@@ -18,6 +18,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 #define SOFTFILTER_SIMD_SSE      (1 << 0)
 #define SOFTFILTER_SIMD_SSE2     (1 << 1)
@@ -44,7 +45,10 @@ typedef const struct softfilter_implementation *(*softfilter_get_implementation_
 // The same SIMD mask argument is forwarded to create() callback as well to avoid having to keep lots of state around.
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd);
 
-#define SOFTFILTER_API_VERSION  1
+// Version 2 added row tiles, see softfilter_get_work_tiles_t.
+// Version 3 added bands, see softfilter_set_band_t.
+// Frontends still accept older filters, which do not have the fields added after api_version.
+#define SOFTFILTER_API_VERSION  3
 
 // Required base color formats
 
@@ -97,6 +101,51 @@ typedef void (*softfilter_get_work_packets_t)(void *data,
 // Returns the number of worker threads the filter will use.
 // This can differ from the value passed to create() instead the filter cannot be parallelized, etc. The number of threads must be less-or-equal compared to the value passed to create().
 typedef unsigned (*softfilter_query_num_threads_t)(void *data);
+
+// Row tiles. A filter may split a frame into more, smaller slices than it has threads.
+// Tiles must not depend on each other nor on the thread they run on,
+// as the frontend hands out tile after tile to whichever worker thread is free.
+// Bands which are expensive to filter are then shared by all threads, and a stalled thread
+// only delays the frame by a single tile rather than by a whole slice.
+
+// Input rows a filter should aim to put into a tile.
+#define SOFTFILTER_TILE_ROWS 16
+
+// Number of tiles of SOFTFILTER_TILE_ROWS rows a frame of given height is split into.
+#define SOFTFILTER_NUM_TILES(height) (((height) + SOFTFILTER_TILE_ROWS - 1) / SOFTFILTER_TILE_ROWS)
+
+// Rows outside of its own a tile may read from the input, both above and below.
+// Frontends rely on this to only run the tiles which an update to some input rows affects.
+#define SOFTFILTER_TILE_MARGIN 2
+
+// Returns the maximum number of tiles get_work_tiles() can split a frame into.
+typedef unsigned (*softfilter_query_num_tiles_t)(void *data);
+
+// Alternative to get_work_packets. Fills in one packet per tile, and returns the number of tiles.
+// The packets array has room for as many elements as returned by query_num_tiles.
+// Out of n tiles, packet i covers input rows [height * i / n, height * (i + 1) / n),
+// and the output rows which correspond to them. Frontends may skip running some of the packets,
+// and expect the output of those tiles to be left alone. Skipped tiles keep showing the
+// previous result, so filters that vary their output from frame to frame have to say so,
+// see softfilter_query_frame_dependent_t.
+typedef unsigned (*softfilter_get_work_tiles_t)(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride);
+
+// Bands. When filters are chained, the frontend filters a frame in horizontal bands,
+// one get_work_packets call per band, spread over several single threaded instances.
+// Before each of these calls it passes the row of the whole frame the band's input starts at,
+// and a frame counter which advances once per frame and is the same for every band of a frame.
+// Filters whose output depends on the frame or on the absolute row (e.g. the NTSC filters' burst phase)
+// must derive it from these rather than from counting calls. Such filters cannot be chained without this.
+// get_work_packets calls made without a preceding set_band are for a whole frame, starting at row 0.
+typedef void (*softfilter_set_band_t)(void *data, unsigned frame_count, unsigned first_row);
+
+// Returns true if output depends on the frame as well as on the input, e.g. an NTSC burst phase
+// which alternates every frame. Frontends then run every tile of every frame they show,
+// even if the input did not change. Filters which do not implement this are assumed not to.
+typedef bool (*softfilter_query_frame_dependent_t)(void *data);
 /////
 
 struct softfilter_implementation
@@ -113,6 +162,14 @@ struct softfilter_implementation
 
    const char *ident; // Human readable identifier of implementation.
    unsigned api_version; // Must be SOFTFILTER_API_VERSION
+
+   // Optional, API version 2 or later.
+   softfilter_query_num_tiles_t query_num_tiles;
+   softfilter_get_work_tiles_t get_work_tiles;
+
+   // Optional, API version 3 or later.
+   softfilter_set_band_t set_band;
+   softfilter_query_frame_dependent_t query_frame_dependent;
 };
 
 #endif
@@ -0,0 +1,127 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOFTFILTER_SIMD_H__
+#define SOFTFILTER_SIMD_H__
+
+// Helpers for x86 SIMD paths of softfilters.
+// Kernels are written once against GCC vector extensions and instantiated for
+// SSE2 (128-bit) and AVX2 (256-bit) vectors. Functions are compiled with target attributes,
+// so filters are still built for the baseline instruction set and pick an implementation
+// at runtime from the mask passed to softfilter_get_implementation().
+//
+// Comparisons are turned into all-ones/all-zeroes lane masks and branches into selects.
+// The interpolation macros of the filters never carry between color channels,
+// so evaluating them lane-wise gives the same result as the C implementations.
+
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(MSB_FIRST) && \
+   (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SOFTFILTER_HAVE_X86_SIMD
+
+#include <immintrin.h>
+
+#define SOFTFILTER_TARGET_SSE2 __attribute__((target("sse2")))
+#define SOFTFILTER_TARGET_AVX2 __attribute__((target("avx2")))
+
+// Forced, as filters are built without optimizations unless build=release is given.
+#define SF_INLINE static inline __attribute__((always_inline))
+
+typedef uint16_t sf_sse2_u16 __attribute__((vector_size(16)));
+typedef int16_t  sf_sse2_s16 __attribute__((vector_size(16)));
+typedef uint32_t sf_sse2_u32 __attribute__((vector_size(16)));
+typedef int32_t  sf_sse2_s32 __attribute__((vector_size(16)));
+typedef uint16_t sf_avx2_u16 __attribute__((vector_size(32)));
+typedef int16_t  sf_avx2_s16 __attribute__((vector_size(32)));
+typedef uint32_t sf_avx2_u32 __attribute__((vector_size(32)));
+typedef int32_t  sf_avx2_s32 __attribute__((vector_size(32)));
+
+#define SF_SSE2_LANES_16 8
+#define SF_SSE2_LANES_32 4
+#define SF_AVX2_LANES_16 16
+#define SF_AVX2_LANES_32 8
+
+// Lane masks of vector type V.
+#define SF_EQ(V, a, b) ((V)((a) == (b)))
+#define SF_NE(V, a, b) ((V)((a) != (b)))
+
+// Per lane (mask ? a : b).
+#define SF_SELECT(mask, a, b) (((mask) & (a)) | (~(mask) & (b)))
+
+// Unaligned loads. memcpy() is lowered to a single unaligned vector load.
+SF_INLINE SOFTFILTER_TARGET_SSE2 sf_sse2_u16 sf_sse2_load_u16(const uint16_t *in)
+{
+   sf_sse2_u16 v;
+   memcpy(&v, in, sizeof(v));
+   return v;
+}
+
+SF_INLINE SOFTFILTER_TARGET_SSE2 sf_sse2_u32 sf_sse2_load_u32(const uint32_t *in)
+{
+   sf_sse2_u32 v;
+   memcpy(&v, in, sizeof(v));
+   return v;
+}
+
+SF_INLINE SOFTFILTER_TARGET_AVX2 sf_avx2_u16 sf_avx2_load_u16(const uint16_t *in)
+{
+   sf_avx2_u16 v;
+   memcpy(&v, in, sizeof(v));
+   return v;
+}
+
+SF_INLINE SOFTFILTER_TARGET_AVX2 sf_avx2_u32 sf_avx2_load_u32(const uint32_t *in)
+{
+   sf_avx2_u32 v;
+   memcpy(&v, in, sizeof(v));
+   return v;
+}
+
+// Stores two vectors interleaved, i.e. out[2 * i] = a[i], out[2 * i + 1] = b[i].
+// This is the horizontal half of a 2x scaler's output.
+SF_INLINE SOFTFILTER_TARGET_SSE2 void sf_sse2_store2_u16(uint16_t *out, sf_sse2_u16 a, sf_sse2_u16 b)
+{
+   _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16((__m128i)a, (__m128i)b));
+   _mm_storeu_si128((__m128i*)(out + 8), _mm_unpackhi_epi16((__m128i)a, (__m128i)b));
+}
+
+SF_INLINE SOFTFILTER_TARGET_SSE2 void sf_sse2_store2_u32(uint32_t *out, sf_sse2_u32 a, sf_sse2_u32 b)
+{
+   _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32((__m128i)a, (__m128i)b));
+   _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi32((__m128i)a, (__m128i)b));
+}
+
+// AVX2 unpacks work within 128-bit halves, so halves are swapped back in place afterwards.
+SF_INLINE SOFTFILTER_TARGET_AVX2 void sf_avx2_store2_u16(uint16_t *out, sf_avx2_u16 a, sf_avx2_u16 b)
+{
+   __m256i lo = _mm256_unpacklo_epi16((__m256i)a, (__m256i)b);
+   __m256i hi = _mm256_unpackhi_epi16((__m256i)a, (__m256i)b);
+   _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(lo, hi, 0x20));
+   _mm256_storeu_si256((__m256i*)(out + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+SF_INLINE SOFTFILTER_TARGET_AVX2 void sf_avx2_store2_u32(uint32_t *out, sf_avx2_u32 a, sf_avx2_u32 b)
+{
+   __m256i lo = _mm256_unpacklo_epi32((__m256i)a, (__m256i)b);
+   __m256i hi = _mm256_unpackhi_epi32((__m256i)a, (__m256i)b);
+   _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(lo, hi, 0x20));
+   _mm256_storeu_si256((__m256i*)(out + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+#endif
+
+#endif
@@ -17,6 +17,7 @@
 // Compile: gcc -o supereagle.so -shared supereagle.c -std=c99 -O3 -Wall -pedantic -fPIC
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 
 #define SUPEREAGLE_SCALE 2
@@ -37,6 +38,7 @@ struct softfilter_thread_data
 struct filter_data
 {
    unsigned threads;
+   unsigned tiles;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
 };
@@ -57,6 +59,12 @@ static unsigned supereagle_generic_threads(void *data)
    return filt->threads;
 }
 
+static unsigned supereagle_generic_num_tiles(void *data)
+{
+   struct filter_data *filt = data;
+   return filt->tiles;
+}
+
 static void *supereagle_generic_create(unsigned in_fmt, unsigned out_fmt,
       unsigned max_width, unsigned max_height,
       unsigned threads, softfilter_simd_mask_t simd)
@@ -66,8 +74,10 @@ static void *supereagle_generic_create(unsigned in_fmt, unsigned out_fmt,
    struct filter_data *filt = calloc(1, sizeof(*filt));
    if (!filt)
       return NULL;
-   filt->workers = calloc(threads, sizeof(struct softfilter_thread_data));
    filt->threads = threads;
+   filt->tiles = SOFTFILTER_NUM_TILES(max_height);
+   filt->workers = calloc(filt->tiles > threads ? filt->tiles : threads,
+         sizeof(struct softfilter_thread_data));
    filt->in_fmt  = in_fmt;
    if (!filt->workers)
    {
@@ -95,16 +105,23 @@ static void supereagle_generic_destroy(void *data)
 
 #define supereagle_interpolate2_xrgb8888(A, B, C, D) ((((A) & 0xFCFCFCFC) >> 2) + (((B) & 0xFCFCFCFC) >> 2) + (((C) & 0xFCFCFCFC) >> 2) + (((D) & 0xFCFCFCFC) >> 2) + (((((A) & 0x03030303) + ((B) & 0x03030303) + ((C) & 0x03030303) + ((D) & 0x03030303)) >> 2) & 0x03030303))
 
-#define supereagle_interpolate_rgb565(A, B) ((((A) & 0xF7DE) >> 1) + (((B) & 0xF7DE) >> 1) + ((A) & (B) & 0x0821));
+#define supereagle_interpolate_rgb565(A, B) ((((A) & 0xF7DE) >> 1) + (((B) & 0xF7DE) >> 1) + ((A) & (B) & 0x0821))
 
 #define supereagle_interpolate2_rgb565(A, B, C, D) ((((A) & 0xE79C) >> 2) + (((B) & 0xE79C) >> 2) + (((C) & 0xE79C) >> 2) + (((D) & 0xE79C) >> 2)  + (((((A) & 0x1863) + ((B) & 0x1863) + ((C) & 0x1863) + ((D) & 0x1863)) >> 2) & 0x1863))
 
 #define supereagle_result(A, B, C, D) (((A) != (C) || (A) != (D)) - ((B) != (C) || (B) != (D)));
 
-#define supereagle_declare_variables(typename_t, in, nextline) \
+// Offsets to the row above, and the two rows below. Rows outside the frame are replaced by
+// the closest row inside it, so output does not depend on how the frame is split into slices.
+#define supereagle_row_offsets(y, height, first, last, stride) \
+         prevline = (first) + (y) == 0 ? 0 : (stride); \
+         nextline = ((last) && (y) + 1 >= (height)) ? 0 : (stride); \
+         nextline2 = ((last) && (y) + 2 >= (height)) ? nextline : nextline + (stride)
+
+#define supereagle_declare_variables(typename_t, in, prevline, nextline, nextline2) \
          typename_t product1a, product1b, product2a, product2b; \
-         const typename_t colorB1 = *(in - nextline + 0); \
-         const typename_t colorB2 = *(in - nextline + 1); \
+         const typename_t colorB1 = *(in - prevline + 0); \
+         const typename_t colorB2 = *(in - prevline + 1); \
          const typename_t color4  = *(in - 1); \
          const typename_t color5  = *(in + 0); \
          const typename_t color6  = *(in + 1); \
@@ -113,8 +130,8 @@ static void supereagle_generic_destroy(void *data)
          const typename_t color2  = *(in + nextline + 0); \
          const typename_t color3  = *(in + nextline + 1); \
          const typename_t colorS1 = *(in + nextline + 2); \
-         const typename_t colorA1 = *(in + nextline + nextline + 0); \
-         const typename_t colorA2 = *(in + nextline + nextline + 1)
+         const typename_t colorA1 = *(in + nextline2 + 0); \
+         const typename_t colorA2 = *(in + nextline2 + 1)
 
 #ifndef supereagle_function
 #define supereagle_function(result_cb, interpolate_cb, interpolate2_cb) \
@@ -206,17 +223,17 @@ static void supereagle_generic_xrgb8888(unsigned width, unsigned height,
       int first, int last, uint32_t *src, 
       unsigned src_stride, uint32_t *dst, unsigned dst_stride)
 {
-   unsigned finish, nextline;
-   nextline = (last) ? 0 : src_stride;
+   unsigned prevline, nextline, nextline2, finish, y;
 
-   for (; height; height--)
+   for (y = 0; y < height; y++)
    {
+      supereagle_row_offsets(y, height, first, last, src_stride);
       uint32_t *in  = src;
       uint32_t *out = dst;
 
       for (finish = width; finish; finish -= 1)
       {
-         supereagle_declare_variables(uint32_t, in, nextline);
+         supereagle_declare_variables(uint32_t, in, prevline, nextline, nextline2);
 
          supereagle_function(supereagle_result, supereagle_interpolate_xrgb8888, supereagle_interpolate2_xrgb8888);
       }
@@ -230,17 +247,17 @@ static void supereagle_generic_rgb565(unsigned width, unsigned height,
       int first, int last, uint16_t *src, 
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
-   unsigned nextline, finish;
-   nextline = (last) ? 0 : src_stride;
+   unsigned prevline, nextline, nextline2, finish, y;
 
-   for (; height; height--)
+   for (y = 0; y < height; y++)
    {
+      supereagle_row_offsets(y, height, first, last, src_stride);
       uint16_t *in  = src;
       uint16_t *out = dst;
 
       for (finish = width; finish; finish -= 1)
       {
-         supereagle_declare_variables(uint16_t, in, nextline);
+         supereagle_declare_variables(uint16_t, in, prevline, nextline, nextline2);
 
          supereagle_function(supereagle_result, supereagle_interpolate_rgb565, supereagle_interpolate2_rgb565);
       }
@@ -250,43 +267,157 @@ static void supereagle_generic_rgb565(unsigned width, unsigned height,
    }
 }
 
-static void supereagle_work_cb_rgb565(void *data, void *thread_data)
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+// Vector version of supereagle_function for 'lanes' consecutive pixels.
+// The four cases are disjoint, so every output is a chain of selects.
+#define supereagle_simd_block(V, S, load, store2, interpolate_cb, interpolate2_cb) \
+         const V colorB1 = load(in - prevline + 0); \
+         const V colorB2 = load(in - prevline + 1); \
+         const V color4  = load(in - 1); \
+         const V color5  = load(in + 0); \
+         const V color6  = load(in + 1); \
+         const V colorS2 = load(in + 2); \
+         const V color1  = load(in + nextline - 1); \
+         const V color2  = load(in + nextline + 0); \
+         const V color3  = load(in + nextline + 1); \
+         const V colorS1 = load(in + nextline + 2); \
+         const V colorA1 = load(in + nextline2 + 0); \
+         const V colorA2 = load(in + nextline2 + 1); \
+         const V eq26 = SF_EQ(V, color2, color6); \
+         const V eq53 = SF_EQ(V, color5, color3); \
+         const V case1 = eq26 & ~eq53; \
+         const V case2 = eq53 & ~eq26; \
+         const V case3 = eq53 & eq26; \
+         const S r = supereagle_simd_result(S, color6, color5, color1, colorA1) + \
+            supereagle_simd_result(S, color6, color5, color4, colorB1) + \
+            supereagle_simd_result(S, color6, color5, colorA2, colorS1) + \
+            supereagle_simd_result(S, color6, color5, colorB2, colorS2); \
+         const V r_pos = case3 & (V)(r > 0); \
+         const V r_neg = case3 & (V)(r < 0); \
+         const V i56 = interpolate_cb(color5, color6); \
+         const V i23 = interpolate_cb(color2, color3); \
+         const V i26 = interpolate_cb(color2, color6); \
+         const V i53 = interpolate_cb(color5, color3); \
+         const V i25 = interpolate_cb(color2, color5); \
+         const V i52 = interpolate_cb(color5, color2); \
+         const V case1_1a = SF_SELECT(SF_EQ(V, color1, color2) | SF_EQ(V, color6, colorB2), interpolate_cb(color2, i25), i56); \
+         const V case1_2b = SF_SELECT(SF_EQ(V, color6, colorS2) | SF_EQ(V, color2, colorA1), interpolate_cb(color2, i23), i23); \
+         const V case2_1b = SF_SELECT(SF_EQ(V, colorB1, color5) | SF_EQ(V, color3, colorS1), interpolate_cb(color5, i56), i56); \
+         const V case2_2a = SF_SELECT(SF_EQ(V, color3, colorA2) | SF_EQ(V, color4, color5), interpolate_cb(color5, i52), i23); \
+         const V product1a = SF_SELECT(case1, case1_1a, SF_SELECT(case2, color5, SF_SELECT(r_pos, i56, \
+               SF_SELECT(case3, color5, interpolate2_cb(color5, color5, color5, i26))))); \
+         const V product2b = SF_SELECT(case1, case1_2b, SF_SELECT(case2, color5, SF_SELECT(r_pos, i56, \
+               SF_SELECT(case3, color5, interpolate2_cb(color3, color3, color3, i26))))); \
+         const V product1b = SF_SELECT(case1, color2, SF_SELECT(case2, case2_1b, SF_SELECT(r_neg, i56, \
+               SF_SELECT(case3, color2, interpolate2_cb(color6, color6, color6, i53))))); \
+         const V product2a = SF_SELECT(case1, color2, SF_SELECT(case2, case2_2a, SF_SELECT(r_neg, i56, \
+               SF_SELECT(case3, color2, interpolate2_cb(color2, color2, color2, i53))))); \
+         store2(out, product1a, product1b); \
+         store2(out + dst_stride, product2a, product2b)
+
+// Same as supereagle_result, with lane masks (-1) in place of booleans.
+#define supereagle_simd_result(S, A, B, C, D) ((S)((B) != (C)) | (S)((B) != (D))) - ((S)((A) != (C)) | (S)((A) != (D)))
+
+// Vectorized supereagle_generic_*. Trailing pixels which do not fill a vector go through the C version.
+#define supereagle_simd_frame(name, target, typename_t, V, S, lanes, load, store2, interpolate_cb, interpolate2_cb) \
+static target void name(unsigned width, unsigned height, \
+      int first, int last, typename_t *src, \
+      unsigned src_stride, typename_t *dst, unsigned dst_stride) \
+{ \
+   unsigned prevline, nextline, nextline2, x, y; \
+ \
+   for (y = 0; y < height; y++) \
+   { \
+      supereagle_row_offsets(y, height, first, last, src_stride); \
+      typename_t *in  = src; \
+      typename_t *out = dst; \
+ \
+      for (x = 0; x + lanes <= width; x += lanes, in += lanes, out += 2 * lanes) \
+      { \
+         supereagle_simd_block(V, S, load, store2, interpolate_cb, interpolate2_cb); \
+      } \
+ \
+      for (; x < width; x++) \
+      { \
+         supereagle_declare_variables(typename_t, in, prevline, nextline, nextline2); \
+         supereagle_function(supereagle_result, interpolate_cb, interpolate2_cb); \
+      } \
+ \
+      src += src_stride; \
+      dst += 2 * dst_stride; \
+   } \
+}
+
+supereagle_simd_frame(supereagle_sse2_rgb565, SOFTFILTER_TARGET_SSE2, uint16_t, sf_sse2_u16, sf_sse2_s16,
+      SF_SSE2_LANES_16, sf_sse2_load_u16, sf_sse2_store2_u16,
+      supereagle_interpolate_rgb565, supereagle_interpolate2_rgb565)
+supereagle_simd_frame(supereagle_sse2_xrgb8888, SOFTFILTER_TARGET_SSE2, uint32_t, sf_sse2_u32, sf_sse2_s32,
+      SF_SSE2_LANES_32, sf_sse2_load_u32, sf_sse2_store2_u32,
+      supereagle_interpolate_xrgb8888, supereagle_interpolate2_xrgb8888)
+supereagle_simd_frame(supereagle_avx2_rgb565, SOFTFILTER_TARGET_AVX2, uint16_t, sf_avx2_u16, sf_avx2_s16,
+      SF_AVX2_LANES_16, sf_avx2_load_u16, sf_avx2_store2_u16,
+      supereagle_interpolate_rgb565, supereagle_interpolate2_rgb565)
+supereagle_simd_frame(supereagle_avx2_xrgb8888, SOFTFILTER_TARGET_AVX2, uint32_t, sf_avx2_u32, sf_avx2_s32,
+      SF_AVX2_LANES_32, sf_avx2_load_u32, sf_avx2_store2_u32,
+      supereagle_interpolate_xrgb8888, supereagle_interpolate2_xrgb8888)
+#endif
+
+typedef void (*supereagle_rgb565_t)(unsigned width, unsigned height,
+      int first, int last, uint16_t *src,
+      unsigned src_stride, uint16_t *dst, unsigned dst_stride);
+
+typedef void (*supereagle_xrgb8888_t)(unsigned width, unsigned height,
+      int first, int last, uint32_t *src,
+      unsigned src_stride, uint32_t *dst, unsigned dst_stride);
+
+static void supereagle_work_rgb565(void *thread_data, supereagle_rgb565_t process)
 {
    struct softfilter_thread_data *thr = thread_data;
-   uint16_t *input = thr->in_data;
+   uint16_t *input = (uint16_t*)thr->in_data;
    uint16_t *output = thr->out_data;
    unsigned width = thr->width;
    unsigned height = thr->height;
 
-   supereagle_generic_rgb565(width, height,
+   process(width, height,
          thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_RGB565, output, thr->out_pitch / SOFTFILTER_BPP_RGB565);
 }
 
-static void supereagle_work_cb_xrgb8888(void *data, void *thread_data)
+static void supereagle_work_xrgb8888(void *thread_data, supereagle_xrgb8888_t process)
 {
    struct softfilter_thread_data *thr = thread_data;
-   uint32_t *input = thr->in_data;
+   uint32_t *input = (uint32_t*)thr->in_data;
    uint32_t *output = thr->out_data;
    unsigned width = thr->width;
    unsigned height = thr->height;
 
-   supereagle_generic_xrgb8888(width, height,
+   process(width, height,
          thr->first, thr->last, input, thr->in_pitch / SOFTFILTER_BPP_XRGB8888, output, thr->out_pitch / SOFTFILTER_BPP_XRGB8888);
 }
 
-static void supereagle_generic_packets(void *data,
-      struct softfilter_work_packet *packets,
+static void supereagle_work_cb_rgb565(void *data, void *thread_data)
+{
+   supereagle_work_rgb565(thread_data, supereagle_generic_rgb565);
+}
+
+static void supereagle_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   supereagle_work_xrgb8888(thread_data, supereagle_generic_xrgb8888);
+}
+
+static void supereagle_setup_packets(void *data,
+      struct softfilter_work_packet *packets, unsigned slices,
       void *output, size_t output_stride,
-      const void *input, unsigned width, unsigned height, size_t input_stride)
+      const void *input, unsigned width, unsigned height, size_t input_stride,
+      softfilter_work_t work_rgb565, softfilter_work_t work_xrgb8888)
 {
    struct filter_data *filt = data;
    unsigned i;
-   for (i = 0; i < filt->threads; i++)
+   for (i = 0; i < slices; i++)
    {
       struct softfilter_thread_data *thr = &filt->workers[i];
 
-      unsigned y_start = (height * i) / filt->threads;
-      unsigned y_end = (height * (i + 1)) / filt->threads;
+      unsigned y_start = (height * i) / slices;
+      unsigned y_end = (height * (i + 1)) / slices;
       thr->out_data = (uint8_t*)output + y_start * SUPEREAGLE_SCALE * output_stride;
       thr->in_data = (const uint8_t*)input + y_start * input_stride;
       thr->out_pitch = output_stride;
@@ -299,13 +430,35 @@ static void supereagle_generic_packets(void *data,
       thr->last = y_end == height;
 
       if (filt->in_fmt == SOFTFILTER_FMT_RGB565)
-         packets[i].work = supereagle_work_cb_rgb565;
+         packets[i].work = work_rgb565;
       else if (filt->in_fmt == SOFTFILTER_FMT_XRGB8888)
-         packets[i].work = supereagle_work_cb_xrgb8888;
+         packets[i].work = work_xrgb8888;
       packets[i].thread_data = thr;
    }
 }
 
+static void supereagle_generic_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   supereagle_setup_packets(data, packets, supereagle_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         supereagle_work_cb_rgb565, supereagle_work_cb_xrgb8888);
+}
+
+static unsigned supereagle_generic_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   supereagle_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         supereagle_work_cb_rgb565, supereagle_work_cb_xrgb8888);
+   return tiles;
+}
+
 static const struct softfilter_implementation supereagle_generic = {
    supereagle_generic_input_fmts,
    supereagle_generic_output_fmts,
@@ -318,10 +471,117 @@ static const struct softfilter_implementation supereagle_generic = {
    supereagle_generic_packets,
    "SuperEagle",
    SOFTFILTER_API_VERSION,
+   supereagle_generic_num_tiles,
+   supereagle_generic_tiles,
 };
 
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+static void supereagle_sse2_work_cb_rgb565(void *data, void *thread_data)
+{
+   supereagle_work_rgb565(thread_data, supereagle_sse2_rgb565);
+}
+
+static void supereagle_sse2_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   supereagle_work_xrgb8888(thread_data, supereagle_sse2_xrgb8888);
+}
+
+static void supereagle_sse2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   supereagle_setup_packets(data, packets, supereagle_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         supereagle_sse2_work_cb_rgb565, supereagle_sse2_work_cb_xrgb8888);
+}
+
+static unsigned supereagle_sse2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   supereagle_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         supereagle_sse2_work_cb_rgb565, supereagle_sse2_work_cb_xrgb8888);
+   return tiles;
+}
+
+static const struct softfilter_implementation supereagle_sse2 = {
+   supereagle_generic_input_fmts,
+   supereagle_generic_output_fmts,
+
+   supereagle_generic_create,
+   supereagle_generic_destroy,
+
+   supereagle_generic_threads,
+   supereagle_generic_output,
+   supereagle_sse2_packets,
+   "SuperEagle (SSE2)",
+   SOFTFILTER_API_VERSION,
+   supereagle_generic_num_tiles,
+   supereagle_sse2_tiles,
+};
+
+static void supereagle_avx2_work_cb_rgb565(void *data, void *thread_data)
+{
+   supereagle_work_rgb565(thread_data, supereagle_avx2_rgb565);
+}
+
+static void supereagle_avx2_work_cb_xrgb8888(void *data, void *thread_data)
+{
+   supereagle_work_xrgb8888(thread_data, supereagle_avx2_xrgb8888);
+}
+
+static void supereagle_avx2_packets(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   supereagle_setup_packets(data, packets, supereagle_generic_threads(data),
+         output, output_stride, input, width, height, input_stride,
+         supereagle_avx2_work_cb_rgb565, supereagle_avx2_work_cb_xrgb8888);
+}
+
+static unsigned supereagle_avx2_tiles(void *data,
+      struct softfilter_work_packet *packets,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride)
+{
+   unsigned tiles = SOFTFILTER_NUM_TILES(height);
+   supereagle_setup_packets(data, packets, tiles,
+         output, output_stride, input, width, height, input_stride,
+         supereagle_avx2_work_cb_rgb565, supereagle_avx2_work_cb_xrgb8888);
+   return tiles;
+}
+
+static const struct softfilter_implementation supereagle_avx2 = {
+   supereagle_generic_input_fmts,
+   supereagle_generic_output_fmts,
+
+   supereagle_generic_create,
+   supereagle_generic_destroy,
+
+   supereagle_generic_threads,
+   supereagle_generic_output,
+   supereagle_avx2_packets,
+   "SuperEagle (AVX2)",
+   SOFTFILTER_API_VERSION,
+   supereagle_generic_num_tiles,
+   supereagle_avx2_tiles,
+};
+#endif
+
 const struct softfilter_implementation *softfilter_get_implementation(softfilter_simd_mask_t simd)
 {
+#ifdef SOFTFILTER_HAVE_X86_SIMD
+   if (simd & SOFTFILTER_SIMD_AVX2)
+      return &supereagle_avx2;
+   if (simd & SOFTFILTER_SIMD_SSE2)
+      return &supereagle_sse2;
+#else
    (void)simd;
+#endif
    return &supereagle_generic;
 }
@@ -0,0 +1,843 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Softfilter throughput and conformance harness.
+// Plugins are loaded through softfilter_get_implementation() like rarch_softfilter_new() does.
+// Every implementation a plugin returns for the SIMD features of this CPU is run on synthetic
+// frames, and on recorded frames given on the command line, in both pixel formats.
+// Work packets are run on a pool of threads, for 1 up to N threads. Like in the frontend,
+// threads claim packets until none are left, and filters which support tiles are split into tiles
+// unless --no-tiles is given.
+//
+// Throughput is written to stdout as CSV, one line per plugin/implementation/format/frame/threads.
+// With --check, output of every implementation is compared against checksums in a golden file,
+// which --update writes from the C implementations. --check also filters two frames with only
+// a few rows changed in the second, skipping tiles like the frontend does, and compares to full frames.
+
+#include "../softfilter.h"
+#include "../../../thread.h"
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_THREADS 32
+#define BENCH_MAX_FRAMES 16
+#define BENCH_MAX_IMPLS 4
+#define BENCH_MAX_GOLDEN 4096
+
+// Minimum wall time spent on each throughput measurement.
+#define BENCH_MIN_SECONDS 0.2
+
+// Filters read a row above and below their input. Keep that inside the allocation
+// and deterministic, so checksums do not depend on whatever is next to the frame.
+#define BENCH_GUARD_ROWS 4
+
+// Thread counts golden checksums are taken for. Many filters treat slice borders as
+// frame borders, so output of filters without tiles legitimately depends on the number of threads.
+// Tiles only depend on the frame, so a tiled filter has to give the same output for both.
+static const unsigned bench_golden_threads[] = { 1, 4 };
+
+struct bench_frame
+{
+   char name[64];
+   unsigned width;
+   unsigned height;
+   uint32_t *data; // XRGB8888, packed.
+};
+
+struct bench_golden
+{
+   char key[256];
+   uint64_t hash;
+};
+
+// One thread pool for every thread count, as every thread of a pool takes part in its jobs.
+// threads[t] has t - 1 workers, the caller being the last thread. Pools are started on first use.
+struct bench_pool
+{
+   sthread_pool_t *threads[BENCH_MAX_THREADS + 1];
+   unsigned max_threads;
+
+   void *filter;
+   struct softfilter_work_packet *packets;
+};
+
+static struct bench_frame bench_frames[BENCH_MAX_FRAMES];
+static unsigned bench_num_frames;
+// Frames before this index are synthetic, and have golden checksums.
+static unsigned bench_num_synthetic;
+
+static struct bench_golden bench_golden[BENCH_MAX_GOLDEN];
+static unsigned bench_num_golden;
+
+static double bench_time(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1000000000.0;
+}
+
+static uint32_t bench_rand(uint32_t *state)
+{
+   *state = *state * 1664525u + 1013904223u;
+   return *state >> 8;
+}
+
+static uint64_t bench_hash(uint64_t hash, const uint8_t *data, size_t size)
+{
+   // FNV-1a.
+   for (size_t i = 0; i < size; i++)
+   {
+      hash ^= data[i];
+      hash *= 0x100000001b3ull;
+   }
+   return hash;
+}
+
+static struct bench_frame *bench_new_frame(const char *name, unsigned width, unsigned height)
+{
+   if (bench_num_frames >= BENCH_MAX_FRAMES)
+      return NULL;
+
+   struct bench_frame *frame = &bench_frames[bench_num_frames];
+   frame->data = calloc(width * height, sizeof(uint32_t));
+   if (!frame->data)
+      return NULL;
+
+   snprintf(frame->name, sizeof(frame->name), "%s", name);
+   frame->width = width;
+   frame->height = height;
+   bench_num_frames++;
+   return frame;
+}
+
+// Synthetic frames. Generated with a private LCG so that golden checksums are portable.
+static void bench_gen_frames(void)
+{
+   uint32_t seed = 1;
+   uint32_t palette[16];
+   for (unsigned i = 0; i < 16; i++)
+      palette[i] = bench_rand(&seed) & 0xffffff;
+
+   // Pixel art: a map of 8x8 tiles drawn from a few patterns, with some sprites on top.
+   struct bench_frame *frame = bench_new_frame("tiles", 256, 224);
+   if (frame)
+   {
+      uint8_t tiles[8][8][8];
+      for (unsigned t = 0; t < 8; t++)
+         for (unsigned y = 0; y < 8; y++)
+            for (unsigned x = 0; x < 8; x++)
+               tiles[t][y][x] = (bench_rand(&seed) % 5 == 0) ? bench_rand(&seed) % 16 : t;
+
+      for (unsigned y = 0; y < frame->height; y++)
+         for (unsigned x = 0; x < frame->width; x++)
+         {
+            unsigned t = ((x / 8) * 7 + (y / 8) * 3) % 8;
+            frame->data[y * frame->width + x] = palette[tiles[t][y & 7][x & 7]];
+         }
+
+      for (unsigned i = 0; i < 24; i++)
+      {
+         unsigned sx = bench_rand(&seed) % (frame->width - 16);
+         unsigned sy = bench_rand(&seed) % (frame->height - 16);
+         uint32_t color = palette[bench_rand(&seed) % 16];
+         for (unsigned y = 0; y < 16; y++)
+            for (unsigned x = 0; x < 16; x++)
+               if ((x - 8) * (x - 8) + (y - 8) * (y - 8) < 48)
+                  frame->data[(sy + y) * frame->width + sx + x] = color;
+      }
+   }
+
+   // Smooth content, where every neighbor differs slightly.
+   frame = bench_new_frame("gradient", 320, 240);
+   if (frame)
+   {
+      for (unsigned y = 0; y < frame->height; y++)
+         for (unsigned x = 0; x < frame->width; x++)
+         {
+            unsigned r = x * 255 / (frame->width - 1);
+            unsigned g = y * 255 / (frame->height - 1);
+            unsigned b = (x + y) & 0xff;
+            frame->data[y * frame->width + x] = (r << 16) | (g << 8) | b;
+         }
+   }
+
+   // Worst case for filters which branch on pixel equality.
+   frame = bench_new_frame("noise", 320, 240);
+   if (frame)
+   {
+      for (unsigned i = 0; i < frame->width * frame->height; i++)
+         frame->data[i] = bench_rand(&seed) & 0xffffff;
+   }
+}
+
+static uint32_t bench_read_le(const uint8_t *data, unsigned bytes)
+{
+   uint32_t val = 0;
+   for (unsigned i = 0; i < bytes; i++)
+      val |= (uint32_t)data[i] << (8 * i);
+   return val;
+}
+
+// Recorded frames, e.g. RetroArch screenshots. Uncompressed 24 or 32-bit BMP only.
+static bool bench_load_bmp(const char *path)
+{
+   bool ret = false;
+   uint8_t *data = NULL;
+   FILE *file = fopen(path, "rb");
+   if (!file)
+      goto end;
+
+   fseek(file, 0, SEEK_END);
+   long size = ftell(file);
+   rewind(file);
+
+   if (size < 54 || !(data = malloc(size)) || fread(data, 1, size, file) != (size_t)size)
+      goto end;
+
+   if (data[0] != 'B' || data[1] != 'M')
+      goto end;
+
+   uint32_t offset = bench_read_le(data + 10, 4);
+   int32_t width = (int32_t)bench_read_le(data + 18, 4);
+   int32_t height = (int32_t)bench_read_le(data + 22, 4);
+   unsigned bpp = bench_read_le(data + 28, 2);
+   unsigned compression = bench_read_le(data + 30, 4);
+   bool bottom_up = height > 0;
+   if (height < 0)
+      height = -height;
+
+   if (width <= 0 || height <= 0 || (bpp != 24 && bpp != 32) || (compression != 0 && compression != 3))
+      goto end;
+
+   size_t pitch = ((size_t)width * (bpp / 8) + 3) & ~3;
+   if (offset + pitch * height > (size_t)size)
+      goto end;
+
+   const char *name = strrchr(path, '/');
+   struct bench_frame *frame = bench_new_frame(name ? name + 1 : path, width, height);
+   if (!frame)
+      goto end;
+
+   for (int32_t y = 0; y < height; y++)
+   {
+      const uint8_t *row = data + offset + pitch * (bottom_up ? height - 1 - y : y);
+      for (int32_t x = 0; x < width; x++)
+         frame->data[y * width + x] = bench_read_le(row + x * (bpp / 8), 3);
+   }
+
+   ret = true;
+
+end:
+   if (file)
+      fclose(file);
+   free(data);
+   return ret;
+}
+
+static unsigned bench_bpp(unsigned fmt)
+{
+   return fmt == SOFTFILTER_FMT_RGB565 ? SOFTFILTER_BPP_RGB565 : SOFTFILTER_BPP_XRGB8888;
+}
+
+static const char *bench_fmt_name(unsigned fmt)
+{
+   return fmt == SOFTFILTER_FMT_RGB565 ? "RGB565" : "XRGB8888";
+}
+
+// Converts a frame to the given format. Returns the start of the frame inside a buffer
+// with guard rows around it. Free with bench_free_input().
+static void *bench_make_input(const struct bench_frame *frame, unsigned fmt, size_t *pitch)
+{
+   unsigned bpp = bench_bpp(fmt);
+   *pitch = frame->width * bpp;
+
+   uint8_t *buf = calloc(frame->height + 2 * BENCH_GUARD_ROWS, *pitch);
+   if (!buf)
+      return NULL;
+
+   uint8_t *input = buf + BENCH_GUARD_ROWS * *pitch;
+   for (unsigned i = 0; i < frame->width * frame->height; i++)
+   {
+      uint32_t c = frame->data[i];
+      if (fmt == SOFTFILTER_FMT_RGB565)
+         ((uint16_t*)input)[i] = ((c >> 8) & 0xf800) | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x001f);
+      else
+         ((uint32_t*)input)[i] = c;
+   }
+
+   return input;
+}
+
+static void bench_free_input(void *input, size_t pitch)
+{
+   if (input)
+      free((uint8_t*)input - BENCH_GUARD_ROWS * pitch);
+}
+
+static void bench_pool_job(void *data, unsigned index)
+{
+   struct bench_pool *pool = data;
+   pool->packets[index].work(pool->filter, pool->packets[index].thread_data);
+}
+
+static void bench_pool_init(struct bench_pool *pool, unsigned threads)
+{
+   memset(pool, 0, sizeof(*pool));
+   pool->max_threads = threads;
+}
+
+static void bench_pool_free(struct bench_pool *pool)
+{
+   for (unsigned t = 2; t <= pool->max_threads; t++)
+      sthread_pool_free(pool->threads[t]);
+}
+
+static void bench_pool_run(struct bench_pool *pool, void *filter,
+      struct softfilter_work_packet *packets, unsigned num_packets, unsigned threads)
+{
+   pool->filter = filter;
+   pool->packets = packets;
+
+   if (threads > 1 && !pool->threads[threads])
+   {
+      pool->threads[threads] = sthread_pool_new(threads - 1, false);
+      if (!pool->threads[threads])
+      {
+         fprintf(stderr, "Failed to start worker threads.\n");
+         exit(1);
+      }
+   }
+
+   if (threads > 1)
+      sthread_pool_run(pool->threads[threads], bench_pool_job, pool, num_packets);
+   else
+   {
+      for (unsigned i = 0; i < num_packets; i++)
+         bench_pool_job(pool, i);
+   }
+}
+
+// One instance of an implementation, set up for one frame and format.
+struct bench_run
+{
+   const struct softfilter_implementation *impl;
+   void *filter;
+   unsigned threads;
+   unsigned fmt;
+   unsigned out_fmt;
+
+   const struct bench_frame *frame;
+   void *input;
+   size_t input_pitch;
+
+   unsigned out_width;
+   unsigned out_height;
+   void *output;
+   size_t output_pitch;
+
+   bool tiled;
+   struct softfilter_work_packet *packets;
+   unsigned num_packets;
+};
+
+static bool bench_run_init(struct bench_run *run, const struct softfilter_implementation *impl,
+      unsigned simd, unsigned fmt, const struct bench_frame *frame, unsigned threads, bool tiles)
+{
+   memset(run, 0, sizeof(*run));
+   run->impl = impl;
+   run->fmt = fmt;
+   run->frame = frame;
+
+   // Same output format negotiation as rarch_softfilter_new().
+   unsigned output_fmts = impl->query_output_formats(fmt);
+   if (output_fmts & fmt)
+      run->out_fmt = fmt;
+   else if (output_fmts & SOFTFILTER_FMT_XRGB8888)
+      run->out_fmt = SOFTFILTER_FMT_XRGB8888;
+   else if (output_fmts & SOFTFILTER_FMT_RGB565)
+      run->out_fmt = SOFTFILTER_FMT_RGB565;
+   else
+      return false;
+
+   run->filter = impl->create(fmt, run->out_fmt, frame->width, frame->height, threads, simd);
+   if (!run->filter)
+      return false;
+
+   run->threads = impl->query_num_threads(run->filter);
+   if (!run->threads || run->threads > threads)
+      return false;
+
+   run->num_packets = run->threads;
+   if (tiles && impl->api_version >= 2 && impl->get_work_tiles && impl->query_num_tiles)
+   {
+      run->num_packets = impl->query_num_tiles(run->filter);
+      run->tiled = run->num_packets > 0;
+      if (!run->tiled)
+         run->num_packets = run->threads;
+   }
+   if (!(run->packets = calloc(run->num_packets, sizeof(*run->packets))))
+      return false;
+
+   impl->query_output_size(run->filter, &run->out_width, &run->out_height,
+         frame->width, frame->height);
+   run->output_pitch = run->out_width * bench_bpp(run->out_fmt);
+   run->output = calloc(run->out_height, run->output_pitch);
+   run->input = bench_make_input(frame, fmt, &run->input_pitch);
+   return run->output && run->input;
+}
+
+static void bench_run_free(struct bench_run *run)
+{
+   if (run->filter)
+      run->impl->destroy(run->filter);
+   bench_free_input(run->input, run->input_pitch);
+   free(run->output);
+   free(run->packets);
+}
+
+static void bench_run_frame(struct bench_run *run, struct bench_pool *pool)
+{
+   unsigned num_packets = run->threads;
+   if (run->tiled)
+      num_packets = run->impl->get_work_tiles(run->filter, run->packets,
+            run->output, run->output_pitch,
+            run->input, run->frame->width, run->frame->height, run->input_pitch);
+   else
+      run->impl->get_work_packets(run->filter, run->packets,
+            run->output, run->output_pitch,
+            run->input, run->frame->width, run->frame->height, run->input_pitch);
+   bench_pool_run(pool, run->filter, run->packets, num_packets, run->threads);
+}
+
+static uint64_t bench_run_hash(const struct bench_run *run)
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   for (unsigned y = 0; y < run->out_height; y++)
+      hash = bench_hash(hash, (const uint8_t*)run->output + y * run->output_pitch,
+            run->output_pitch);
+   return hash;
+}
+
+// Inverts input rows [first, last) of a run.
+static void bench_run_touch_rows(struct bench_run *run, unsigned first, unsigned last)
+{
+   for (unsigned y = first; y < last; y++)
+   {
+      uint8_t *row = (uint8_t*)run->input + y * run->input_pitch;
+      for (size_t x = 0; x < run->frame->width * bench_bpp(run->fmt); x++)
+         row[x] = ~row[x];
+   }
+}
+
+// Filters a frame, then the same frame with a few rows changed, the way the frontend does
+// with video_dirty_rows: the second time, only tiles within SOFTFILTER_TILE_MARGIN rows of the
+// changed ones are run, unless the filter says its output depends on the frame.
+// The result has to match filtering both frames in full. Returns number of failures.
+static unsigned bench_check_dirty(const struct softfilter_implementation *impl, unsigned simd,
+      unsigned fmt, const struct bench_frame *frame, struct bench_pool *pool, const char *key)
+{
+   struct bench_run run, ref;
+   unsigned failures = 0;
+   unsigned first = frame->height / 2, last = first + 2;
+
+   memset(&ref, 0, sizeof(ref));
+   bool ok = bench_run_init(&run, impl, simd, fmt, frame, 1, true) &&
+      bench_run_init(&ref, impl, simd, fmt, frame, 1, true);
+   if (!ok)
+   {
+      fprintf(stderr, "%s: failed to set up %s for dirty rows.\n", impl->ident, key);
+      failures++;
+      goto end;
+   }
+   if (!run.tiled)
+      goto end;
+
+   bench_run_frame(&run, pool);
+   bench_run_frame(&ref, pool);
+   bench_run_touch_rows(&run, first, last);
+   bench_run_touch_rows(&ref, first, last);
+   bench_run_frame(&ref, pool);
+
+   unsigned tiles = impl->get_work_tiles(run.filter, run.packets,
+         run.output, run.output_pitch, run.input, frame->width, frame->height, run.input_pitch);
+   unsigned lo = 0, hi = tiles;
+   if (!(impl->api_version >= 3 && impl->query_frame_dependent && impl->query_frame_dependent(run.filter)))
+   {
+      // Same selection as filter_skip_clean_tiles().
+      while (lo < tiles && (frame->height * (lo + 1)) / tiles + SOFTFILTER_TILE_MARGIN <= first)
+         lo++;
+      while (hi > lo && (frame->height * (hi - 1)) / tiles >= last + SOFTFILTER_TILE_MARGIN)
+         hi--;
+   }
+   bench_pool_run(pool, run.filter, run.packets + lo, hi - lo, 1);
+
+   if (bench_run_hash(&run) != bench_run_hash(&ref))
+   {
+      fprintf(stderr, "%s: output for %s with dirty rows does not match full frames.\n",
+            impl->ident, key);
+      failures++;
+   }
+
+end:
+   bench_run_free(&run);
+   bench_run_free(&ref);
+   return failures;
+}
+
+static bool bench_load_golden(const char *path)
+{
+   FILE *file = fopen(path, "r");
+   if (!file)
+      return false;
+
+   char line[256];
+   while (fgets(line, sizeof(line), file) && bench_num_golden < BENCH_MAX_GOLDEN)
+   {
+      struct bench_golden *golden = &bench_golden[bench_num_golden];
+      char *hash = strrchr(line, ' ');
+      if (line[0] == '#' || !hash)
+         continue;
+
+      *hash++ = '\0';
+      snprintf(golden->key, sizeof(golden->key), "%s", line);
+      golden->hash = strtoull(hash, NULL, 16);
+      bench_num_golden++;
+   }
+
+   fclose(file);
+   return true;
+}
+
+static struct bench_golden *bench_find_golden(const char *key)
+{
+   for (unsigned i = 0; i < bench_num_golden; i++)
+      if (strcmp(bench_golden[i].key, key) == 0)
+         return &bench_golden[i];
+   return NULL;
+}
+
+// Returns the distinct implementations a plugin offers for the SIMD features of this CPU.
+// The C implementation comes first, followed by ones selected by growing feature masks.
+static unsigned bench_get_impls(softfilter_get_implementation_t get,
+      const struct softfilter_implementation **impls, unsigned *masks)
+{
+   unsigned cpu = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("mmx"))
+      cpu |= SOFTFILTER_SIMD_MMX;
+   if (__builtin_cpu_supports("sse"))
+      cpu |= SOFTFILTER_SIMD_SSE;
+   if (__builtin_cpu_supports("sse2"))
+      cpu |= SOFTFILTER_SIMD_SSE2;
+   if (__builtin_cpu_supports("sse3"))
+      cpu |= SOFTFILTER_SIMD_SSE3;
+   if (__builtin_cpu_supports("ssse3"))
+      cpu |= SOFTFILTER_SIMD_SSSE3;
+   if (__builtin_cpu_supports("sse4.1"))
+      cpu |= SOFTFILTER_SIMD_SSE4;
+   if (__builtin_cpu_supports("sse4.2"))
+      cpu |= SOFTFILTER_SIMD_SSE42;
+   if (__builtin_cpu_supports("avx"))
+      cpu |= SOFTFILTER_SIMD_AVX;
+   if (__builtin_cpu_supports("avx2"))
+      cpu |= SOFTFILTER_SIMD_AVX2;
+#elif defined(__ARM_NEON__)
+   cpu |= SOFTFILTER_SIMD_NEON;
+#endif
+
+   unsigned num = 0;
+   for (int bit = -1; bit < 32 && num < BENCH_MAX_IMPLS; bit++)
+   {
+      unsigned mask = bit < 0 ? 0 : cpu & ((2u << bit) - 1);
+      if (bit >= 0 && !(cpu & (1u << bit)))
+         continue;
+
+      const struct softfilter_implementation *impl = get(mask);
+      if (!impl || impl->api_version < 1 || impl->api_version > SOFTFILTER_API_VERSION)
+         continue;
+
+      bool dupe = false;
+      for (unsigned i = 0; i < num; i++)
+         dupe |= impls[i] == impl;
+      if (dupe)
+         continue;
+
+      impls[num] = impl;
+      masks[num] = mask;
+      num++;
+   }
+
+   return num;
+}
+
+struct bench_options
+{
+   unsigned max_threads;
+   double seconds;
+   bool no_tiles;
+   const char *check;
+   FILE *update;
+};
+
+// Benchmarks and checks one plugin. Returns number of failures.
+static unsigned bench_plugin(const char *path, const struct bench_options *opt, struct bench_pool *pool)
+{
+   void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+   if (!lib)
+   {
+      fprintf(stderr, "Failed to load %s: %s\n", path, dlerror());
+      return 1;
+   }
+
+   unsigned failures = 0;
+   softfilter_get_implementation_t get =
+      (softfilter_get_implementation_t)dlsym(lib, "softfilter_get_implementation");
+   if (!get)
+   {
+      fprintf(stderr, "%s has no softfilter_get_implementation.\n", path);
+      dlclose(lib);
+      return 1;
+   }
+
+   const char *plugin = strrchr(path, '/');
+   plugin = plugin ? plugin + 1 : path;
+
+   const struct softfilter_implementation *impls[BENCH_MAX_IMPLS];
+   unsigned masks[BENCH_MAX_IMPLS];
+   unsigned num_impls = bench_get_impls(get, impls, masks);
+
+   static const unsigned fmts[] = { SOFTFILTER_FMT_RGB565, SOFTFILTER_FMT_XRGB8888 };
+   for (unsigned i = 0; i < num_impls; i++)
+   {
+      const struct softfilter_implementation *impl = impls[i];
+
+      for (unsigned f = 0; f < sizeof(fmts) / sizeof(fmts[0]); f++)
+      {
+         if (!(impl->query_input_formats() & fmts[f]))
+            continue;
+
+         for (unsigned fr = 0; fr < bench_num_frames; fr++)
+         {
+            const struct bench_frame *frame = &bench_frames[fr];
+            struct bench_run run;
+
+            // Conformance. Fresh instances, as filters may keep state between frames.
+            for (unsigned t = 0; t < sizeof(bench_golden_threads) / sizeof(bench_golden_threads[0]); t++)
+            {
+               unsigned threads = bench_golden_threads[t];
+               if ((!opt->check && !opt->update) || fr >= bench_num_synthetic || threads > pool->max_threads)
+                  continue;
+
+               // Golden checksums are taken from the C implementation only.
+               if (opt->update && i != 0)
+                  continue;
+
+               char key[256];
+               snprintf(key, sizeof(key), "%s %s %s %u", plugin, bench_fmt_name(fmts[f]),
+                     frame->name, threads);
+
+               if (!bench_run_init(&run, impl, masks[i], fmts[f], frame, threads, !opt->no_tiles))
+               {
+                  fprintf(stderr, "%s: failed to set up %s.\n", impl->ident, key);
+                  bench_run_free(&run);
+                  failures++;
+                  continue;
+               }
+
+               bench_run_frame(&run, pool);
+               uint64_t hash = bench_run_hash(&run);
+               bench_run_free(&run);
+
+               if (opt->update)
+               {
+                  fprintf(opt->update, "%s %016llx\n", key, (unsigned long long)hash);
+                  continue;
+               }
+
+               struct bench_golden *golden = bench_find_golden(key);
+               if (!golden)
+               {
+                  fprintf(stderr, "%s: no golden checksum for %s.\n", impl->ident, key);
+                  failures++;
+               }
+               else if (golden->hash != hash)
+               {
+                  fprintf(stderr, "%s: output for %s does not match golden checksum.\n",
+                        impl->ident, key);
+                  failures++;
+               }
+            }
+
+            if (opt->check && fr < bench_num_synthetic && !opt->no_tiles)
+            {
+               char key[256];
+               snprintf(key, sizeof(key), "%s %s %s", plugin, bench_fmt_name(fmts[f]), frame->name);
+               failures += bench_check_dirty(impl, masks[i], fmts[f], frame, pool, key);
+            }
+
+            // Throughput.
+            for (unsigned threads = 1; opt->seconds > 0.0 && threads <= opt->max_threads; threads++)
+            {
+               if (!bench_run_init(&run, impl, masks[i], fmts[f], frame, threads, !opt->no_tiles))
+               {
+                  bench_run_free(&run);
+                  continue;
+               }
+
+               // Filters may use fewer threads than asked for. Do not report those twice.
+               if (run.threads == threads)
+               {
+                  unsigned frames = 0;
+                  double start = bench_time();
+                  double elapsed = 0.0;
+                  do
+                  {
+                     bench_run_frame(&run, pool);
+                     frames++;
+                     elapsed = bench_time() - start;
+                  } while (elapsed < opt->seconds);
+
+                  printf("%s,%s,%s,%s,%ux%u,%u,%s,%.2f\n", plugin, impl->ident, bench_fmt_name(fmts[f]),
+                        frame->name, frame->width, frame->height, threads, run.tiled ? "tiles" : "slices",
+                        (double)frames * frame->width * frame->height / elapsed / 1000000.0);
+                  fflush(stdout);
+               }
+
+               bench_run_free(&run);
+            }
+         }
+      }
+   }
+
+   dlclose(lib);
+   return failures;
+}
+
+static void bench_usage(const char *argv0)
+{
+   fprintf(stderr, "Usage: %s [options] filter.so...\n", argv0);
+   fprintf(stderr, "   --threads <n>     Benchmark 1 to n threads. Defaults to number of CPUs.\n");
+   fprintf(stderr, "   --seconds <s>     Time spent per measurement. 0 disables benchmarking.\n");
+   fprintf(stderr, "   --no-tiles        Split frames into one slice per thread even if filters support tiles.\n");
+   fprintf(stderr, "   --frame <file>    Also run a recorded frame (24 or 32-bit BMP).\n");
+   fprintf(stderr, "   --check <file>    Compare output to golden checksums in file.\n");
+   fprintf(stderr, "   --update <file>   Write golden checksums of C implementations to file.\n");
+   fprintf(stderr, "   --header          Print CSV header and exit.\n");
+}
+
+int main(int argc, char *argv[])
+{
+   struct bench_options opt = {0};
+   const char *update = NULL;
+   long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   opt.max_threads = cpus > 0 ? cpus : 1;
+   opt.seconds = BENCH_MIN_SECONDS;
+
+   int i;
+   for (i = 1; i < argc && argv[i][0] == '-'; i++)
+   {
+      bool has_arg = i + 1 < argc;
+      if (strcmp(argv[i], "--header") == 0)
+      {
+         printf("plugin,implementation,format,frame,size,threads,split,mpix_per_sec\n");
+         return 0;
+      }
+      else if (strcmp(argv[i], "--threads") == 0 && has_arg)
+         opt.max_threads = strtoul(argv[++i], NULL, 0);
+      else if (strcmp(argv[i], "--seconds") == 0 && has_arg)
+         opt.seconds = strtod(argv[++i], NULL);
+      else if (strcmp(argv[i], "--no-tiles") == 0)
+         opt.no_tiles = true;
+      else if (strcmp(argv[i], "--check") == 0 && has_arg)
+         opt.check = argv[++i];
+      else if (strcmp(argv[i], "--update") == 0 && has_arg)
+         update = argv[++i];
+      else if (strcmp(argv[i], "--frame") == 0 && has_arg)
+      {
+         if (!bench_load_bmp(argv[++i]))
+         {
+            fprintf(stderr, "Failed to load frame %s.\n", argv[i]);
+            return 1;
+         }
+      }
+      else
+      {
+         bench_usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if (i == argc || !opt.max_threads || opt.max_threads > BENCH_MAX_THREADS || (opt.check && update))
+   {
+      bench_usage(argv[0]);
+      return 1;
+   }
+
+   // Synthetic frames go first, as only they have golden checksums.
+   struct bench_frame recorded[BENCH_MAX_FRAMES];
+   unsigned num_recorded = bench_num_frames;
+   memcpy(recorded, bench_frames, sizeof(recorded));
+   bench_num_frames = 0;
+   bench_gen_frames();
+   bench_num_synthetic = bench_num_frames;
+   for (unsigned r = 0; r < num_recorded && bench_num_frames < BENCH_MAX_FRAMES; r++)
+      bench_frames[bench_num_frames++] = recorded[r];
+
+   if (opt.check && !bench_load_golden(opt.check))
+   {
+      fprintf(stderr, "Failed to load golden checksums from %s.\n", opt.check);
+      return 1;
+   }
+
+   if (update && !(opt.update = fopen(update, "w")))
+   {
+      fprintf(stderr, "Failed to open %s.\n", update);
+      return 1;
+   }
+   if (opt.update)
+      fprintf(opt.update, "# Generated by softfilter-bench --update. <plugin> <format> <frame> <threads> <FNV-1a>\n");
+
+   // Golden checksums need enough threads, even when benchmarking fewer.
+   unsigned pool_threads = opt.max_threads;
+   for (unsigned t = 0; t < sizeof(bench_golden_threads) / sizeof(bench_golden_threads[0]); t++)
+      if (bench_golden_threads[t] > pool_threads)
+         pool_threads = bench_golden_threads[t];
+
+   struct bench_pool pool;
+   bench_pool_init(&pool, pool_threads);
+
+   unsigned failures = 0;
+   for (; i < argc; i++)
+      failures += bench_plugin(argv[i], &opt, &pool);
+
+   bench_pool_free(&pool);
+
+   if (opt.update)
+      fclose(opt.update);
+
+   if (opt.check)
+      fprintf(stderr, "%u conformance failure(s).\n", failures);
+
+   for (unsigned f = 0; f < bench_num_frames; f++)
+      free(bench_frames[f].data);
+
+   return failures ? 1 : 0;
+}
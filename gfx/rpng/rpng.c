@@ -23,6 +23,16 @@
 
 #include "../../hash.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#if defined(HAVE_ZLIB_DEFLATE) && defined(HAVE_THREADS)
+#include "../../thread.h"
+#endif
+
 #undef GOTO_END_ERROR
 #define GOTO_END_ERROR() do { \
    fprintf(stderr, "[RPNG]: Error in line %d.\n", __LINE__); \
@@ -375,10 +385,268 @@ static void png_pass_geom(const struct png_ihdr *ihdr,
 }
 
 
+// Unfilters a scanline. out and in must not overlap.
+// Filters for 8-bit RGB and RGBA, which menu wallpapers and thumbnails almost always are,
+// work on a pixel at a time in vector registers.
+static void png_unfilter_up(uint8_t *out, const uint8_t *in, const uint8_t *prev, unsigned pitch)
+{
+   unsigned i = 0;
+#if defined(__SSE2__)
+   for (; i + 16 <= pitch; i += 16)
+   {
+      __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(prev + i));
+      _mm_storeu_si128((__m128i*)(out + i), _mm_add_epi8(x, b));
+   }
+#elif defined(__ARM_NEON__)
+   for (; i + 16 <= pitch; i += 16)
+      vst1q_u8(out + i, vaddq_u8(vld1q_u8(in + i), vld1q_u8(prev + i)));
+#endif
+   for (; i < pitch; i++)
+      out[i] = prev[i] + in[i];
+}
+
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+// Pixels are loaded and stored as whole words. Every pixel but the last of an RGB line
+// is followed by at least one more byte, which is overwritten by the next pixel anyway.
+#if defined(__SSE2__)
+typedef __m128i png_pixel_t;
+
+static inline png_pixel_t png_zero_pixel(void)
+{
+   return _mm_setzero_si128();
+}
+
+static inline png_pixel_t png_load_pixel(const uint8_t *ptr, unsigned size)
+{
+   uint32_t val = 0;
+   memcpy(&val, ptr, size);
+   return _mm_cvtsi32_si128(val);
+}
+
+static inline void png_store_pixel(uint8_t *ptr, png_pixel_t pixel, unsigned size)
+{
+   uint32_t val = _mm_cvtsi128_si32(pixel);
+   memcpy(ptr, &val, size);
+}
+
+static inline png_pixel_t png_sub_pixel(png_pixel_t a, png_pixel_t x)
+{
+   return _mm_add_epi8(a, x);
+}
+
+static inline png_pixel_t png_avg_pixel(png_pixel_t a, png_pixel_t b, png_pixel_t x)
+{
+   // pavgb rounds up, (a + b) >> 1 does not.
+   __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+         _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+   return _mm_add_epi8(x, avg);
+}
+
+static inline png_pixel_t png_paeth_pixel(png_pixel_t a, png_pixel_t b, png_pixel_t c, png_pixel_t x)
+{
+   const __m128i zero = _mm_setzero_si128();
+   __m128i a16 = _mm_unpacklo_epi8(a, zero);
+   __m128i b16 = _mm_unpacklo_epi8(b, zero);
+   __m128i c16 = _mm_unpacklo_epi8(c, zero);
+
+   __m128i pa = _mm_sub_epi16(b16, c16);
+   __m128i pb = _mm_sub_epi16(a16, c16);
+   __m128i pc = _mm_add_epi16(pa, pb);
+   pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+   pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+   pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+   __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+   __m128i is_a = _mm_cmpeq_epi16(pa, smallest);
+   __m128i is_b = _mm_cmpeq_epi16(pb, smallest);
+   is_a = _mm_packs_epi16(is_a, is_a);
+   is_b = _mm_packs_epi16(is_b, is_b);
+
+   __m128i nearest = _mm_or_si128(_mm_and_si128(is_b, b), _mm_andnot_si128(is_b, c));
+   nearest = _mm_or_si128(_mm_and_si128(is_a, a), _mm_andnot_si128(is_a, nearest));
+   return _mm_add_epi8(nearest, x);
+}
+#else
+typedef uint8x8_t png_pixel_t;
+
+static inline png_pixel_t png_zero_pixel(void)
+{
+   return vdup_n_u8(0);
+}
+
+static inline png_pixel_t png_load_pixel(const uint8_t *ptr, unsigned size)
+{
+   uint32_t val = 0;
+   memcpy(&val, ptr, size);
+   return vreinterpret_u8_u32(vdup_n_u32(val));
+}
+
+static inline void png_store_pixel(uint8_t *ptr, png_pixel_t pixel, unsigned size)
+{
+   uint32_t val = vget_lane_u32(vreinterpret_u32_u8(pixel), 0);
+   memcpy(ptr, &val, size);
+}
+
+static inline png_pixel_t png_sub_pixel(png_pixel_t a, png_pixel_t x)
+{
+   return vadd_u8(a, x);
+}
+
+static inline png_pixel_t png_avg_pixel(png_pixel_t a, png_pixel_t b, png_pixel_t x)
+{
+   return vadd_u8(x, vhadd_u8(a, b));
+}
+
+static inline png_pixel_t png_paeth_pixel(png_pixel_t a, png_pixel_t b, png_pixel_t c, png_pixel_t x)
+{
+   uint16x8_t pa = vmovl_u8(vabd_u8(b, c));
+   uint16x8_t pb = vmovl_u8(vabd_u8(a, c));
+   uint16x8_t pc = vabdq_u16(vaddl_u8(a, b), vshll_n_u8(c, 1));
+
+   uint8x8_t is_a = vmovn_u16(vandq_u16(vcleq_u16(pa, pb), vcleq_u16(pa, pc)));
+   uint8x8_t is_b = vmovn_u16(vcleq_u16(pb, pc));
+   return vadd_u8(vbsl_u8(is_a, a, vbsl_u8(is_b, b, c)), x);
+}
+#endif
+
+// With p = a + b - c, |p - a| = |b - c|, |p - b| = |a - c| and |p - c| = |a + b - 2c|.
+// Ties go to a, then b, like paeth() does.
+static inline void png_unfilter_pixel(uint8_t *out, const uint8_t *in, const uint8_t *prev,
+      png_pixel_t *a, png_pixel_t *c, unsigned filter, unsigned size)
+{
+   png_pixel_t x = png_load_pixel(in, size);
+   if (filter == 1)
+      *a = png_sub_pixel(*a, x);
+   else
+   {
+      png_pixel_t b = png_load_pixel(prev, size);
+      if (filter == 3)
+         *a = png_avg_pixel(*a, b, x);
+      else
+      {
+         *a = png_paeth_pixel(*a, b, *c, x);
+         *c = b;
+      }
+   }
+
+   png_store_pixel(out, *a, size);
+}
+
+static inline void png_unfilter_simd(uint8_t *out, const uint8_t *in, const uint8_t *prev,
+      unsigned filter, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+   png_pixel_t a = png_zero_pixel(), c = a;
+
+   for (i = 0; i + 4 <= pitch; i += bpp)
+      png_unfilter_pixel(out + i, in + i, prev + i, &a, &c, filter, 4);
+   for (; i < pitch; i += bpp)
+      png_unfilter_pixel(out + i, in + i, prev + i, &a, &c, filter, bpp);
+}
+
+// Instantiates the pixel loop for every filter with a constant pixel size.
+#define PNG_UNFILTER_SIMD(filter) do { \
+   if (bpp == 4) \
+      png_unfilter_simd(out, in, prev, filter, pitch, 4); \
+   else \
+      png_unfilter_simd(out, in, prev, filter, pitch, 3); \
+} while(0)
+#endif
+
+static bool png_unfilter_line(uint8_t *out, const uint8_t *in, const uint8_t *prev,
+      unsigned filter, unsigned pitch, unsigned bpp)
+{
+   unsigned i;
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+   bool simd = bpp == 3 || bpp == 4;
+#endif
+
+   switch (filter)
+   {
+      case 0: // None
+         if (out != in)
+            memcpy(out, in, pitch);
+         break;
+
+      case 1: // Sub
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+         if (simd)
+         {
+            PNG_UNFILTER_SIMD(1);
+            break;
+         }
+#endif
+         for (i = 0; i < bpp; i++)
+            out[i] = in[i];
+         for (i = bpp; i < pitch; i++)
+            out[i] = out[i - bpp] + in[i];
+         break;
+
+      case 2: // Up
+         png_unfilter_up(out, in, prev, pitch);
+         break;
+
+      case 3: // Average
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+         if (simd)
+         {
+            PNG_UNFILTER_SIMD(3);
+            break;
+         }
+#endif
+         for (i = 0; i < bpp; i++)
+         {
+            uint8_t avg = prev[i] >> 1;
+            out[i] = avg + in[i];
+         }
+         for (i = bpp; i < pitch; i++)
+         {
+            uint8_t avg = (out[i - bpp] + prev[i]) >> 1;
+            out[i] = avg + in[i];
+         }
+         break;
+
+      case 4: // Paeth
+#if defined(__SSE2__) || defined(__ARM_NEON__)
+         if (simd)
+         {
+            PNG_UNFILTER_SIMD(4);
+            break;
+         }
+#endif
+         for (i = 0; i < bpp; i++)
+            out[i] = paeth(0, prev[i], 0) + in[i];
+         for (i = bpp; i < pitch; i++)
+            out[i] = paeth(out[i - bpp], prev[i], prev[i - bpp]) + in[i];
+         break;
+
+      default:
+         return false;
+   }
+
+   return true;
+}
+
+static void png_copy_line(uint32_t *data, const uint8_t *decoded,
+      const struct png_ihdr *ihdr, const uint32_t *palette)
+{
+   if (ihdr->color_type == 0)
+      copy_line_bw(data, decoded, ihdr->width, ihdr->depth);
+   else if (ihdr->color_type == 2)
+      copy_line_rgb(data, decoded, ihdr->width, ihdr->depth);
+   else if (ihdr->color_type == 3)
+      copy_line_plt(data, decoded, ihdr->width, ihdr->depth, palette);
+   else if (ihdr->color_type == 4)
+      copy_line_gray_alpha(data, decoded, ihdr->width, ihdr->depth);
+   else if (ihdr->color_type == 6)
+      copy_line_rgba(data, decoded, ihdr->width, ihdr->depth);
+}
+
 static bool png_reverse_filter(uint32_t *data, const struct png_ihdr *ihdr,
       const uint8_t *inflate_buf, size_t inflate_buf_size, const uint32_t *palette)
 {
-   unsigned i, h;
+   unsigned h;
    bool ret = true;
 
    unsigned bpp;
@@ -399,60 +667,14 @@ static bool png_reverse_filter(uint32_t *data, const struct png_ihdr *ihdr,
          h++, inflate_buf += pitch, data += ihdr->width)
    {
       unsigned filter = *inflate_buf++;
-      switch (filter)
-      {
-         case 0: // None
-            memcpy(decoded_scanline, inflate_buf, pitch);
-            break;
-
-         case 1: // Sub
-            for (i = 0; i < bpp; i++)
-               decoded_scanline[i] = inflate_buf[i];
-            for (i = bpp; i < pitch; i++)
-               decoded_scanline[i] = decoded_scanline[i - bpp] + inflate_buf[i];
-            break;
-
-         case 2: // Up
-            for (i = 0; i < pitch; i++)
-               decoded_scanline[i] = prev_scanline[i] + inflate_buf[i];
-            break;
-
-         case 3: // Average
-            for (i = 0; i < bpp; i++)
-            {
-               uint8_t avg = prev_scanline[i] >> 1;
-               decoded_scanline[i] = avg + inflate_buf[i];
-            }
-            for (i = bpp; i < pitch; i++)
-            {
-               uint8_t avg = (decoded_scanline[i - bpp] + prev_scanline[i]) >> 1;
-               decoded_scanline[i] = avg + inflate_buf[i];
-            }
-            break;
-
-         case 4: // Paeth
-            for (i = 0; i < bpp; i++)
-               decoded_scanline[i] = paeth(0, prev_scanline[i], 0) + inflate_buf[i];
-            for (i = bpp; i < pitch; i++)
-               decoded_scanline[i] = paeth(decoded_scanline[i - bpp], prev_scanline[i], prev_scanline[i - bpp]) + inflate_buf[i];
-            break;
+      if (!png_unfilter_line(decoded_scanline, inflate_buf, prev_scanline, filter, pitch, bpp))
+         GOTO_END_ERROR();
 
-         default:
-            GOTO_END_ERROR();
-      }
+      png_copy_line(data, decoded_scanline, ihdr, palette);
 
-      if (ihdr->color_type == 0)
-         copy_line_bw(data, decoded_scanline, ihdr->width, ihdr->depth);
-      else if (ihdr->color_type == 2)
-         copy_line_rgb(data, decoded_scanline, ihdr->width, ihdr->depth);
-      else if (ihdr->color_type == 3)
-         copy_line_plt(data, decoded_scanline, ihdr->width, ihdr->depth, palette);
-      else if (ihdr->color_type == 4)
-         copy_line_gray_alpha(data, decoded_scanline, ihdr->width, ihdr->depth);
-      else if (ihdr->color_type == 6)
-         copy_line_rgba(data, decoded_scanline, ihdr->width, ihdr->depth);
-
-      memcpy(prev_scanline, decoded_scanline, pitch);
+      uint8_t *tmp     = prev_scanline;
+      prev_scanline    = decoded_scanline;
+      decoded_scanline = tmp;
    }
 
 end:
@@ -552,6 +774,130 @@ static bool png_append_idat(FILE *file, const struct png_chunk *chunk, struct id
    return true;
 }
 
+// Non-interlaced images are inflated while IDAT chunks are read, a scanline at a time,
+// and every scanline is unfiltered and converted right away. Only the previous scanline is kept around.
+#define PNG_READ_CHUNK_SIZE 0x10000
+
+struct png_stream
+{
+   z_stream stream;
+   bool init;
+   bool done;
+
+   uint8_t *raw; // Filter type, then the filtered scanline.
+   uint8_t *lines[2];
+   unsigned cur;
+   uint8_t *read_buf;
+   size_t fill;
+
+   unsigned bpp;
+   unsigned pitch;
+   unsigned h;
+   uint32_t *data;
+};
+
+static bool png_stream_init(struct png_stream *png, const struct png_ihdr *ihdr, uint32_t *data)
+{
+   png_pass_geom(ihdr, ihdr->width, ihdr->height, &png->bpp, &png->pitch, NULL);
+   png->raw      = malloc(png->pitch + 1);
+   png->lines[0] = calloc(1, png->pitch);
+   png->lines[1] = calloc(1, png->pitch);
+   png->read_buf = malloc(PNG_READ_CHUNK_SIZE);
+   if (!png->raw || !png->lines[0] || !png->lines[1] || !png->read_buf)
+      return false;
+
+   if (inflateInit(&png->stream) != Z_OK)
+      return false;
+
+   png->init = true;
+   png->data = data;
+   return true;
+}
+
+static void png_stream_free(struct png_stream *png)
+{
+   if (png->init)
+      inflateEnd(&png->stream);
+   free(png->raw);
+   free(png->lines[0]);
+   free(png->lines[1]);
+   free(png->read_buf);
+}
+
+static bool png_stream_inflate(struct png_stream *png, const struct png_ihdr *ihdr,
+      const uint32_t *palette, const uint8_t *in, size_t size)
+{
+   png->stream.next_in  = (uint8_t*)in;
+   png->stream.avail_in = size;
+
+   while (png->stream.avail_in && !png->done)
+   {
+      uint8_t *line = png->lines[png->cur];
+      uint8_t overflow;
+      int err;
+
+      // Anything after the last scanline but the end of the stream is an error.
+      if (png->h < ihdr->height)
+      {
+         png->stream.next_out  = png->raw + png->fill;
+         png->stream.avail_out = png->pitch + 1 - png->fill;
+      }
+      else
+      {
+         png->stream.next_out  = &overflow;
+         png->stream.avail_out = 1;
+      }
+
+      err = inflate(&png->stream, Z_NO_FLUSH);
+      if (err == Z_STREAM_END)
+         png->done = true;
+      else if (err != Z_OK)
+         return false;
+
+      if (png->h == ihdr->height)
+      {
+         if (!png->stream.avail_out)
+            return false;
+         continue;
+      }
+
+      png->fill = png->pitch + 1 - png->stream.avail_out;
+      if (png->fill <= png->pitch)
+         continue;
+
+      if (!png_unfilter_line(line, png->raw + 1, png->lines[png->cur ^ 1],
+               png->raw[0], png->pitch, png->bpp))
+         return false;
+      png_copy_line(png->data + png->h * ihdr->width, line, ihdr, palette);
+
+      png->cur ^= 1;
+      png->fill = 0;
+      png->h++;
+   }
+
+   return true;
+}
+
+static bool png_stream_idat(FILE *file, const struct png_chunk *chunk, struct png_stream *png,
+      const struct png_ihdr *ihdr, const uint32_t *palette)
+{
+   size_t remaining = chunk->size;
+
+   while (remaining)
+   {
+      size_t size = remaining < PNG_READ_CHUNK_SIZE ? remaining : PNG_READ_CHUNK_SIZE;
+      if (fread(png->read_buf, 1, size, file) != size)
+         return false;
+      if (!png_stream_inflate(png, ihdr, palette, png->read_buf, size))
+         return false;
+      remaining -= size;
+   }
+
+   if (fseek(file, sizeof(uint32_t), SEEK_CUR) < 0)
+      return false;
+   return true;
+}
+
 static bool png_read_plte(FILE *file, uint32_t *buffer, unsigned entries)
 {
    unsigned i;
@@ -601,6 +947,7 @@ bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, un
    z_stream stream = {0};
 
    struct idat_buffer idat_buf = {0};
+   struct png_stream png = {0};
    struct png_ihdr ihdr = {0};
    uint32_t palette[256] = {0};
 
@@ -656,8 +1003,24 @@ bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, un
             if (!has_ihdr || has_iend || (ihdr.color_type == 3 && !has_plte))
                GOTO_END_ERROR();
 
-            if (!png_append_idat(file, &chunk, &idat_buf))
-               GOTO_END_ERROR();
+            // Adam7 passes are still inflated in one go once all IDAT chunks are in.
+            if (ihdr.interlace == 1)
+            {
+               if (!png_append_idat(file, &chunk, &idat_buf))
+                  GOTO_END_ERROR();
+            }
+            else
+            {
+               if (!has_idat)
+               {
+                  *data = malloc(ihdr.width * ihdr.height * sizeof(uint32_t));
+                  if (!*data || !png_stream_init(&png, &ihdr, *data))
+                     GOTO_END_ERROR();
+               }
+
+               if (!png_stream_idat(file, &chunk, &png, &ihdr, palette))
+                  GOTO_END_ERROR();
+            }
 
             has_idat = true;
             break;
@@ -677,12 +1040,21 @@ bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, un
    if (!has_ihdr || !has_idat || !has_iend)
       GOTO_END_ERROR();
 
+   if (ihdr.interlace != 1)
+   {
+      if (!png.done || png.h != ihdr.height)
+         GOTO_END_ERROR();
+
+      *width  = ihdr.width;
+      *height = ihdr.height;
+      goto end;
+   }
+
    if (inflateInit(&stream) != Z_OK)
       GOTO_END_ERROR();
 
    png_pass_geom(&ihdr, ihdr.width, ihdr.height, NULL, NULL, &inflate_buf_size);
-   if (ihdr.interlace == 1) // To be sure.
-      inflate_buf_size *= 2;
+   inflate_buf_size *= 2; // To be sure.
 
    inflate_buf = malloc(inflate_buf_size);
    if (!inflate_buf)
@@ -706,19 +1078,18 @@ bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, un
    if (!*data)
       GOTO_END_ERROR();
 
-   if (ihdr.interlace == 1)
-   {
-      if (!png_reverse_filter_adam7(*data, &ihdr, inflate_buf, stream.total_out, palette))
-         GOTO_END_ERROR();
-   }
-   else if (!png_reverse_filter(*data, &ihdr, inflate_buf, stream.total_out, palette))
+   if (!png_reverse_filter_adam7(*data, &ihdr, inflate_buf, stream.total_out, palette))
       GOTO_END_ERROR();
 
 end:
    if (file)
       fclose(file);
+   png_stream_free(&png);
    if (!ret)
+   {
       free(*data);
+      *data = NULL;
+   }
    free(idat_buf.data);
    free(inflate_buf);
    return ret;
@@ -879,44 +1250,19 @@ static unsigned filter_paeth(uint8_t *target, const uint8_t *line, const uint8_t
    return count_sad(target, width);
 }
 
-static bool rpng_save_image(const char *path, const uint8_t *data,
-      unsigned width, unsigned height, unsigned pitch, unsigned bpp)
+// Filters rows [first, last) of an image into target, one filter type byte and one line each.
+static bool png_filter_lines(uint8_t *target, const uint8_t *data,
+      unsigned width, unsigned pitch, unsigned bpp, unsigned first, unsigned last)
 {
    unsigned h;
    bool ret = true;
-   struct png_ihdr ihdr = {0};
 
-   size_t encode_buf_size  = 0;
-   uint8_t *encode_buf     = NULL;
-   uint8_t *deflate_buf    = NULL;
    uint8_t *rgba_line      = NULL;
    uint8_t *up_filtered    = NULL;
    uint8_t *sub_filtered   = NULL;
    uint8_t *avg_filtered   = NULL;
    uint8_t *paeth_filtered = NULL;
    uint8_t *prev_encoded   = NULL;
-   uint8_t *encode_target  = NULL;
-
-   z_stream stream = {0};
-
-   FILE *file = fopen(path, "wb");
-   if (!file)
-      GOTO_END_ERROR();
-
-   if (fwrite(png_magic, 1, sizeof(png_magic), file) != sizeof(png_magic))
-      GOTO_END_ERROR();
-
-   ihdr.width = width;
-   ihdr.height = height;
-   ihdr.depth = 8;
-   ihdr.color_type = bpp == sizeof(uint32_t) ? 6 : 2; // RGBA or RGB
-   if (!png_write_ihdr(file, &ihdr))
-      GOTO_END_ERROR();
-
-   encode_buf_size = (width * bpp + 1) * height;
-   encode_buf = malloc(encode_buf_size);
-   if (!encode_buf)
-      GOTO_END_ERROR();
 
    prev_encoded = calloc(1, width * bpp);
    if (!prev_encoded)
@@ -930,9 +1276,18 @@ static bool rpng_save_image(const char *path, const uint8_t *data,
    if (!rgba_line || !up_filtered || !sub_filtered || !avg_filtered || !paeth_filtered)
       GOTO_END_ERROR();
 
-   encode_target = encode_buf;
-   for (h = 0; h < height;
-         h++, encode_target += width * bpp, data += pitch)
+   // Lines are filtered against the line above, which for a stripe is the last line of the one before.
+   if (first > 0)
+   {
+      if (bpp == sizeof(uint32_t))
+         copy_argb_line(prev_encoded, (const uint32_t*)(data + (first - 1) * pitch), width);
+      else
+         copy_bgr24_line(prev_encoded, data + (first - 1) * pitch, width);
+   }
+
+   data += first * pitch;
+   for (h = first; h < last;
+         h++, target += width * bpp, data += pitch)
    {
       if (bpp == sizeof(uint32_t))
          copy_argb_line(rgba_line, (const uint32_t*)data, width);
@@ -980,32 +1335,215 @@ static bool rpng_save_image(const char *path, const uint8_t *data,
          min_sad = paeth_score;
       }
 
-      *encode_target++ = filter;
-      memcpy(encode_target, chosen_filtered, width * bpp);
+      *target++ = filter;
+      memcpy(target, chosen_filtered, width * bpp);
 
       memcpy(prev_encoded, rgba_line, width * bpp);
    }
 
-   deflate_buf = malloc(encode_buf_size * 2); // Just to be sure.
-   if (!deflate_buf)
+end:
+   free(rgba_line);
+   free(prev_encoded);
+   free(up_filtered);
+   free(sub_filtered);
+   free(avg_filtered);
+   free(paeth_filtered);
+   return ret;
+}
+
+// Images are split into horizontal stripes, which are filtered and deflated
+// independently, as jobs on a thread pool. Every stripe but the last ends with
+// a sync flush, so the raw deflate streams simply concatenate into one (as pigz does).
+// A stripe starts off with the tail of the stripe before as its dictionary,
+// so compression barely suffers.
+#define PNG_STRIPE_MIN_ROWS 64
+#define PNG_DEFLATE_WINDOW 32768
+
+struct png_stripe
+{
+   const uint8_t *data;
+   unsigned width;
+   unsigned pitch;
+   unsigned bpp;
+   unsigned first, last; // Rows.
+
+   uint8_t *encode_buf; // Of the whole image.
+   size_t encode_offset;
+   size_t encode_size;
+   bool final;
+
+   uint8_t *deflated;
+   size_t deflated_size;
+   uint32_t adler;
+   bool ok;
+};
+
+static void png_stripe_filter(void *data, unsigned index)
+{
+   struct png_stripe *stripe = (struct png_stripe*)data + index;
+   stripe->ok = png_filter_lines(stripe->encode_buf + stripe->encode_offset,
+         stripe->data, stripe->width, stripe->pitch, stripe->bpp, stripe->first, stripe->last);
+}
+
+static void png_stripe_deflate(void *data, unsigned index)
+{
+   struct png_stripe *stripe = (struct png_stripe*)data + index;
+   const uint8_t *in = stripe->encode_buf + stripe->encode_offset;
+   size_t dict_size = stripe->encode_offset < PNG_DEFLATE_WINDOW ?
+      stripe->encode_offset : PNG_DEFLATE_WINDOW;
+   z_stream stream = {0};
+   int flush = stripe->final ? Z_FINISH : Z_SYNC_FLUSH;
+   int expect = stripe->final ? Z_STREAM_END : Z_OK;
+
+   stripe->ok = false;
+   stripe->adler = adler32(adler32(0, NULL, 0), in, stripe->encode_size);
+
+   // Raw deflate. The zlib header and checksum are written for the whole image.
+   if (deflateInit2(&stream, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return;
+
+   if (dict_size && deflateSetDictionary(&stream, in - dict_size, dict_size) != Z_OK)
+      goto end;
+
+   // A sync flush adds an empty stored block on top of what deflateBound() accounts for.
+   stripe->deflated_size = deflateBound(&stream, stripe->encode_size) + 16;
+   stripe->deflated = malloc(stripe->deflated_size);
+   if (!stripe->deflated)
+      goto end;
+
+   stream.next_in   = (uint8_t*)in;
+   stream.avail_in  = stripe->encode_size;
+   stream.next_out  = stripe->deflated;
+   stream.avail_out = stripe->deflated_size;
+
+   if (deflate(&stream, flush) != expect || stream.avail_in)
+      goto end;
+
+   stripe->deflated_size = stream.total_out;
+   stripe->ok = true;
+
+end:
+   deflateEnd(&stream);
+}
+
+// Runs func on every stripe, on the pool's workers and the calling thread.
+static bool png_run_stripes(struct png_stripe *stripes, unsigned num,
+      void (*func)(void*, unsigned), struct sthread_pool *pool)
+{
+   unsigned i;
+   bool ret = true;
+
+#ifdef HAVE_THREADS
+   if (pool && num > 1)
+      sthread_pool_run(pool, func, stripes, num);
+   else
+#endif
+   {
+      for (i = 0; i < num; i++)
+         func(stripes, i);
+   }
+
+   for (i = 0; i < num; i++)
+      ret = ret && stripes[i].ok;
+   return ret;
+}
+
+static bool rpng_save_image(const char *path, const uint8_t *data,
+      unsigned width, unsigned height, unsigned pitch, unsigned bpp, struct sthread_pool *pool)
+{
+   unsigned i, num_stripes;
+   bool ret = true;
+   struct png_ihdr ihdr = {0};
+   struct png_stripe *stripes = NULL;
+
+   size_t line_size        = width * bpp + 1;
+   size_t encode_buf_size  = line_size * height;
+   size_t deflate_buf_size = 0;
+   uint8_t *encode_buf     = NULL;
+   uint8_t *deflate_buf    = NULL;
+   uint8_t *deflate_target = NULL;
+   uint32_t adler          = 0;
+
+   FILE *file = fopen(path, "wb");
+   if (!file)
+      GOTO_END_ERROR();
+
+   if (fwrite(png_magic, 1, sizeof(png_magic), file) != sizeof(png_magic))
+      GOTO_END_ERROR();
+
+   ihdr.width = width;
+   ihdr.height = height;
+   ihdr.depth = 8;
+   ihdr.color_type = bpp == sizeof(uint32_t) ? 6 : 2; // RGBA or RGB
+   if (!png_write_ihdr(file, &ihdr))
+      GOTO_END_ERROR();
+
+   encode_buf = malloc(encode_buf_size);
+   if (!encode_buf)
       GOTO_END_ERROR();
 
-   stream.next_in   = encode_buf;
-   stream.avail_in  = encode_buf_size;
-   stream.next_out  = deflate_buf + 8;
-   stream.avail_out = encode_buf_size * 2;
+   num_stripes = height / PNG_STRIPE_MIN_ROWS;
+#ifdef HAVE_THREADS
+   if (!pool)
+      num_stripes = 1;
+   else if (num_stripes > sthread_pool_workers(pool) + 1)
+      num_stripes = sthread_pool_workers(pool) + 1;
+#else
+   num_stripes = 1;
+#endif
+   if (num_stripes < 1)
+      num_stripes = 1;
+
+   stripes = calloc(num_stripes, sizeof(*stripes));
+   if (!stripes)
+      GOTO_END_ERROR();
 
-   deflateInit(&stream, 9);
-   if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+   for (i = 0; i < num_stripes; i++)
    {
-      deflateEnd(&stream);
+      struct png_stripe *stripe = &stripes[i];
+      stripe->data          = data;
+      stripe->width         = width;
+      stripe->pitch         = pitch;
+      stripe->bpp           = bpp;
+      stripe->first         = (height * i) / num_stripes;
+      stripe->last          = (height * (i + 1)) / num_stripes;
+      stripe->encode_buf    = encode_buf;
+      stripe->encode_offset = stripe->first * line_size;
+      stripe->encode_size   = (stripe->last - stripe->first) * line_size;
+      stripe->final         = i + 1 == num_stripes;
+   }
+
+   // Dictionaries come from the stripe before, so filtering has to be done first.
+   if (!png_run_stripes(stripes, num_stripes, png_stripe_filter, pool))
+      GOTO_END_ERROR();
+   if (!png_run_stripes(stripes, num_stripes, png_stripe_deflate, pool))
+      GOTO_END_ERROR();
+
+   // Chunk header, zlib header, the stripes, Adler-32.
+   deflate_buf_size = 8 + 2 + 4;
+   for (i = 0; i < num_stripes; i++)
+      deflate_buf_size += stripes[i].deflated_size;
+
+   deflate_buf = malloc(deflate_buf_size);
+   if (!deflate_buf)
       GOTO_END_ERROR();
+
+   deflate_target = deflate_buf + 8;
+   *deflate_target++ = 0x78; // Deflate, 32K window.
+   *deflate_target++ = 0xda; // Maximum compression, header checksum.
+
+   adler = adler32(0, NULL, 0);
+   for (i = 0; i < num_stripes; i++)
+   {
+      memcpy(deflate_target, stripes[i].deflated, stripes[i].deflated_size);
+      deflate_target += stripes[i].deflated_size;
+      adler = adler32_combine(adler, stripes[i].adler, stripes[i].encode_size);
    }
-   deflateEnd(&stream);
+   dword_write_be(deflate_target, adler);
 
    memcpy(deflate_buf + 4, "IDAT", 4);
-   dword_write_be(deflate_buf + 0, stream.total_out);
-   if (!png_write_idat(file, deflate_buf, stream.total_out + 8))
+   dword_write_be(deflate_buf + 0, deflate_buf_size - 8);
+   if (!png_write_idat(file, deflate_buf, deflate_buf_size))
       GOTO_END_ERROR();
 
    if (!png_write_iend(file))
@@ -1014,27 +1552,27 @@ static bool rpng_save_image(const char *path, const uint8_t *data,
 end:
    if (file)
       fclose(file);
+   if (stripes)
+   {
+      for (i = 0; i < num_stripes; i++)
+         free(stripes[i].deflated);
+   }
+   free(stripes);
    free(encode_buf);
    free(deflate_buf);
-   free(rgba_line);
-   free(prev_encoded);
-   free(up_filtered);
-   free(sub_filtered);
-   free(avg_filtered);
-   free(paeth_filtered);
    return ret;
 }
 
 bool rpng_save_image_argb(const char *path, const uint32_t *data,
-      unsigned width, unsigned height, unsigned pitch)
+      unsigned width, unsigned height, unsigned pitch, struct sthread_pool *pool)
 {
-   return rpng_save_image(path, (const uint8_t*)data, width, height, pitch, sizeof(uint32_t));
+   return rpng_save_image(path, (const uint8_t*)data, width, height, pitch, sizeof(uint32_t), pool);
 }
 
 bool rpng_save_image_bgr24(const char *path, const uint8_t *data,
-      unsigned width, unsigned height, unsigned pitch)
+      unsigned width, unsigned height, unsigned pitch, struct sthread_pool *pool)
 {
-   return rpng_save_image(path, data, width, height, pitch, 3);
+   return rpng_save_image(path, data, width, height, pitch, 3, pool);
 }
 
 #endif
@@ -26,10 +26,14 @@
 bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, unsigned *height);
 
 #ifdef HAVE_ZLIB_DEFLATE
+struct sthread_pool;
+
+// With HAVE_THREADS, large images are encoded in stripes on the workers of pool
+// and the calling thread. pool may be NULL to encode on the calling thread only.
 bool rpng_save_image_argb(const char *path, const uint32_t *data,
-      unsigned width, unsigned height, unsigned pitch);
+      unsigned width, unsigned height, unsigned pitch, struct sthread_pool *pool);
 bool rpng_save_image_bgr24(const char *path, const uint8_t *data,
-      unsigned width, unsigned height, unsigned pitch);
+      unsigned width, unsigned height, unsigned pitch, struct sthread_pool *pool);
 #endif
 
 #endif
@@ -37,7 +37,7 @@ int main(int argc, char *argv[])
       0xff000000 | 0xc3, 0xff000000 | 0xd3, 0xff000000 | 0xc3, 0xff000000 | 0xd3,
    };
 
-   if (!rpng_save_image_argb("/tmp/test.png", test_data, 4, 4, 16))
+   if (!rpng_save_image_argb("/tmp/test.png", test_data, 4, 4, 16, NULL))
       return 1;
 
    uint32_t *data = NULL;
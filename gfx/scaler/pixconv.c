@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include "../../libretro.h"
 
 #ifdef SCALER_NO_SIMD
 #undef __SSE2__
@@ -27,6 +28,19 @@
 #include <emmintrin.h>
 #endif
 
+// AVX2 variants are compiled with target attributes, so the build does not need to assume AVX2.
+#if defined(__SSE2__) && (defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define PIXCONV_HAVE_AVX2
+#define PIXCONV_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON__) && !defined(SCALER_NO_SIMD)
+#define PIXCONV_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
 #if defined(__SSE2_)
 void conv_rgb565_0rgb1555(void *output_, const void *input_,
       int width, int height,
@@ -879,3 +893,494 @@ void conv_copy(void *output_, const void *input_,
    for (h = 0; h < height; h++, output += out_stride, input += in_stride)
       memcpy(output, input, copy_len);
 }
+
+// Variants of the hottest conversions for instruction sets the build does not assume.
+// They are picked at runtime by conv_simd(). Columns which do not fill a whole vector
+// are left to the baseline implementation, so the output is the same on every path.
+
+#if defined(PIXCONV_HAVE_AVX2)
+static PIXCONV_TARGET_AVX2 void conv_0rgb1555_rgb565_avx2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint16_t *input = input_;
+   uint16_t *output = output_;
+
+   const __m256i hi_mask   = _mm256_set1_epi16((int16_t)((0x1f << 11) | (0x1f << 6)));
+   const __m256i lo_mask   = _mm256_set1_epi16(0x1f);
+   const __m256i glow_mask = _mm256_set1_epi16(1 << 5);
+
+   for (h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+   {
+      for (w = 0; w + 16 <= width; w += 16)
+      {
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i rg   = _mm256_and_si256(_mm256_slli_epi16(in, 1), hi_mask);
+         __m256i b    = _mm256_and_si256(in, lo_mask);
+         __m256i glow = _mm256_and_si256(_mm256_srli_epi16(in, 4), glow_mask);
+         _mm256_storeu_si256((__m256i*)(output + w), _mm256_or_si256(rg, _mm256_or_si256(b, glow)));
+      }
+
+      if (w < width)
+         conv_0rgb1555_rgb565(output + w, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+// Takes 16 pixels as 16-bit lanes holding 8-bit channels.
+// Unpacks only work within 128-bit halves, so halves are put back in order before storing.
+static inline PIXCONV_TARGET_AVX2 void store_argb8888_avx2(uint32_t *output,
+      __m256i r, __m256i g, __m256i b)
+{
+   const __m256i a = _mm256_set1_epi16(0x00ff);
+
+   __m256i res_lo = _mm256_or_si256(_mm256_unpacklo_epi8(b, g),
+         _mm256_slli_si256(_mm256_unpacklo_epi8(r, a), 2));
+   __m256i res_hi = _mm256_or_si256(_mm256_unpackhi_epi8(b, g),
+         _mm256_slli_si256(_mm256_unpackhi_epi8(r, a), 2));
+
+   _mm256_storeu_si256((__m256i*)(output + 0), _mm256_permute2x128_si256(res_lo, res_hi, 0x20));
+   _mm256_storeu_si256((__m256i*)(output + 8), _mm256_permute2x128_si256(res_lo, res_hi, 0x31));
+}
+
+static PIXCONV_TARGET_AVX2 void conv_0rgb1555_argb8888_avx2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint16_t *input = input_;
+   uint32_t *output      = output_;
+
+   const __m256i pix_mask_r  = _mm256_set1_epi16(0x1f << 10);
+   const __m256i pix_mask_gb = _mm256_set1_epi16(0x1f <<  5);
+   const __m256i mul15_mid   = _mm256_set1_epi16(0x4200);
+   const __m256i mul15_hi    = _mm256_set1_epi16(0x0210);
+
+   for (h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   {
+      for (w = 0; w + 16 <= width; w += 16)
+      {
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i r = _mm256_and_si256(in, pix_mask_r);
+         __m256i g = _mm256_and_si256(in, pix_mask_gb);
+         __m256i b = _mm256_and_si256(_mm256_slli_epi16(in, 5), pix_mask_gb);
+
+         r = _mm256_mulhi_epi16(r, mul15_hi);
+         g = _mm256_mulhi_epi16(g, mul15_mid);
+         b = _mm256_mulhi_epi16(b, mul15_mid);
+
+         store_argb8888_avx2(output + w, r, g, b);
+      }
+
+      if (w < width)
+         conv_0rgb1555_argb8888(output + w, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+static PIXCONV_TARGET_AVX2 void conv_rgb565_argb8888_avx2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint16_t *input = input_;
+   uint32_t *output      = output_;
+
+   const __m256i pix_mask_r = _mm256_set1_epi16(0x1f << 10);
+   const __m256i pix_mask_g = _mm256_set1_epi16(0x3f <<  5);
+   const __m256i pix_mask_b = _mm256_set1_epi16(0x1f <<  5);
+   const __m256i mul16_r    = _mm256_set1_epi16(0x0210);
+   const __m256i mul16_g    = _mm256_set1_epi16(0x2080);
+   const __m256i mul16_b    = _mm256_set1_epi16(0x4200);
+
+   for (h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   {
+      for (w = 0; w + 16 <= width; w += 16)
+      {
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i r = _mm256_and_si256(_mm256_srli_epi16(in, 1), pix_mask_r);
+         __m256i g = _mm256_and_si256(in, pix_mask_g);
+         __m256i b = _mm256_and_si256(_mm256_slli_epi16(in, 5), pix_mask_b);
+
+         r = _mm256_mulhi_epi16(r, mul16_r);
+         g = _mm256_mulhi_epi16(g, mul16_g);
+         b = _mm256_mulhi_epi16(b, mul16_b);
+
+         store_argb8888_avx2(output + w, r, g, b);
+      }
+
+      if (w < width)
+         conv_rgb565_argb8888(output + w, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+static PIXCONV_TARGET_AVX2 void conv_argb8888_bgr24_avx2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint32_t *input = input_;
+   uint8_t *output       = output_;
+
+   // Drops alpha within each half, leaving 12 bytes (3 dwords) at the bottom of both.
+   const __m256i pack = _mm256_setr_epi8(
+         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+   // Rotates the 6 dwords of each vector into place, so 4 vectors blend into 3 stores.
+   const __m256i perm_a = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+   const __m256i perm_b = _mm256_setr_epi32(2, 4, 5, 6, 3, 7, 0, 1);
+   const __m256i perm_c = _mm256_setr_epi32(5, 6, 3, 7, 0, 1, 2, 4);
+   const __m256i perm_d = _mm256_setr_epi32(3, 7, 0, 1, 2, 4, 5, 6);
+
+   for (h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   {
+      uint8_t *out = output;
+
+      for (w = 0; w + 32 <= width; w += 32, out += 96)
+      {
+         __m256i a = _mm256_loadu_si256((const __m256i*)(input + w +  0));
+         __m256i b = _mm256_loadu_si256((const __m256i*)(input + w +  8));
+         __m256i c = _mm256_loadu_si256((const __m256i*)(input + w + 16));
+         __m256i d = _mm256_loadu_si256((const __m256i*)(input + w + 24));
+
+         a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(a, pack), perm_a);
+         b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(b, pack), perm_b);
+         c = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(c, pack), perm_c);
+         d = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(d, pack), perm_d);
+
+         _mm256_storeu_si256((__m256i*)(out +  0), _mm256_blend_epi32(a, b, 0xc0));
+         _mm256_storeu_si256((__m256i*)(out + 32), _mm256_blend_epi32(b, c, 0xf0));
+         _mm256_storeu_si256((__m256i*)(out + 64), _mm256_blend_epi32(c, d, 0xfc));
+      }
+
+      if (w < width)
+         conv_argb8888_bgr24(out, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+static PIXCONV_TARGET_AVX2 void conv_yuyv_argb8888_avx2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint8_t *input = input_;
+   uint32_t *output     = output_;
+
+   const __m256i mask_y = _mm256_set1_epi16(0xffu);
+   const __m256i mask_u = _mm256_set1_epi32(0xffu << 8);
+   const __m256i mask_v = _mm256_set1_epi32(0xffu << 24);
+   const __m256i chroma_offset = _mm256_set1_epi16(128);
+   const __m256i round_offset = _mm256_set1_epi16(YUV_OFFSET);
+
+   const __m256i yuv_mul = _mm256_set1_epi16(YUV_MAT_Y);
+   const __m256i u_g_mul = _mm256_set1_epi16(YUV_MAT_U_G);
+   const __m256i u_b_mul = _mm256_set1_epi16(YUV_MAT_U_B);
+   const __m256i v_r_mul = _mm256_set1_epi16(YUV_MAT_V_R);
+   const __m256i v_g_mul = _mm256_set1_epi16(YUV_MAT_V_G);
+   const __m256i a       = _mm256_set1_epi16(-1);
+
+   for (h = 0; h < height; h++, output += out_stride >> 2, input += in_stride)
+   {
+      const uint8_t *src = input;
+      uint32_t *dst = output;
+
+      // Same steps as the SSE2 version, on 32 pixels. Every step stays within 128-bit halves,
+      // and the pixel order they end up in is only straightened out when storing.
+      for (w = 0; w + 32 <= width; w += 32, src += 64, dst += 32)
+      {
+         __m256i yuv0 = _mm256_loadu_si256((const __m256i*)(src +  0));
+         __m256i yuv1 = _mm256_loadu_si256((const __m256i*)(src + 32));
+
+         __m256i y0 = _mm256_and_si256(yuv0, mask_y);
+         __m256i u0 = _mm256_and_si256(yuv0, mask_u);
+         __m256i v0 = _mm256_and_si256(yuv0, mask_v);
+         __m256i y1 = _mm256_and_si256(yuv1, mask_y);
+         __m256i u1 = _mm256_and_si256(yuv1, mask_u);
+         __m256i v1 = _mm256_and_si256(yuv1, mask_v);
+
+         u0 = _mm256_srli_si256(u0, 1);
+         v0 = _mm256_srli_si256(v0, 3);
+         u1 = _mm256_srli_si256(u1, 1);
+         v1 = _mm256_srli_si256(v1, 3);
+         __m256i u = _mm256_packs_epi32(u0, u1);
+         __m256i v = _mm256_packs_epi32(v0, v1);
+
+         u = _mm256_sub_epi16(u, chroma_offset);
+         v = _mm256_sub_epi16(v, chroma_offset);
+
+         // Lines up with y0 and y1 again, as packing and unpacking shuffle the same way.
+         u0 = _mm256_unpacklo_epi16(u, u);
+         u1 = _mm256_unpackhi_epi16(u, u);
+         v0 = _mm256_unpacklo_epi16(v, v);
+         v1 = _mm256_unpackhi_epi16(v, v);
+
+         y0 = _mm256_mullo_epi16(y0, yuv_mul);
+         y1 = _mm256_mullo_epi16(y1, yuv_mul);
+         __m256i u0_g   = _mm256_mullo_epi16(u0, u_g_mul);
+         __m256i u1_g   = _mm256_mullo_epi16(u1, u_g_mul);
+         __m256i u0_b   = _mm256_mullo_epi16(u0, u_b_mul);
+         __m256i u1_b   = _mm256_mullo_epi16(u1, u_b_mul);
+         __m256i v0_r   = _mm256_mullo_epi16(v0, v_r_mul);
+         __m256i v1_r   = _mm256_mullo_epi16(v1, v_r_mul);
+         __m256i v0_g   = _mm256_mullo_epi16(v0, v_g_mul);
+         __m256i v1_g   = _mm256_mullo_epi16(v1, v_g_mul);
+
+         __m256i r0 = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(y0, v0_r), round_offset), YUV_SHIFT);
+         __m256i g0 = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(_mm256_adds_epi16(y0, v0_g), u0_g), round_offset), YUV_SHIFT);
+         __m256i b0 = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(y0, u0_b), round_offset), YUV_SHIFT);
+
+         __m256i r1 = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(y1, v1_r), round_offset), YUV_SHIFT);
+         __m256i g1 = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(_mm256_adds_epi16(y1, v1_g), u1_g), round_offset), YUV_SHIFT);
+         __m256i b1 = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(y1, u1_b), round_offset), YUV_SHIFT);
+
+         r0 = _mm256_packus_epi16(r0, r1);
+         g0 = _mm256_packus_epi16(g0, g1);
+         b0 = _mm256_packus_epi16(b0, b1);
+
+         __m256i res_lo_bg = _mm256_unpacklo_epi8(b0, g0);
+         __m256i res_hi_bg = _mm256_unpackhi_epi8(b0, g0);
+         __m256i res_lo_ra = _mm256_unpacklo_epi8(r0, a);
+         __m256i res_hi_ra = _mm256_unpackhi_epi8(r0, a);
+         __m256i res0 = _mm256_unpacklo_epi16(res_lo_bg, res_lo_ra);
+         __m256i res1 = _mm256_unpackhi_epi16(res_lo_bg, res_lo_ra);
+         __m256i res2 = _mm256_unpacklo_epi16(res_hi_bg, res_hi_ra);
+         __m256i res3 = _mm256_unpackhi_epi16(res_hi_bg, res_hi_ra);
+
+         _mm256_storeu_si256((__m256i*)(dst +  0), _mm256_permute2x128_si256(res0, res1, 0x20));
+         _mm256_storeu_si256((__m256i*)(dst +  8), _mm256_permute2x128_si256(res0, res1, 0x31));
+         _mm256_storeu_si256((__m256i*)(dst + 16), _mm256_permute2x128_si256(res2, res3, 0x20));
+         _mm256_storeu_si256((__m256i*)(dst + 24), _mm256_permute2x128_si256(res2, res3, 0x31));
+      }
+
+      if (w < width)
+         conv_yuyv_argb8888(dst, src, width - w, 1, out_stride, in_stride);
+   }
+}
+#endif
+
+#if defined(PIXCONV_HAVE_NEON)
+static void conv_0rgb1555_rgb565_neon(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint16_t *input = input_;
+   uint16_t *output = output_;
+
+   const uint16x8_t hi_mask   = vdupq_n_u16((0x1f << 11) | (0x1f << 6));
+   const uint16x8_t lo_mask   = vdupq_n_u16(0x1f);
+   const uint16x8_t glow_mask = vdupq_n_u16(1 << 5);
+
+   for (h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+   {
+      for (w = 0; w + 8 <= width; w += 8)
+      {
+         uint16x8_t in   = vld1q_u16(input + w);
+         uint16x8_t rg   = vandq_u16(vshlq_n_u16(in, 1), hi_mask);
+         uint16x8_t b    = vandq_u16(in, lo_mask);
+         uint16x8_t glow = vandq_u16(vshrq_n_u16(in, 4), glow_mask);
+         vst1q_u16(output + w, vorrq_u16(rg, vorrq_u16(b, glow)));
+      }
+
+      if (w < width)
+         conv_0rgb1555_rgb565(output + w, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+static inline void store_argb8888_neon(uint32_t *output,
+      uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+   uint8x8x4_t px;
+   px.val[0] = b;
+   px.val[1] = g;
+   px.val[2] = r;
+   px.val[3] = vdup_n_u8(0xff);
+   vst4_u8((uint8_t*)output, px);
+}
+
+static void conv_0rgb1555_argb8888_neon(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint16_t *input = input_;
+   uint32_t *output      = output_;
+
+   const uint8x8_t mask = vdup_n_u8(0xf8);
+
+   for (h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   {
+      for (w = 0; w + 8 <= width; w += 8)
+      {
+         uint16x8_t in = vld1q_u16(input + w);
+         // Channels end up in the top bits of each byte, and are then replicated downwards.
+         uint8x8_t r = vand_u8(vshrn_n_u16(in, 7), mask);
+         uint8x8_t g = vand_u8(vshrn_n_u16(in, 2), mask);
+         uint8x8_t b = vmovn_u16(vshlq_n_u16(in, 3));
+         store_argb8888_neon(output + w,
+               vorr_u8(r, vshr_n_u8(r, 5)),
+               vorr_u8(g, vshr_n_u8(g, 5)),
+               vorr_u8(b, vshr_n_u8(b, 5)));
+      }
+
+      if (w < width)
+         conv_0rgb1555_argb8888(output + w, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+static void conv_rgb565_argb8888_neon(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint16_t *input = input_;
+   uint32_t *output      = output_;
+
+   const uint8x8_t mask_rb = vdup_n_u8(0xf8);
+   const uint8x8_t mask_g  = vdup_n_u8(0xfc);
+
+   for (h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   {
+      for (w = 0; w + 8 <= width; w += 8)
+      {
+         uint16x8_t in = vld1q_u16(input + w);
+         uint8x8_t r = vand_u8(vshrn_n_u16(in, 8), mask_rb);
+         uint8x8_t g = vand_u8(vshrn_n_u16(in, 3), mask_g);
+         uint8x8_t b = vmovn_u16(vshlq_n_u16(in, 3));
+         store_argb8888_neon(output + w,
+               vorr_u8(r, vshr_n_u8(r, 5)),
+               vorr_u8(g, vshr_n_u8(g, 6)),
+               vorr_u8(b, vshr_n_u8(b, 5)));
+      }
+
+      if (w < width)
+         conv_rgb565_argb8888(output + w, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+static void conv_argb8888_bgr24_neon(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint32_t *input = input_;
+   uint8_t *output       = output_;
+
+   for (h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   {
+      uint8_t *out = output;
+
+      for (w = 0; w + 16 <= width; w += 16, out += 48)
+      {
+         uint8x16x4_t px = vld4q_u8((const uint8_t*)(input + w));
+         uint8x16x3_t res;
+         res.val[0] = px.val[0];
+         res.val[1] = px.val[1];
+         res.val[2] = px.val[2];
+         vst3q_u8(out, res);
+      }
+
+      if (w < width)
+         conv_argb8888_bgr24(out, input + w, width - w, 1, out_stride, in_stride);
+   }
+}
+
+static void conv_yuyv_argb8888_neon(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   int h, w;
+   const uint8_t *input = input_;
+   uint32_t *output     = output_;
+
+   const int16x8_t chroma_offset = vdupq_n_s16(128);
+   const int16x8_t round_offset  = vdupq_n_s16(YUV_OFFSET);
+
+   for (h = 0; h < height; h++, output += out_stride >> 2, input += in_stride)
+   {
+      const uint8_t *src = input;
+      uint32_t *dst = output;
+
+      // Each loop processes 16 pixels, deinterleaved into even and odd ones.
+      // Sums never leave 16-bit range, and the narrowing shift clamps like clamp_8bit().
+      for (w = 0; w + 16 <= width; w += 16, src += 32, dst += 16)
+      {
+         uint8x8x4_t yuv = vld4_u8(src); // [Y0, Y2, ...], [U0, U1, ...], [Y1, Y3, ...], [V0, V1, ...]
+         int16x8_t y0 = vmulq_n_s16(vreinterpretq_s16_u16(vmovl_u8(yuv.val[0])), YUV_MAT_Y);
+         int16x8_t y1 = vmulq_n_s16(vreinterpretq_s16_u16(vmovl_u8(yuv.val[2])), YUV_MAT_Y);
+         int16x8_t u  = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(yuv.val[1])), chroma_offset);
+         int16x8_t v  = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(yuv.val[3])), chroma_offset);
+
+         int16x8_t r = vmlaq_n_s16(round_offset, v, YUV_MAT_V_R);
+         int16x8_t g = vmlaq_n_s16(vmlaq_n_s16(round_offset, u, YUV_MAT_U_G), v, YUV_MAT_V_G);
+         int16x8_t b = vmlaq_n_s16(round_offset, u, YUV_MAT_U_B);
+
+         uint8x8x2_t r8 = vzip_u8(vqshrun_n_s16(vaddq_s16(y0, r), YUV_SHIFT),
+               vqshrun_n_s16(vaddq_s16(y1, r), YUV_SHIFT));
+         uint8x8x2_t g8 = vzip_u8(vqshrun_n_s16(vaddq_s16(y0, g), YUV_SHIFT),
+               vqshrun_n_s16(vaddq_s16(y1, g), YUV_SHIFT));
+         uint8x8x2_t b8 = vzip_u8(vqshrun_n_s16(vaddq_s16(y0, b), YUV_SHIFT),
+               vqshrun_n_s16(vaddq_s16(y1, b), YUV_SHIFT));
+
+         uint8x16x4_t px;
+         px.val[0] = vcombine_u8(b8.val[0], b8.val[1]);
+         px.val[1] = vcombine_u8(g8.val[0], g8.val[1]);
+         px.val[2] = vcombine_u8(r8.val[0], r8.val[1]);
+         px.val[3] = vdupq_n_u8(0xff);
+         vst4q_u8((uint8_t*)dst, px);
+      }
+
+      if (w < width)
+         conv_yuyv_argb8888(dst, src, width - w, 1, out_stride, in_stride);
+   }
+}
+#endif
+
+struct conv_simd_variant
+{
+   conv_func_t conv;
+   conv_func_t avx2;
+   conv_func_t neon;
+};
+
+#if defined(PIXCONV_HAVE_AVX2)
+#define CONV_AVX2(name) name##_avx2
+#else
+#define CONV_AVX2(name) NULL
+#endif
+
+#if defined(PIXCONV_HAVE_NEON)
+#define CONV_NEON(name) name##_neon
+#else
+#define CONV_NEON(name) NULL
+#endif
+
+#define CONV_VARIANT(name) { name, CONV_AVX2(name), CONV_NEON(name) }
+
+static const struct conv_simd_variant conv_simd_variants[] = {
+   CONV_VARIANT(conv_0rgb1555_rgb565),
+   CONV_VARIANT(conv_0rgb1555_argb8888),
+   CONV_VARIANT(conv_rgb565_argb8888),
+   CONV_VARIANT(conv_argb8888_bgr24),
+   CONV_VARIANT(conv_yuyv_argb8888),
+};
+
+conv_func_t conv_simd(conv_func_t conv, uint64_t simd)
+{
+   unsigned i;
+   for (i = 0; i < sizeof(conv_simd_variants) / sizeof(conv_simd_variants[0]); i++)
+   {
+      const struct conv_simd_variant *variant = &conv_simd_variants[i];
+      if (variant->conv != conv)
+         continue;
+
+      // AVX2 is only usable if the OS saves the AVX state as well.
+      if (variant->avx2 && (simd & (RETRO_SIMD_AVX | RETRO_SIMD_AVX2)) == (RETRO_SIMD_AVX | RETRO_SIMD_AVX2))
+         return variant->avx2;
+      if (variant->neon && (simd & RETRO_SIMD_NEON))
+         return variant->neon;
+      break;
+   }
+
+   return conv;
+}
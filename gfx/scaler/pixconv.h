@@ -74,5 +74,13 @@ void conv_copy(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride);
 
+typedef void (*conv_func_t)(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride);
+
+// Returns the fastest variant of conv which runs on a CPU with the given
+// RETRO_SIMD_* features, or conv itself if it has none.
+conv_func_t conv_simd(conv_func_t conv, uint64_t simd);
+
 #endif
 
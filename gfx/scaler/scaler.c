@@ -24,6 +24,10 @@
 #include "../../libretro.h"
 #include "../../performance.h"
 
+#ifdef HAVE_THREADS
+#include "../../thread.h"
+#endif
+
 // In case aligned allocs are needed later ...
 void *scaler_alloc(size_t elem_size, size_t size)
 {
@@ -35,32 +39,74 @@ void scaler_free(void *ptr)
    free(ptr);
 }
 
+// Input rows the window of horizontally scaled rows holds on top of what the vertical filter
+// needs for a single output row. The window is moved back to the top of its buffer
+// once it runs full, so this trades a memmove now and then for memory.
+#define SCALER_WINDOW_SLACK 16
+
+// Slices are not made smaller than this many output rows, as waking up threads
+// costs more than scaling a few rows.
+#define SCALER_MIN_SLICE_ROWS 16
+
+// Rows a slice of the output is scaled through. Slice 0 uses the buffers in scaler_ctx.
+struct scaler_scratch
+{
+   uint64_t *scaled;
+   uint32_t *input;
+   uint32_t *output;
+};
+
+static bool allocate_scratch(const struct scaler_ctx *ctx, struct scaler_scratch *scratch)
+{
+   // The generic path converts a window of input rows at a time, the special path a single row.
+   int in_rows = ctx->scaler_special ? 1 : ctx->scaled.height;
+
+   if (ctx->scaled.stride)
+      scratch->scaled = scaler_alloc(sizeof(uint64_t), (ctx->scaled.stride * ctx->scaled.height) >> 3);
+   if (ctx->input.stride)
+      scratch->input = scaler_alloc(sizeof(uint32_t), (ctx->input.stride * in_rows) >> 2);
+   if (ctx->output.stride)
+      scratch->output = scaler_alloc(sizeof(uint32_t), ctx->output.stride >> 2);
+
+   return (!ctx->scaled.stride || scratch->scaled) &&
+      (!ctx->input.stride || scratch->input) &&
+      (!ctx->output.stride || scratch->output);
+}
+
+static void free_scratch(struct scaler_scratch *scratch)
+{
+   scaler_free(scratch->scaled);
+   scaler_free(scratch->input);
+   scaler_free(scratch->output);
+   memset(scratch, 0, sizeof(*scratch));
+}
+
 static bool allocate_frames(struct scaler_ctx *ctx)
 {
-   ctx->scaled.stride = ((ctx->out_width + 7) & ~7) * sizeof(uint64_t);
-   ctx->scaled.width  = ctx->out_width;
-   ctx->scaled.height = ctx->in_height;
-   ctx->scaled.frame  = scaler_alloc(sizeof(uint64_t), (ctx->scaled.stride * ctx->scaled.height) >> 3);
-   if (!ctx->scaled.frame)
-      return false;
+   struct scaler_scratch scratch = {0};
+   bool ret;
 
-   if (ctx->in_fmt != SCALER_FMT_ARGB8888)
+   if (ctx->unscaled)
+      return true;
+
+   if (!ctx->scaler_special)
    {
-      ctx->input.stride = ((ctx->in_width + 7) & ~7) * sizeof(uint32_t);
-      ctx->input.frame = scaler_alloc(sizeof(uint32_t), (ctx->input.stride * ctx->in_height) >> 2);
-      if (!ctx->input.frame)
-         return false;
+      ctx->scaled.stride = ((ctx->out_width + 7) & ~7) * sizeof(uint64_t);
+      ctx->scaled.width  = ctx->out_width;
+      ctx->scaled.height = ctx->vert.filter_len + SCALER_WINDOW_SLACK;
    }
 
+   if (ctx->in_fmt != SCALER_FMT_ARGB8888)
+      ctx->input.stride = ((ctx->in_width + 7) & ~7) * sizeof(uint32_t);
+
    if (ctx->out_fmt != SCALER_FMT_ARGB8888)
-   {
       ctx->output.stride = ((ctx->out_width + 7) & ~7) * sizeof(uint32_t);
-      ctx->output.frame  = scaler_alloc(sizeof(uint32_t), (ctx->output.stride * ctx->out_height) >> 2);
-      if (!ctx->output.frame)
-         return false;
-   }
 
-   return true;
+   ret = allocate_scratch(ctx, &scratch);
+   ctx->scaled.frame = scratch.scaled;
+   ctx->input.frame  = scratch.input;
+   ctx->output.frame = scratch.output;
+   return ret;
 }
 
 static bool set_direct_pix_conv(struct scaler_ctx *ctx)
@@ -144,8 +190,114 @@ static bool set_pix_conv(struct scaler_ctx *ctx)
    return true;
 }
 
+static void scaler_ctx_scale_slice(const struct scaler_ctx *ctx,
+      const struct scaler_scratch *scratch,
+      void *output, const void *input, int first, int last);
+
+#ifdef HAVE_THREADS
+// Slices run as jobs on a thread pool. Slice 0 uses the scratch buffers in scaler_ctx,
+// the slices after it have scratch buffers of their own.
+struct scaler_pool
+{
+   const struct scaler_ctx *ctx;
+   sthread_pool_t *threads;
+   struct scaler_scratch *scratch;
+   unsigned num_workers;
+
+   // Frame currently worked on.
+   const struct scaler_scratch *first_scratch;
+   void *output;
+   const void *input;
+   unsigned slices;
+};
+
+static void scaler_pool_job(void *data, unsigned index)
+{
+   struct scaler_pool *pool = data;
+   const struct scaler_scratch *scratch = index ? &pool->scratch[index - 1] : pool->first_scratch;
+   int height = pool->ctx->out_height;
+
+   scaler_ctx_scale_slice(pool->ctx, scratch, pool->output, pool->input,
+         (height * index) / pool->slices,
+         (height * (index + 1)) / pool->slices);
+}
+
+static void scaler_pool_free(struct scaler_pool *pool)
+{
+   unsigned i;
+
+   if (!pool)
+      return;
+
+   sthread_pool_free(pool->threads);
+   if (pool->scratch)
+   {
+      for (i = 0; i < pool->num_workers; i++)
+         free_scratch(&pool->scratch[i]);
+   }
+   free(pool->scratch);
+   free(pool);
+}
+
+static struct scaler_pool *scaler_pool_new(const struct scaler_ctx *ctx, unsigned workers)
+{
+   unsigned i;
+   struct scaler_pool *pool = calloc(1, sizeof(*pool));
+   if (!pool)
+      return NULL;
+
+   pool->ctx = ctx;
+   pool->num_workers = workers;
+   pool->scratch = calloc(workers, sizeof(*pool->scratch));
+   if (!pool->scratch)
+      goto error;
+
+   for (i = 0; i < workers; i++)
+   {
+      if (!allocate_scratch(ctx, &pool->scratch[i]))
+         goto error;
+   }
+
+   pool->threads = sthread_pool_new(workers, false);
+   if (!pool->threads)
+      goto error;
+
+   return pool;
+
+error:
+   scaler_pool_free(pool);
+   return NULL;
+}
+
+static void scaler_pool_run(struct scaler_pool *pool, const struct scaler_scratch *scratch,
+      void *output, const void *input, unsigned slices)
+{
+   pool->first_scratch = scratch;
+   pool->output = output;
+   pool->input = input;
+   pool->slices = slices;
+   sthread_pool_run(pool->threads, scaler_pool_job, pool, slices);
+}
+#endif
+
+// rarch_get_cpu_features() logs on every call, and filters are regenerated on every size change.
+static uint64_t scaler_simd_features(void)
+{
+   static bool probed;
+   static uint64_t simd;
+
+   if (!probed)
+   {
+      simd = rarch_get_cpu_features();
+      probed = true;
+   }
+   return simd;
+}
+
 bool scaler_ctx_gen_filter(struct scaler_ctx *ctx)
 {
+   uint64_t simd;
+
    scaler_ctx_gen_reset(ctx);
 
    if (ctx->in_width == ctx->out_width && ctx->in_height == ctx->out_height)
@@ -159,9 +311,6 @@ bool scaler_ctx_gen_filter(struct scaler_ctx *ctx)
 
    ctx->scaler_special = NULL;
 
-   if (!allocate_frames(ctx))
-      return false;
-
    if (ctx->unscaled)
    {
       if (!set_direct_pix_conv(ctx))
@@ -173,14 +322,35 @@ bool scaler_ctx_gen_filter(struct scaler_ctx *ctx)
          return false;
    }
 
+   // Conversions are picked for the CPU we run on, not the one the build targets.
+   simd = scaler_simd_features();
+   ctx->in_pixconv     = conv_simd(ctx->in_pixconv, simd);
+   ctx->out_pixconv    = conv_simd(ctx->out_pixconv, simd);
+   ctx->direct_pixconv = conv_simd(ctx->direct_pixconv, simd);
+
    if (!ctx->unscaled && !scaler_gen_filter(ctx))
       return false;
 
+   // Buffer sizes depend on the filter.
+   if (!allocate_frames(ctx))
+      return false;
+
+#ifdef HAVE_THREADS
+   // Without the pool, everything runs on the calling thread.
+   if (ctx->threads > 1)
+      ctx->pool = scaler_pool_new(ctx, ctx->threads - 1);
+#endif
+
    return true;
 }
 
 void scaler_ctx_gen_reset(struct scaler_ctx *ctx)
 {
+#ifdef HAVE_THREADS
+   scaler_pool_free(ctx->pool);
+   ctx->pool = NULL;
+#endif
+
    scaler_free(ctx->horiz.filter);
    scaler_free(ctx->horiz.filter_pos);
    scaler_free(ctx->vert.filter);
@@ -196,75 +366,159 @@ void scaler_ctx_gen_reset(struct scaler_ctx *ctx)
    memset(&ctx->output, 0, sizeof(ctx->output));
 }
 
-void scaler_ctx_scale(struct scaler_ctx *ctx,
-      void *output, const void *input)
+// Generic path for output rows [first, last). Rather than converting and horizontally scaling
+// the whole input up front, input rows are processed as the vertical filter gets to them,
+// into a small window which stays in cache. Rows no output row needs are skipped altogether.
+static void scaler_ctx_scale_rows(const struct scaler_ctx *ctx,
+      const struct scaler_scratch *scratch,
+      void *output, const void *input, int first, int last)
 {
-   if (ctx->unscaled) // Just perform straight pixel conversion.
-   {
-      ctx->direct_pixconv(output, input,
-            ctx->out_width, ctx->out_height,
-            ctx->out_stride, ctx->in_stride);
-   }
-   else if (ctx->scaler_special) // Take some special, and (hopefully) more optimized path.
+   int h;
+   const int window_stride = ctx->scaled.stride >> 3;
+   int window_first = 0, window_end = 0; // Input rows in the window, starting at the top.
+   uint8_t *out = (uint8_t*)output + first * ctx->out_stride;
+
+   for (h = first; h < last; h++, out += ctx->out_stride)
    {
-      const void *inp = input;
-      int in_stride   = ctx->in_stride;
+      int row_first = ctx->vert.filter_pos[h];
+      int row_end   = row_first + ctx->vert.filter_len;
 
-      if (ctx->in_fmt != SCALER_FMT_ARGB8888)
+      if (row_first < window_first)
+         window_first = window_end = row_first;
+      else if (row_end - window_first > ctx->scaled.height)
       {
-         ctx->in_pixconv(ctx->input.frame, input,
-               ctx->in_width, ctx->in_height,
-               ctx->input.stride, ctx->in_stride);
-
-         inp       = ctx->input.frame;
-         in_stride = ctx->input.stride;
+         // Move rows which are still needed back to the top.
+         if (row_first < window_end)
+            memmove(scratch->scaled, scratch->scaled + (row_first - window_first) * window_stride,
+                  (window_end - row_first) * ctx->scaled.stride);
+         else
+            window_end = row_first;
+         window_first = row_first;
       }
 
-      bool conv_out  = ctx->out_fmt != SCALER_FMT_ARGB8888;
-      void *outp     = output;
-      int out_stride = ctx->out_stride;
-
-      if (conv_out)
+      if (window_end < row_end)
       {
-         outp       = ctx->output.frame;
-         out_stride = ctx->output.stride;
+         int rows = row_end - window_end;
+         const uint8_t *in = (const uint8_t*)input + window_end * ctx->in_stride;
+         uint64_t *scaled = scratch->scaled + (window_end - window_first) * window_stride;
+
+         if (ctx->in_fmt != SCALER_FMT_ARGB8888)
+         {
+            ctx->in_pixconv(scratch->input, in,
+                  ctx->in_width, rows,
+                  ctx->input.stride, ctx->in_stride);
+
+            ctx->scaler_horiz(ctx, scaled, scratch->input, ctx->input.stride, rows);
+         }
+         else
+            ctx->scaler_horiz(ctx, scaled, in, ctx->in_stride, rows);
+
+         window_end = row_end;
       }
 
-      ctx->scaler_special(ctx, outp, inp,
-            ctx->out_width, ctx->out_height,
-            ctx->in_width, ctx->in_height,
-            out_stride, in_stride);
-
-      if (conv_out)
+      if (ctx->out_fmt != SCALER_FMT_ARGB8888)
       {
-         ctx->out_pixconv(output, ctx->output.frame,
-               ctx->out_width, ctx->out_height,
+         ctx->scaler_vert(ctx, scratch->output, ctx->output.stride,
+               scratch->scaled, window_first, h, 1);
+
+         ctx->out_pixconv(out, scratch->output,
+               ctx->out_width, 1,
                ctx->out_stride, ctx->output.stride);
       }
+      else
+         ctx->scaler_vert(ctx, out, ctx->out_stride,
+               scratch->scaled, window_first, h, 1);
    }
-   else // Take generic filter path.
+}
+
+// Special path for output rows [first, last), which is point sampling.
+// Only the input rows which get sampled are converted, a single row at a time.
+static void scaler_ctx_special_rows(const struct scaler_ctx *ctx,
+      const struct scaler_scratch *scratch,
+      void *output, const void *input, int first, int last)
+{
+   int h, y_pos, y_step;
+   int converted = -1;
+   uint8_t *out = (uint8_t*)output + first * ctx->out_stride;
+
+   scaler_point_step(ctx->in_height, ctx->out_height, &y_pos, &y_step);
+   y_pos += first * y_step;
+
+   for (h = first; h < last; h++, y_pos += y_step, out += ctx->out_stride)
    {
+      int y = y_pos >> 16;
+      const void *in = (const uint8_t*)input + y * ctx->in_stride;
+      int in_stride  = ctx->in_stride;
+
       if (ctx->in_fmt != SCALER_FMT_ARGB8888)
       {
-         ctx->in_pixconv(ctx->input.frame, input,
-               ctx->in_width, ctx->in_height,
-               ctx->input.stride, ctx->in_stride);
-
-         ctx->scaler_horiz(ctx, ctx->input.frame, ctx->input.stride);
+         if (y != converted)
+         {
+            ctx->in_pixconv(scratch->input, in,
+                  ctx->in_width, 1,
+                  ctx->input.stride, ctx->in_stride);
+            converted = y;
+         }
+
+         in        = scratch->input;
+         in_stride = ctx->input.stride;
       }
-      else
-         ctx->scaler_horiz(ctx, input, ctx->in_stride);
 
       if (ctx->out_fmt != SCALER_FMT_ARGB8888)
       {
-         ctx->scaler_vert(ctx, ctx->output.frame, ctx->output.stride);
+         ctx->scaler_special(ctx, scratch->output, in,
+               ctx->out_width, 1,
+               ctx->in_width, 1,
+               ctx->output.stride, in_stride);
 
-         ctx->out_pixconv(output, ctx->output.frame,
-               ctx->out_width, ctx->out_height,
+         ctx->out_pixconv(out, scratch->output,
+               ctx->out_width, 1,
                ctx->out_stride, ctx->output.stride);
       }
       else
-         ctx->scaler_vert(ctx, output, ctx->out_stride);
+         ctx->scaler_special(ctx, out, in,
+               ctx->out_width, 1,
+               ctx->in_width, 1,
+               ctx->out_stride, in_stride);
    }
 }
 
+static void scaler_ctx_scale_slice(const struct scaler_ctx *ctx,
+      const struct scaler_scratch *scratch,
+      void *output, const void *input, int first, int last)
+{
+   if (ctx->unscaled) // Just perform straight pixel conversion.
+   {
+      ctx->direct_pixconv((uint8_t*)output + first * ctx->out_stride,
+            (const uint8_t*)input + first * ctx->in_stride,
+            ctx->out_width, last - first,
+            ctx->out_stride, ctx->in_stride);
+   }
+   else if (ctx->scaler_special) // Take some special, and (hopefully) more optimized path.
+      scaler_ctx_special_rows(ctx, scratch, output, input, first, last);
+   else // Take generic filter path.
+      scaler_ctx_scale_rows(ctx, scratch, output, input, first, last);
+}
+
+void scaler_ctx_scale(struct scaler_ctx *ctx,
+      void *output, const void *input)
+{
+   struct scaler_scratch scratch = { ctx->scaled.frame, ctx->input.frame, ctx->output.frame };
+
+#ifdef HAVE_THREADS
+   if (ctx->pool)
+   {
+      unsigned slices = ctx->out_height / SCALER_MIN_SLICE_ROWS;
+      if (slices > ctx->pool->num_workers + 1)
+         slices = ctx->pool->num_workers + 1;
+
+      if (slices > 1)
+      {
+         scaler_pool_run(ctx->pool, &scratch, output, input, slices);
+         return;
+      }
+   }
+#endif
+
+   scaler_ctx_scale_slice(ctx, &scratch, output, input, 0, ctx->out_height);
+}
@@ -50,6 +50,8 @@ struct scaler_filter
    int *filter_pos;
 };
 
+struct scaler_pool;
+
 struct scaler_ctx
 {
    int in_width;
@@ -65,9 +67,9 @@ struct scaler_ctx
    enum scaler_type scaler_type;
 
    void (*scaler_horiz)(const struct scaler_ctx*,
-         const void*, int);
+         uint64_t*, const void*, int, int);
    void (*scaler_vert)(const struct scaler_ctx*,
-         void*, int);
+         void*, int, const uint64_t*, int, int, int);
    void (*scaler_special)(const struct scaler_ctx*,
          void*, const void*, int, int, int, int, int, int);
 
@@ -84,6 +86,8 @@ struct scaler_ctx
       int stride;
    } input;
 
+   // Window of horizontally scaled input rows the vertical filter works on.
+   // height is the number of rows it holds, not the full input height.
    struct
    {
       uint64_t *frame;
@@ -97,6 +101,12 @@ struct scaler_ctx
       uint32_t *frame;
       int stride;
    } output;
+
+   // Splits scaling into slices of output rows, which run on this many threads
+   // including the calling one. 0 or 1 scales on the calling thread only.
+   // Read by scaler_ctx_gen_filter().
+   unsigned threads;
+   struct scaler_pool *pool;
 };
 
 bool scaler_ctx_gen_filter(struct scaler_ctx *ctx);
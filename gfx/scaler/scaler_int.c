@@ -41,17 +41,17 @@
 // The C version of scalers perform the exact same operations as the SIMD code for testing purposes.
 
 #if defined(__SSE2__)
-void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output_, int stride)
+void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output_, int stride,
+      const uint64_t *input, int input_row, int first, int rows)
 {
    int h, w, y;
-   const uint64_t *input = ctx->scaled.frame;
    uint32_t *output = output_;
 
-   const int16_t *filter_vert = ctx->vert.filter;
+   const int16_t *filter_vert = ctx->vert.filter + first * ctx->vert.filter_stride;
 
-   for (h = 0; h < ctx->out_height; h++, filter_vert += ctx->vert.filter_stride, output += stride >> 2)
+   for (h = first; h < first + rows; h++, filter_vert += ctx->vert.filter_stride, output += stride >> 2)
    {
-      const uint64_t *input_base = input + ctx->vert.filter_pos[h] * (ctx->scaled.stride >> 3);
+      const uint64_t *input_base = input + (ctx->vert.filter_pos[h] - input_row) * (ctx->scaled.stride >> 3);
 
       for (w = 0; w < ctx->out_width; w++)
       {
@@ -85,17 +85,17 @@ void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output_, int strid
    }
 }
 #else
-void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output_, int stride)
+void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output_, int stride,
+      const uint64_t *input, int input_row, int first, int rows)
 {
    int h, w, y;
-   const uint64_t *input = ctx->scaled.frame;
    uint32_t *output = output_;
 
-   const int16_t *filter_vert = ctx->vert.filter;
+   const int16_t *filter_vert = ctx->vert.filter + first * ctx->vert.filter_stride;
 
-   for (h = 0; h < ctx->out_height; h++, filter_vert += ctx->vert.filter_stride, output += stride >> 2)
+   for (h = first; h < first + rows; h++, filter_vert += ctx->vert.filter_stride, output += stride >> 2)
    {
-      const uint64_t *input_base = input + ctx->vert.filter_pos[h] * (ctx->scaled.stride >> 3);
+      const uint64_t *input_base = input + (ctx->vert.filter_pos[h] - input_row) * (ctx->scaled.stride >> 3);
 
       for (w = 0; w < ctx->out_width; w++)
       {
@@ -134,13 +134,13 @@ void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output_, int strid
 #endif
 
 #if defined(__SSE2__)
-void scaler_argb8888_horiz(const struct scaler_ctx *ctx, const void *input_, int stride)
+void scaler_argb8888_horiz(const struct scaler_ctx *ctx, uint64_t *output,
+      const void *input_, int stride, int rows)
 {
    int h, w, x;
    const uint32_t *input = input_;
-   uint64_t *output      = ctx->scaled.frame;
 
-   for (h = 0; h < ctx->scaled.height; h++, input += stride >> 2, output += ctx->scaled.stride >> 3)
+   for (h = 0; h < rows; h++, input += stride >> 2, output += ctx->scaled.stride >> 3)
    {
       const int16_t *filter_horiz = ctx->horiz.filter;
 
@@ -193,13 +193,13 @@ static inline uint64_t build_argb64(uint16_t a, uint16_t r, uint16_t g, uint16_t
    return ((uint64_t)a << 48) | ((uint64_t)r << 32) | ((uint64_t)g << 16) | ((uint64_t)b << 0);
 }
 
-void scaler_argb8888_horiz(const struct scaler_ctx *ctx, const void *input_, int stride)
+void scaler_argb8888_horiz(const struct scaler_ctx *ctx, uint64_t *output,
+      const void *input_, int stride, int rows)
 {
    int h, w, x;
    const uint32_t *input = input_;
-   uint64_t *output      = ctx->scaled.frame;
 
-   for (h = 0; h < ctx->scaled.height; h++, input += stride >> 2, output += ctx->scaled.stride >> 3)
+   for (h = 0; h < rows; h++, input += stride >> 2, output += ctx->scaled.stride >> 3)
    {
       const int16_t *filter_horiz = ctx->horiz.filter;
 
@@ -242,16 +242,10 @@ void scaler_argb8888_point_special(const struct scaler_ctx *ctx,
       int out_stride, int in_stride)
 {
    int h, w;
+   int x_pos, x_step, y_pos, y_step;
    (void)ctx;
-   int x_pos  = (1 << 15) * in_width / out_width - (1 << 15);
-   int x_step = (1 << 16) * in_width / out_width;
-   int y_pos  = (1 << 15) * in_height / out_height - (1 << 15);
-   int y_step = (1 << 16) * in_height / out_height;
-
-   if (x_pos < 0)
-      x_pos = 0;
-   if (y_pos < 0)
-      y_pos = 0;
+   scaler_point_step(in_width, out_width, &x_pos, &x_step);
+   scaler_point_step(in_height, out_height, &y_pos, &y_step);
 
    const uint32_t *input = input_;
    uint32_t *output = output_;
@@ -18,8 +18,23 @@
 
 #include "scaler.h"
 
-void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output, int stride);
-void scaler_argb8888_horiz(const struct scaler_ctx *ctx, const void *input, int stride);
+// Vertically scales output rows [first, first + rows). input holds horizontally scaled rows,
+// starting with input row input_row.
+void scaler_argb8888_vert(const struct scaler_ctx *ctx, void *output, int stride,
+      const uint64_t *input, int input_row, int first, int rows);
+
+// Horizontally scales rows of input into output, which has a stride of scaled.stride.
+void scaler_argb8888_horiz(const struct scaler_ctx *ctx, uint64_t *output,
+      const void *input, int stride, int rows);
+
+// Fixed point position of the first sample, and step between samples, of point sampling.
+static inline void scaler_point_step(int in_len, int out_len, int *pos, int *step)
+{
+   *pos  = (1 << 15) * in_len / out_len - (1 << 15);
+   *step = (1 << 16) * in_len / out_len;
+   if (*pos < 0)
+      *pos = 0;
+}
 
 void scaler_argb8888_point_special(const struct scaler_ctx *ctx,
       void *output, const void *input,
@@ -0,0 +1,324 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Pixel conversion throughput and conformance harness.
+// Every conversion of pixconv.c is run on random frames, once for the baseline
+// implementation and once for every SIMD variant conv_simd() picks on this CPU.
+// Built with SCALER_NO_SIMD, only the C implementations are run.
+//
+// Throughput is written to stdout as CSV, one line per conversion/implementation/frame.
+// With --update, checksums of the output are written to a file,
+// and with --check, output of every implementation is compared against them.
+
+#include "../pixconv.h"
+#include "../../../libretro.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_IMPLS 4
+#define BENCH_MAX_CHECKSUMS 256
+
+// Minimum wall time spent on each throughput measurement.
+#define BENCH_MIN_SECONDS 0.2
+
+struct bench_conv
+{
+   const char *name;
+   conv_func_t conv;
+   unsigned in_bpp;
+   unsigned out_bpp;
+};
+
+struct bench_impl
+{
+   const char *name;
+   uint64_t simd;
+};
+
+struct bench_size
+{
+   const char *name;
+   int width;
+   int height;
+};
+
+struct bench_checksum
+{
+   char key[128];
+   uint64_t hash;
+};
+
+static const struct bench_conv bench_convs[] = {
+   { "0rgb1555_argb8888", conv_0rgb1555_argb8888, 2, 4 },
+   { "0rgb1555_rgb565",   conv_0rgb1555_rgb565,   2, 2 },
+   { "rgb565_0rgb1555",   conv_rgb565_0rgb1555,   2, 2 },
+   { "rgb565_argb8888",   conv_rgb565_argb8888,   2, 4 },
+   { "rgba4444_argb8888", conv_rgba4444_argb8888, 2, 4 },
+   { "bgr24_argb8888",    conv_bgr24_argb8888,    3, 4 },
+   { "argb8888_0rgb1555", conv_argb8888_0rgb1555, 4, 2 },
+   { "argb8888_bgr24",    conv_argb8888_bgr24,    4, 3 },
+   { "argb8888_abgr8888", conv_argb8888_abgr8888, 4, 4 },
+   { "0rgb1555_bgr24",    conv_0rgb1555_bgr24,    2, 3 },
+   { "rgb565_bgr24",      conv_rgb565_bgr24,      2, 3 },
+   { "yuyv_argb8888",     conv_yuyv_argb8888,     2, 4 },
+};
+
+// The odd size leaves columns which do not fill a vector. YUYV needs an even width.
+static const struct bench_size bench_sizes[] = {
+   { "1080p", 1920, 1080 },
+   { "240p",   320,  240 },
+   { "odd",    318,   61 },
+};
+
+static struct bench_checksum bench_checksums[BENCH_MAX_CHECKSUMS];
+static unsigned bench_num_checksums;
+
+static double bench_time(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1000000000.0;
+}
+
+static uint32_t bench_rand(uint32_t *state)
+{
+   *state = *state * 1664525u + 1013904223u;
+   return *state >> 8;
+}
+
+static uint64_t bench_hash(uint64_t hash, const uint8_t *data, size_t size)
+{
+   // FNV-1a.
+   for (size_t i = 0; i < size; i++)
+   {
+      hash ^= data[i];
+      hash *= 0x100000001b3ull;
+   }
+   return hash;
+}
+
+// Implementations to run, the baseline one first.
+static unsigned bench_get_impls(struct bench_impl *impls)
+{
+   unsigned num = 0;
+
+#if defined(SCALER_NO_SIMD)
+   impls[num].name = "c";
+#elif defined(__SSE2__)
+   impls[num].name = "sse2";
+#else
+   impls[num].name = "c";
+#endif
+   impls[num++].simd = 0;
+
+#if !defined(SCALER_NO_SIMD)
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+   {
+      impls[num].name = "avx2";
+      impls[num++].simd = RETRO_SIMD_AVX | RETRO_SIMD_AVX2;
+   }
+#elif defined(__ARM_NEON__)
+   impls[num].name = "neon";
+   impls[num++].simd = RETRO_SIMD_NEON;
+#endif
+#endif
+
+   return num;
+}
+
+static bool bench_load_checksums(const char *path)
+{
+   char line[256];
+   FILE *file = fopen(path, "r");
+   if (!file)
+      return false;
+
+   while (fgets(line, sizeof(line), file) && bench_num_checksums < BENCH_MAX_CHECKSUMS)
+   {
+      struct bench_checksum *sum = &bench_checksums[bench_num_checksums];
+      unsigned long long hash;
+      if (line[0] == '#' || sscanf(line, "%127s %llx", sum->key, &hash) != 2)
+         continue;
+      sum->hash = hash;
+      bench_num_checksums++;
+   }
+
+   fclose(file);
+   return true;
+}
+
+static const struct bench_checksum *bench_find_checksum(const char *key)
+{
+   unsigned i;
+   for (i = 0; i < bench_num_checksums; i++)
+      if (strcmp(bench_checksums[i].key, key) == 0)
+         return &bench_checksums[i];
+   return NULL;
+}
+
+// Runs one conversion. Returns false if its output does not match the checksum file.
+static bool bench_run(const struct bench_conv *conv, const struct bench_impl *impl,
+      const struct bench_size *size, const uint8_t *input, uint8_t *output,
+      double seconds, bool check, FILE *update)
+{
+   conv_func_t func = conv_simd(conv->conv, impl->simd);
+   int in_stride = size->width * conv->in_bpp;
+   int out_stride = size->width * conv->out_bpp;
+   uint64_t hash = 0xcbf29ce484222325ull;
+   unsigned iterations = 0;
+   double start, elapsed;
+   char key[128];
+   bool ok = true;
+   int y;
+
+   // Variants which are not there would just measure the baseline again.
+   if (impl->simd && func == conv->conv)
+      return true;
+
+   memset(output, 0, out_stride * size->height);
+   func(output, input, size->width, size->height, out_stride, in_stride);
+
+   for (y = 0; y < size->height; y++)
+      hash = bench_hash(hash, output + y * out_stride, out_stride);
+
+   snprintf(key, sizeof(key), "%s-%s", conv->name, size->name);
+   if (update)
+      fprintf(update, "%s %016llx\n", key, (unsigned long long)hash);
+
+   if (check)
+   {
+      const struct bench_checksum *sum = bench_find_checksum(key);
+      if (!sum)
+         fprintf(stderr, "No checksum for %s.\n", key);
+      else if (sum->hash != hash)
+      {
+         fprintf(stderr, "FAILED: %s (%s)\n", key, impl->name);
+         ok = false;
+      }
+   }
+
+   if (seconds <= 0.0)
+      return ok;
+
+   start = bench_time();
+   do
+   {
+      func(output, input, size->width, size->height, out_stride, in_stride);
+      iterations++;
+      elapsed = bench_time() - start;
+   } while (elapsed < seconds);
+
+   printf("%s,%s,%s,%d,%d,%.1f\n", conv->name, impl->name, size->name,
+         size->width, size->height,
+         (double)size->width * size->height * iterations / elapsed / 1000000.0);
+   fflush(stdout);
+   return ok;
+}
+
+static void bench_usage(const char *argv0)
+{
+   fprintf(stderr, "Usage: %s [options]\n", argv0);
+   fprintf(stderr, "   --seconds <s>     Time spent per measurement. 0 disables benchmarking.\n");
+   fprintf(stderr, "   --check <file>    Compare output to checksums in file.\n");
+   fprintf(stderr, "   --update <file>   Write checksums of the baseline implementations to file.\n");
+   fprintf(stderr, "   --header          Print CSV header and exit.\n");
+}
+
+int main(int argc, char *argv[])
+{
+   struct bench_impl impls[BENCH_MAX_IMPLS];
+   double seconds = BENCH_MIN_SECONDS;
+   const char *check = NULL;
+   FILE *update = NULL;
+   unsigned num_impls, failures = 0;
+   uint8_t *input, *output;
+   uint32_t seed = 1;
+   size_t max_size;
+   unsigned c, i, s;
+   int j;
+
+   for (j = 1; j < argc; j++)
+   {
+      bool has_arg = j + 1 < argc;
+
+      if (strcmp(argv[j], "--header") == 0)
+      {
+         printf("conversion,impl,frame,width,height,mpix_per_sec\n");
+         return 0;
+      }
+      else if (strcmp(argv[j], "--seconds") == 0 && has_arg)
+         seconds = strtod(argv[++j], NULL);
+      else if (strcmp(argv[j], "--check") == 0 && has_arg)
+         check = argv[++j];
+      else if (strcmp(argv[j], "--update") == 0 && has_arg)
+      {
+         update = fopen(argv[++j], "w");
+         if (!update)
+         {
+            fprintf(stderr, "Failed to open %s.\n", argv[j]);
+            return 1;
+         }
+         fprintf(update, "# Generated by pixconv-bench --update. <conversion>-<frame> <FNV-1a>\n");
+      }
+      else
+      {
+         bench_usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if (check && !bench_load_checksums(check))
+   {
+      fprintf(stderr, "Failed to load checksums from %s.\n", check);
+      return 1;
+   }
+
+   // Every conversion reads and writes at most 4 bytes per pixel.
+   max_size = 1920 * 1080 * 4;
+   input = malloc(max_size);
+   output = malloc(max_size);
+   if (!input || !output)
+      return 1;
+
+   // Random data, so that every code path of the conversions is hit,
+   // including clamping in YUV conversion.
+   for (i = 0; i < max_size; i++)
+      input[i] = bench_rand(&seed);
+
+   num_impls = bench_get_impls(impls);
+
+   for (c = 0; c < sizeof(bench_convs) / sizeof(bench_convs[0]); c++)
+      for (i = 0; i < num_impls; i++)
+         for (s = 0; s < sizeof(bench_sizes) / sizeof(bench_sizes[0]); s++)
+         {
+            if (!bench_run(&bench_convs[c], &impls[i], &bench_sizes[s],
+                     input, output, seconds, check != NULL, i == 0 ? update : NULL))
+               failures++;
+         }
+
+   if (update)
+      fclose(update);
+   free(input);
+   free(output);
+
+   if (check)
+      fprintf(stderr, "%u conformance failure(s).\n", failures);
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Dirty row hash conformance harness.
+// Rows are changed in ways a core plausibly changes them (small deltas which cancel out
+// in sums, swapped pixels, single bit flips), and every change must change the hash.
+// Failures go to stderr. A digest of hashes over rows of every size up to a few blocks
+// goes to stdout, so that the output of the SIMD and C builds can be compared.
+
+#include "../dirty_rows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_ROW 1024
+
+struct test_row
+{
+   const char *name;
+   unsigned width;
+   unsigned bpp;
+};
+
+static const struct test_row test_rows[] = {
+   { "xrgb8888_256", 256, 4 },
+   { "rgb565_320",   320, 2 },
+   { "bgr24_255",    255, 3 },
+};
+
+static unsigned test_failures;
+
+static uint32_t test_rand(uint32_t *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed >> 8;
+}
+
+// Fills a row with one of a few kinds of content. Flat rows are the common case.
+static void test_fill(uint8_t *row, size_t size, unsigned kind)
+{
+   uint32_t seed = 1;
+   size_t i;
+
+   for (i = 0; i < size; i++)
+   {
+      switch (kind)
+      {
+         case 0:
+            row[i] = 0;
+            break;
+         case 1:
+            row[i] = 0x80;
+            break;
+         case 2:
+            row[i] = i;
+            break;
+         default:
+            row[i] = test_rand(&seed);
+            break;
+      }
+   }
+}
+
+static void test_expect_change(const struct test_row *test, unsigned kind,
+      const uint8_t *row, const uint8_t *changed, size_t size, const char *what)
+{
+   if (rarch_dirty_rows_hash(row, size) != rarch_dirty_rows_hash(changed, size))
+      return;
+
+   fprintf(stderr, "%s, content %u: hash unchanged after %s.\n", test->name, kind, what);
+   test_failures++;
+}
+
+static void test_add(uint8_t *row, unsigned bpp, unsigned pixel, int delta)
+{
+   uint32_t value = 0;
+   memcpy(&value, row + pixel * bpp, bpp);
+   value += delta;
+   memcpy(row + pixel * bpp, &value, bpp);
+}
+
+// +1, -2, +1 on pixels 'stride' apart, and other combinations which cancel out.
+static void test_deltas(const struct test_row *test, unsigned kind, const uint8_t *row, size_t size)
+{
+   static const int deltas[][3] = {
+      {  1, -2,  1 },
+      { -1,  2, -1 },
+      {  1, -1,  0 },
+      {  1,  0, -1 },
+      {  2, -1, -1 },
+   };
+   uint8_t changed[TEST_MAX_ROW * 4];
+   unsigned stride, d, pixel;
+
+   for (stride = 1; stride <= 8; stride *= 2)
+   {
+      for (d = 0; d < sizeof(deltas) / sizeof(deltas[0]); d++)
+      {
+         for (pixel = 0; pixel + 2 * stride < test->width; pixel += 4)
+         {
+            char what[64];
+            memcpy(changed, row, size);
+            test_add(changed, test->bpp, pixel, deltas[d][0]);
+            test_add(changed, test->bpp, pixel + stride, deltas[d][1]);
+            test_add(changed, test->bpp, pixel + 2 * stride, deltas[d][2]);
+
+            snprintf(what, sizeof(what), "%+d/%+d/%+d on pixels %u/%u/%u",
+                  deltas[d][0], deltas[d][1], deltas[d][2],
+                  pixel, pixel + stride, pixel + 2 * stride);
+            test_expect_change(test, kind, row, changed, size, what);
+         }
+      }
+   }
+}
+
+static void test_swaps(const struct test_row *test, unsigned kind, const uint8_t *row, size_t size)
+{
+   uint8_t changed[TEST_MAX_ROW * 4];
+   unsigned stride, pixel;
+
+   for (stride = 1; stride <= 8; stride *= 2)
+   {
+      for (pixel = 0; pixel + stride < test->width; pixel += 5)
+      {
+         char what[64];
+         if (!memcmp(row + pixel * test->bpp, row + (pixel + stride) * test->bpp, test->bpp))
+            continue;
+
+         memcpy(changed, row, size);
+         memcpy(changed + pixel * test->bpp, row + (pixel + stride) * test->bpp, test->bpp);
+         memcpy(changed + (pixel + stride) * test->bpp, row + pixel * test->bpp, test->bpp);
+
+         snprintf(what, sizeof(what), "swapping pixels %u/%u", pixel, pixel + stride);
+         test_expect_change(test, kind, row, changed, size, what);
+      }
+   }
+}
+
+static void test_bit_flips(const struct test_row *test, unsigned kind, const uint8_t *row, size_t size)
+{
+   uint8_t changed[TEST_MAX_ROW * 4];
+   size_t bit;
+
+   for (bit = 0; bit < size * 8; bit++)
+   {
+      char what[64];
+      memcpy(changed, row, size);
+      changed[bit / 8] ^= 1 << (bit % 8);
+
+      snprintf(what, sizeof(what), "flipping bit %u", (unsigned)bit);
+      test_expect_change(test, kind, row, changed, size, what);
+   }
+}
+
+// Only the changed rows must come back as dirty.
+static void test_update(void)
+{
+   struct rarch_dirty_rows dirty = {0};
+   uint32_t frame[64 * 16];
+   unsigned first, last;
+
+   test_fill((uint8_t*)frame, sizeof(frame), 3);
+   rarch_dirty_rows_update(&dirty, frame, 64, 16, 64 * 4, 4, &first, &last);
+
+   test_add((uint8_t*)(frame + 5 * 64), 4, 10, 1);
+   test_add((uint8_t*)(frame + 5 * 64), 4, 14, -2);
+   test_add((uint8_t*)(frame + 5 * 64), 4, 18, 1);
+   test_add((uint8_t*)(frame + 9 * 64), 4, 0, 1);
+   if (!rarch_dirty_rows_update(&dirty, frame, 64, 16, 64 * 4, 4, &first, &last) ||
+         first != 5 || last != 10)
+   {
+      fprintf(stderr, "update: got rows [%u, %u), expected [5, 10).\n", first, last);
+      test_failures++;
+   }
+
+   if (rarch_dirty_rows_update(&dirty, frame, 64, 16, 64 * 4, 4, &first, &last))
+   {
+      fprintf(stderr, "update: unchanged frame reported as changed.\n");
+      test_failures++;
+   }
+
+   rarch_dirty_rows_free(&dirty);
+}
+
+int main(void)
+{
+   uint8_t row[TEST_MAX_ROW * 4];
+   uint64_t digest = 0;
+   unsigned i, kind;
+   size_t size;
+
+   for (i = 0; i < sizeof(test_rows) / sizeof(test_rows[0]); i++)
+   {
+      const struct test_row *test = &test_rows[i];
+      size = test->width * test->bpp;
+
+      for (kind = 0; kind < 4; kind++)
+      {
+         test_fill(row, size, kind);
+         test_deltas(test, kind, row, size);
+         test_swaps(test, kind, row, size);
+         test_bit_flips(test, kind, row, size);
+      }
+   }
+
+   test_update();
+
+   // Covers every tail size and a few whole blocks.
+   test_fill(row, sizeof(row), 3);
+   for (size = 0; size <= 64; size++)
+      digest = digest * 31 + rarch_dirty_rows_hash(row, size);
+   printf("digest %016llx\n", (unsigned long long)digest);
+
+   fprintf(stderr, "%u failure(s).\n", test_failures);
+   return test_failures ? 1 : 0;
+}
@@ -21,6 +21,15 @@
 #include <string.h>
 #include <limits.h>
 
+// Frames are triple buffered. The emulation thread fills slots[write] and the video thread
+// draws slots[present], without holding any lock. The third slot sits in the mailbox.
+// Either thread hands over its slot by swapping it with the one in the mailbox,
+// and THREAD_FRAME_FRESH marks that the mailbox holds a frame which is yet to be drawn.
+// A new frame replaces one the video thread never got to, so the newest frame always wins.
+#define THREAD_FRAME_SLOTS 3
+#define THREAD_FRAME_SLOT_MASK 3
+#define THREAD_FRAME_FRESH 4
+
 enum thread_cmd
 {
    CMD_NONE = 0,
@@ -41,6 +50,21 @@ enum thread_cmd
    CMD_DUMMY = INT_MAX
 };
 
+struct thread_frame_slot
+{
+   uint8_t *buffer;
+   size_t offset; // Of the frame in buffer, when the core rendered into it.
+   unsigned width;
+   unsigned height;
+   unsigned pitch;
+   bool dupe; // Nothing new to upload, the driver shows what it has.
+   char msg[1024];
+
+   // Rows of buffer which are behind the last frame handed in.
+   // Only touched by the emulation thread, which updates them for all slots.
+   unsigned dirty_first, dirty_last;
+};
+
 typedef struct thread_video
 {
    slock_t *lock;
@@ -77,7 +101,7 @@ typedef struct thread_video
    bool focus;
    bool nonblock;
 
-   retro_time_t last_time;
+   retro_time_t deadline; // When the last frame was due.
    unsigned hit_count;
    unsigned miss_count;
 
@@ -127,13 +151,13 @@ typedef struct thread_video
    struct
    {
       slock_t *lock;
-      uint8_t *buffer;
-      unsigned width;
-      unsigned height;
-      unsigned pitch;
-      bool updated;
       bool within_thread;
-      char msg[1024];
+
+      struct thread_frame_slot slots[THREAD_FRAME_SLOTS];
+      size_t slot_size;
+      volatile unsigned mailbox;
+      unsigned write; // Only touched by the emulation thread.
+      unsigned present; // Only touched by the video thread.
    } frame;
 
    video_driver_t video_thread;
@@ -192,9 +216,9 @@ static void thread_loop(void *data)
    {
       bool updated = false;
       slock_lock(thr->lock);
-      while (thr->send_cmd == CMD_NONE && !thr->frame.updated)
+      while (thr->send_cmd == CMD_NONE && !(satomic_load(&thr->frame.mailbox) & THREAD_FRAME_FRESH))
          scond_wait(thr->cond_thread, thr->lock);
-      if (thr->frame.updated)
+      if (satomic_load(&thr->frame.mailbox) & THREAD_FRAME_FRESH)
          updated = true;
       enum thread_cmd send_cmd = thr->send_cmd; // To avoid race condition where send_cmd is updated right after the switch is checked.
       slock_unlock(thr->lock);
@@ -281,14 +305,20 @@ static void thread_loop(void *data)
 
       if (updated)
       {
+         // Hand back the slot drawn last, and take the newest frame.
+         thr->frame.present = satomic_swap(&thr->frame.mailbox, thr->frame.present) &
+            THREAD_FRAME_SLOT_MASK;
+         const struct thread_frame_slot *slot = &thr->frame.slots[thr->frame.present];
+
          slock_lock(thr->frame.lock);
 
          thread_update_driver_state(thr);
          bool ret = thr->driver->frame(thr->driver_data,
-               thr->frame.buffer, thr->frame.width, thr->frame.height,
-               thr->frame.pitch, *thr->frame.msg ? thr->frame.msg : NULL);
+               slot->dupe ? NULL : slot->buffer + slot->offset, slot->width, slot->height,
+               slot->pitch, *slot->msg ? slot->msg : NULL);
 
          slock_unlock(thr->frame.lock);
+         thr->hit_count++;
 
          bool alive = ret && thr->driver->alive(thr->driver_data);
          bool focus = ret && thr->driver->focus(thr->driver_data);
@@ -299,7 +329,6 @@ static void thread_loop(void *data)
          slock_lock(thr->lock);
          thr->alive = alive;
          thr->focus = focus;
-         thr->frame.updated = false;
          thr->vp = vp;
          scond_signal(thr->cond_cmd);
          slock_unlock(thr->lock);
@@ -351,6 +380,96 @@ static bool thread_focus(void *data)
    return ret;
 }
 
+// Copies a frame into our slot, and hands it to the video thread.
+static void thread_push_frame(thread_video_t *thr, const void *frame_,
+      unsigned width, unsigned height, unsigned pitch, const char *msg)
+{
+   unsigned copy_stride = width * (thr->info.rgb32 ? sizeof(uint32_t) : sizeof(uint16_t));
+   struct thread_frame_slot *slot;
+   unsigned i, old;
+
+   // Every slot falls behind by the rows which changed since the last frame.
+   if (frame_ && g_extern.dirty_rows.first < g_extern.dirty_rows.last)
+   {
+      for (i = 0; i < THREAD_FRAME_SLOTS; i++)
+      {
+         slot = &thr->frame.slots[i];
+
+         if (slot->dirty_first >= slot->dirty_last)
+         {
+            slot->dirty_first = g_extern.dirty_rows.first;
+            slot->dirty_last = g_extern.dirty_rows.last;
+         }
+         else
+         {
+            slot->dirty_first = min(slot->dirty_first, g_extern.dirty_rows.first);
+            slot->dirty_last = max(slot->dirty_last, g_extern.dirty_rows.last);
+         }
+      }
+   }
+
+   slot = &thr->frame.slots[thr->frame.write];
+   slot->dupe = !frame_;
+
+   if (frame_ && (const uint8_t*)frame_ >= slot->buffer &&
+         (const uint8_t*)frame_ < slot->buffer + thr->frame.slot_size)
+   {
+      // The core rendered right into the slot, see thread_get_frame_buffer().
+      slot->offset = (const uint8_t*)frame_ - slot->buffer;
+      slot->width = width;
+      slot->height = height;
+      slot->pitch = pitch;
+      slot->dirty_first = slot->dirty_last = 0;
+      frame_ = NULL;
+   }
+   else if (width != slot->width || height != slot->height ||
+         copy_stride != slot->pitch || slot->offset)
+   {
+      slot->dirty_first = 0;
+      slot->dirty_last = height;
+      slot->offset = 0;
+      slot->width = width;
+      slot->height = height;
+      slot->pitch = copy_stride;
+   }
+
+   // The slot is ours alone, so copy without holding a lock.
+   if (frame_)
+   {
+      unsigned h;
+      unsigned last = min(slot->dirty_last, height);
+      const uint8_t *src = (const uint8_t*)frame_ + slot->dirty_first * pitch;
+      uint8_t *dst = slot->buffer + slot->dirty_first * copy_stride;
+      for (h = slot->dirty_first; h < last; h++, src += pitch, dst += copy_stride)
+         memcpy(dst, src, copy_stride);
+      slot->dirty_first = slot->dirty_last = 0;
+   }
+
+   if (msg)
+      strlcpy(slot->msg, msg, sizeof(slot->msg));
+   else
+      *slot->msg = '\0';
+
+   old = satomic_swap(&thr->frame.mailbox, thr->frame.write | THREAD_FRAME_FRESH);
+   thr->frame.write = old & THREAD_FRAME_SLOT_MASK;
+
+   // The video thread never saw the frame we just replaced.
+   if (old & THREAD_FRAME_FRESH)
+      thr->miss_count++;
+
+   slock_lock(thr->lock);
+   scond_signal(thr->cond_thread);
+
+#if defined(HAVE_MENU)
+   if (thr->texture.enable)
+   {
+      while (satomic_load(&thr->frame.mailbox) & THREAD_FRAME_FRESH)
+         scond_wait(thr->cond_cmd, thr->lock);
+   }
+#endif
+   slock_unlock(thr->lock);
+}
+
 static bool thread_frame(void *data, const void *frame_,
       unsigned width, unsigned height, unsigned pitch, const char *msg)
 {
@@ -365,24 +484,26 @@ static bool thread_frame(void *data, const void *frame_,
 
    RARCH_PERFORMANCE_INIT(thread_frame);
    RARCH_PERFORMANCE_START(thread_frame);
+   RARCH_JITTER_INIT(thread_frame_jitter);
 
-   unsigned copy_stride = width * (thr->info.rgb32 ? sizeof(uint32_t) : sizeof(uint16_t));
-
-   const uint8_t *src = frame_;
-   uint8_t *dst = thr->frame.buffer;
-
-   slock_lock(thr->lock);
+   retro_time_t target_frame_time = (retro_time_t)roundf(1000000LL / g_settings.video.refresh_rate);
 
    if (!thr->nonblock)
    {
-      retro_time_t target_frame_time = (retro_time_t)roundf(1000000LL / g_settings.video.refresh_rate);
-      retro_time_t target = thr->last_time + target_frame_time;
+      // Pace the core to the display, but never wait for the driver for longer than a frame.
+      // Frames are due a refresh after the last one was due rather than after it got here,
+      // so time lost waking up does not add up. A late frame does not make the next ones early.
+      retro_time_t current = rarch_get_time_usec();
+      thr->deadline += target_frame_time;
+      if (thr->deadline < current)
+         thr->deadline = current;
+      else if (thr->deadline > current + target_frame_time)
+         thr->deadline = current + target_frame_time;
 
-      // Ideally, use absolute time, but that is only a good idea on POSIX.
-      while (thr->frame.updated)
+      slock_lock(thr->lock);
+      while (satomic_load(&thr->frame.mailbox) & THREAD_FRAME_FRESH)
       {
-         retro_time_t current = rarch_get_time_usec();
-         retro_time_t delta = target - current;
+         retro_time_t delta = thr->deadline - rarch_get_time_usec();
 
          if (delta <= 0)
             break;
@@ -390,47 +511,18 @@ static bool thread_frame(void *data, const void *frame_,
          if (!scond_wait_timeout(thr->cond_cmd, thr->lock, delta))
             break;
       }
+      slock_unlock(thr->lock);
    }
 
-   // Drop frame if updated flag is still set, as thread is still working on last frame.
-   if (!thr->frame.updated)
-   {
-      if (src)
-      {
-         unsigned h;
-         for (h = 0; h < height; h++, src += pitch, dst += copy_stride)
-            memcpy(dst, src, copy_stride);
-      }
-
-      thr->frame.updated = true;
-      thr->frame.width  = width;
-      thr->frame.height = height;
-      thr->frame.pitch  = copy_stride;
-
-      if (msg)
-         strlcpy(thr->frame.msg, msg, sizeof(thr->frame.msg));
-      else
-         *thr->frame.msg = '\0';
-
-      scond_signal(thr->cond_thread);
-
-#if defined(HAVE_MENU)
-      if (thr->texture.enable)
-      {
-         while (thr->frame.updated)
-            scond_wait(thr->cond_cmd, thr->lock);
-      }
-#endif
-      thr->hit_count++;
-   }
-   else
-      thr->miss_count++;
-
-   slock_unlock(thr->lock);
+   // A dupe has nothing to add to a frame still waiting in the mailbox.
+   // Only we set THREAD_FRAME_FRESH, so if it is clear, it stays clear until we hand over.
+   if (frame_ || !(satomic_load(&thr->frame.mailbox) & THREAD_FRAME_FRESH))
+      thread_push_frame(thr, frame_, width, height, pitch, msg);
 
    RARCH_PERFORMANCE_STOP(thread_frame);
 
-   thr->last_time = rarch_get_time_usec();
+   if (!thr->nonblock)
+      rarch_jitter_update(&thread_frame_jitter, rarch_get_time_usec(), target_frame_time);
    return true;
 }
 
@@ -457,13 +549,21 @@ static bool thread_init(thread_video_t *thr, const video_info_t *info, const inp
    size_t max_size = info->input_scale * RARCH_SCALE_BASE;
    max_size *= max_size;
    max_size *= info->rgb32 ? sizeof(uint32_t) : sizeof(uint16_t);
-   thr->frame.buffer = malloc(max_size);
-   if (!thr->frame.buffer)
-      return false;
+   thr->frame.slot_size = max_size;
+   for (unsigned i = 0; i < THREAD_FRAME_SLOTS; i++)
+   {
+      thr->frame.slots[i].buffer = malloc(max_size);
+      if (!thr->frame.slots[i].buffer)
+         return false;
+
+      memset(thr->frame.slots[i].buffer, 0x80, max_size);
+   }
 
-   memset(thr->frame.buffer, 0x80, max_size);
+   thr->frame.write = 0;
+   thr->frame.mailbox = 1;
+   thr->frame.present = 2;
 
-   thr->last_time = rarch_get_time_usec();
+   thr->deadline = rarch_get_time_usec();
 
    thr->thread = sthread_create(thread_loop, thr);
    if (!thr->thread)
@@ -527,7 +627,8 @@ static void thread_free(void *data)
 #if defined(HAVE_MENU)
    free(thr->texture.frame);
 #endif
-   free(thr->frame.buffer);
+   for (unsigned i = 0; i < THREAD_FRAME_SLOTS; i++)
+      free(thr->frame.slots[i].buffer);
    slock_free(thr->frame.lock);
    slock_free(thr->lock);
    scond_free(thr->cond_cmd);
@@ -536,7 +637,7 @@ static void thread_free(void *data)
    free(thr->alpha_mod);
    slock_free(thr->alpha_lock);
 
-   RARCH_LOG("Threaded video stats: Frames pushed: %u, Frames dropped: %u.\n",
+   RARCH_LOG("Threaded video stats: Frames drawn: %u, Frames replaced before drawn: %u.\n",
          thr->hit_count, thr->miss_count);
 
    free(thr);
@@ -611,6 +712,21 @@ static struct gfx_shader *thread_get_current_shader(void *data)
    return thr->poke ? thr->poke->get_current_shader(thr->driver_data) : NULL;
 }
 
+// Lends the slot the next frame gets copied into. Only the emulation thread touches it.
+static void *thread_get_frame_buffer(void *data, unsigned height, size_t pitch)
+{
+   thread_video_t *thr = data;
+   struct thread_frame_slot *slot = &thr->frame.slots[thr->frame.write];
+
+   if ((size_t)height * pitch > thr->frame.slot_size)
+      return NULL;
+
+   // Whatever the core leaves in there, the rows are no longer those of an older frame.
+   slot->dirty_first = 0;
+   slot->dirty_last = UINT_MAX;
+   return slot->buffer;
+}
+
 static const video_poke_interface_t thread_poke = {
   .set_filtering = thread_set_filtering,
 
@@ -622,6 +738,7 @@ static const video_poke_interface_t thread_poke = {
 #endif
 
   .get_current_shader = thread_get_current_shader,
+  .get_frame_buffer = thread_get_frame_buffer,
 };
 
 static void thread_get_poke_interface(void *data, const video_poke_interface_t **iface)
@@ -1268,6 +1268,9 @@ typedef bool (*retro_fb_cfg_set_format)(void *ctx, enum retro_pixel_format pixel
  * The pitch is at least 'bpp' times 'width', where 'bpp' is derived from
  * the pixel format used in set_format().
  *
+ * The buffer can be memory the frontend reads frames from anyway,
+ * so its contents are undefined. The core has to render the whole frame.
+ *
  * Returns 'false' if the getting the address fails.
  */
 typedef bool (*retro_fb_cfg_get_current_addr)(void *ctx, void **addr,
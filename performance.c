@@ -20,6 +20,7 @@
 #include "general.h"
 
 #include <unistd.h>
+#include <errno.h>
 
 #if defined(_POSIX_MONOTONIC_CLOCK)
 #include <time.h>
@@ -75,6 +76,67 @@ static void log_counters(const struct retro_perf_counter **counters, unsigned nu
    }
 }
 
+#define MAX_JITTERS 8
+static struct rarch_jitter *perf_jitters[MAX_JITTERS];
+static unsigned perf_ptr_jitters;
+
+void rarch_jitter_register(struct rarch_jitter *jitter)
+{
+   if (!g_extern.perfcnt_enable || jitter->registered || perf_ptr_jitters >= MAX_JITTERS)
+      return;
+
+   perf_jitters[perf_ptr_jitters++] = jitter;
+   jitter->registered = true;
+}
+
+void rarch_jitter_update(struct rarch_jitter *jitter, retro_time_t now, retro_time_t interval)
+{
+   retro_time_t delta = now - jitter->last - interval;
+   retro_time_t last = jitter->last;
+
+   jitter->last = now;
+   if (!g_extern.perfcnt_enable || !last)
+      return;
+
+   if (delta < 0)
+      delta = -delta;
+
+   // Pauses, menu and the like are no jitter.
+   if (delta > 4 * interval)
+      return;
+
+   jitter->samples[jitter->count++ % RARCH_JITTER_SAMPLES] = delta;
+}
+
+static int jitter_compare(const void *a_, const void *b_)
+{
+   uint32_t a = *(const uint32_t*)a_;
+   uint32_t b = *(const uint32_t*)b_;
+   return (a > b) - (a < b);
+}
+
+static void log_jitters(void)
+{
+   uint32_t sorted[RARCH_JITTER_SAMPLES];
+   unsigned i;
+
+   for (i = 0; i < perf_ptr_jitters; i++)
+   {
+      const struct rarch_jitter *jitter = perf_jitters[i];
+      unsigned num = min(jitter->count, RARCH_JITTER_SAMPLES);
+      if (!num)
+         continue;
+
+      memcpy(sorted, jitter->samples, num * sizeof(*sorted));
+      qsort(sorted, num, sizeof(*sorted), jitter_compare);
+
+      RARCH_LOG("[PERF]: Jitter (%s): p50 %u us, p90 %u us, p99 %u us, max %u us, %u frames.\n",
+            jitter->ident,
+            (unsigned)sorted[num / 2], (unsigned)sorted[num * 9 / 10],
+            (unsigned)sorted[num * 99 / 100], (unsigned)sorted[num - 1], num);
+   }
+}
+
 void rarch_perf_log()
 {
    if (!g_extern.perfcnt_enable)
@@ -82,6 +144,7 @@ void rarch_perf_log()
 
    RARCH_LOG("[PERF]: Performance counters (RetroArch):\n");
    log_counters(perf_counters_rarch, perf_ptr_rarch);
+   log_jitters();
 }
 
 void retro_perf_log()
@@ -131,6 +194,30 @@ retro_time_t rarch_get_time_usec()
 #endif
 }
 
+void rarch_sleep_until(retro_time_t deadline, retro_time_t spin)
+{
+   retro_time_t wake = deadline - spin;
+
+#if defined(_POSIX_MONOTONIC_CLOCK) && defined(TIMER_ABSTIME) && !defined(__APPLE__)
+   // An absolute deadline does not drift by the time it takes to get here.
+   struct timespec tv;
+   tv.tv_sec = wake / 1000000;
+   tv.tv_nsec = (wake % 1000000) * 1000;
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tv, NULL) == EINTR);
+#else
+   retro_time_t current = rarch_get_time_usec();
+   if (wake > current)
+   {
+      struct timespec tv;
+      tv.tv_sec = (wake - current) / 1000000;
+      tv.tv_nsec = ((wake - current) % 1000000) * 1000;
+      nanosleep(&tv, NULL);
+   }
+#endif
+
+   while (spin > 0 && rarch_get_time_usec() < deadline);
+}
+
 #if defined(__x86_64__) || defined(__i386__) || defined(__i486__) || defined(__i686__)
 #define CPU_X86
 #endif
@@ -54,6 +54,26 @@ static inline void rarch_perf_stop(struct retro_perf_counter *perf)
 uint64_t rarch_get_cpu_features();
 unsigned rarch_get_cpu_cores();
 
+// Sleeps until deadline, in rarch_get_time_usec() time.
+// As sleeps tend to overshoot, the last spin microseconds are busy-waited.
+void rarch_sleep_until(retro_time_t deadline, retro_time_t spin);
+
+// Keeps track of how far frame intervals are off their target.
+// Percentiles of the last RARCH_JITTER_SAMPLES intervals are logged along with the performance counters.
+#define RARCH_JITTER_SAMPLES 1024
+struct rarch_jitter
+{
+   const char *ident;
+   retro_time_t last;
+   uint32_t samples[RARCH_JITTER_SAMPLES]; // Deviation in microseconds.
+   unsigned count;
+   bool registered;
+};
+
+void rarch_jitter_register(struct rarch_jitter *jitter);
+// Records a frame let through at now, which was due interval after the one before.
+void rarch_jitter_update(struct rarch_jitter *jitter, retro_time_t now, retro_time_t interval);
+
 // Used internally by RetroArch.
 #define RARCH_PERFORMANCE_INIT(X) \
    static struct retro_perf_counter X = {#X}; \
@@ -65,5 +85,12 @@ unsigned rarch_get_cpu_cores();
 #define RARCH_PERFORMANCE_START(X) rarch_perf_start(&(X))
 #define RARCH_PERFORMANCE_STOP(X) rarch_perf_stop(&(X))
 
+#define RARCH_JITTER_INIT(X) \
+   static struct rarch_jitter X = {#X}; \
+   do { \
+      if (!(X).registered) \
+         rarch_jitter_register(&(X)); \
+   } while(0)
+
 #endif
 
@@ -66,6 +66,7 @@ struct ffemu_video_data
    unsigned width;
    unsigned height;
    int pitch;
+   // Frame is the same as the last one. data may still point to it.
    bool is_dupe;
 };
 
@@ -38,6 +38,7 @@
 #include "../thread.h"
 #include "../general.h"
 #include "../gfx/scaler/scaler.h"
+#include "../performance.h"
 #include "../conf/config_file.h"
 #include "../audio/utils.h"
 #include "../audio/resampler.h"
@@ -53,6 +54,33 @@
 #define av_frame_free avcodec_free_frame
 #endif
 
+// A frame waiting to be encoded. Every reference is one frame of output.
+// When the last frame is to be repeated, or a frame had to be dropped,
+// the last frame just gets another reference.
+struct ff_frame
+{
+   struct ffemu_video_data attr;
+   uint8_t *buf;
+   unsigned refs;
+   bool encoded;
+};
+
+// Ring of preallocated frames. Frames are written once by the emulation thread,
+// and encoded straight out of the ring by the encoder thread.
+struct ff_frame_queue
+{
+   struct ff_frame *frames;
+   unsigned size;
+   unsigned head; // Oldest frame, the one being encoded.
+   unsigned count;
+
+   // Frames pushed, frames dropped because the queue was full,
+   // and frames which had to wait for the encoder thread.
+   unsigned queued;
+   unsigned dropped;
+   unsigned blocked;
+};
+
 struct ff_video_info
 {
    AVCodecContext *codec;
@@ -72,6 +100,8 @@ struct ff_video_info
 
    unsigned frame_drop_ratio;
    unsigned frame_drop_count;
+   // A frame which was not a dupe got dropped since the last frame queued.
+   bool dropped_change;
 
    // Input pixel size.
    size_t pix_size;
@@ -81,6 +111,8 @@ struct ff_video_info
    struct scaler_ctx scaler;
    struct SwsContext *sws;
    bool use_sws;
+
+   struct ff_frame_queue queue;
 };
 
 struct ff_audio_info
@@ -109,6 +141,10 @@ struct ff_audio_info
    float *float_conv;
    size_t float_conv_frames;
 
+   // Pushes which had to wait for the encoder thread.
+   // Audio cannot be dropped without losing sync, so it always waits.
+   unsigned blocked;
+
    float *resample_out;
    size_t resample_out_frames;
 
@@ -137,6 +173,8 @@ struct ff_config_param
    enum PixelFormat out_pix_fmt;
    unsigned threads;
    unsigned frame_drop_ratio;
+   unsigned frame_queue_size;
+   bool frame_queue_drop;
    unsigned sample_rate;
    unsigned scale_factor;
 
@@ -162,16 +200,15 @@ typedef struct ffmpeg
    
    struct ffemu_params params;
 
+   // Signalled when there is work for the encoder thread,
+   // and when the encoder thread made room for more.
    scond_t *cond;
-   slock_t *cond_lock;
+   scond_t *space_cond;
    slock_t *lock;
    fifo_buffer_t *audio_fifo;
-   fifo_buffer_t *video_fifo;
-   fifo_buffer_t *attr_fifo;
    sthread_t *thread;
 
-   volatile bool alive;
-   volatile bool can_sleep;
+   bool alive;
 } ffmpeg_t;
 
 static bool ffmpeg_codec_has_sample_format(enum AVSampleFormat fmt, const enum AVSampleFormat *fmts)
@@ -460,12 +497,15 @@ static bool ffmpeg_init_video(ffmpeg_t *handle)
    return true;
 }
 
+#define MAX_FRAMES 32
+
 static bool ffmpeg_init_config(struct ff_config_param *params, const char *config)
 {
    params->out_pix_fmt = PIX_FMT_NONE;
    params->scale_factor = 1;
    params->threads = 1;
    params->frame_drop_ratio = 1;
+   params->frame_queue_size = MAX_FRAMES;
 
    if (!config)
       return true;
@@ -487,6 +527,24 @@ static bool ffmpeg_init_config(struct ff_config_param *params, const char *confi
          || !params->frame_drop_ratio)
       params->frame_drop_ratio = 1;
 
+   // Frames the encoder thread may lag behind, and whether to drop frames
+   // rather than to stall emulation once it lags behind more than that.
+   if (!config_get_uint(params->conf, "frame_queue_size", &params->frame_queue_size)
+         || !params->frame_queue_size)
+      params->frame_queue_size = MAX_FRAMES;
+
+   char queue_policy[64] = {0};
+   if (config_get_array(params->conf, "frame_queue_policy", queue_policy, sizeof(queue_policy)))
+   {
+      if (strcmp(queue_policy, "drop") == 0)
+         params->frame_queue_drop = true;
+      else if (strcmp(queue_policy, "block") != 0)
+      {
+         RARCH_ERR("Invalid frame_queue_policy \"%s\", expected \"block\" or \"drop\".\n", queue_policy);
+         return false;
+      }
+   }
+
    if (!config_get_bool(params->conf, "audio_enable", &params->audio_enable))
       params->audio_enable = true;
 
@@ -572,27 +630,51 @@ static bool ffmpeg_init_muxer_post(ffmpeg_t *handle)
    return avformat_write_header(handle->muxer.ctx, NULL) >= 0;
 }
 
-#define MAX_FRAMES 32
-
 static void ffmpeg_thread(void *data);
 
+static bool init_frame_queue(ffmpeg_t *handle)
+{
+   unsigned i;
+   struct ff_frame_queue *queue = &handle->video.queue;
+
+   // Frames are tightly packed. FFmpeg has a tendency to read a bit past the end of them.
+   size_t buf_size = (handle->params.fb_height + 1) * handle->params.fb_width * handle->video.pix_size;
+
+   queue->size = handle->config.frame_queue_size;
+   queue->frames = calloc(queue->size, sizeof(*queue->frames));
+   if (!queue->frames)
+      return false;
+
+   for (i = 0; i < queue->size; i++)
+   {
+      queue->frames[i].buf = av_malloc(buf_size);
+      if (!queue->frames[i].buf)
+         return false;
+   }
+
+   return true;
+}
+
 static bool init_thread(ffmpeg_t *handle)
 {
    handle->lock = slock_new();
-   handle->cond_lock = slock_new();
    handle->cond = scond_new();
-   handle->audio_fifo = fifo_new(32000 * sizeof(int16_t) * handle->params.channels * MAX_FRAMES / 60); // Some arbitrary max size.
-   handle->attr_fifo = fifo_new(sizeof(struct ffemu_video_data) * MAX_FRAMES);
-   handle->video_fifo = fifo_new(handle->params.fb_width * handle->params.fb_height *
-            handle->video.pix_size * MAX_FRAMES);
+   handle->space_cond = scond_new();
+   // As much audio as there is room for video, so that neither fills up long before the other.
+   // The encoder thread only takes whole codec frames out of it.
+   size_t audio_frames = (size_t)ceil(handle->params.samplerate * handle->config.frame_queue_size / handle->params.fps);
+   if (handle->config.audio_enable && audio_frames < 2 * (size_t)handle->audio.codec->frame_size)
+      audio_frames = 2 * handle->audio.codec->frame_size;
+   handle->audio_fifo = fifo_new(audio_frames * handle->params.channels * sizeof(int16_t));
+
+   if (!init_frame_queue(handle))
+      return false;
 
    handle->alive = true;
-   handle->can_sleep = true;
    handle->thread = sthread_create(ffmpeg_thread, handle);
 
-   assert(handle->lock && handle->cond_lock &&
-      handle->cond && handle->audio_fifo &&
-      handle->attr_fifo && handle->video_fifo && handle->thread);
+   assert(handle->lock && handle->cond && handle->space_cond &&
+      handle->audio_fifo && handle->thread);
 
    return true;
 }
@@ -602,39 +684,51 @@ static void deinit_thread(ffmpeg_t *handle)
    if (!handle->thread)
       return;
 
-   slock_lock(handle->cond_lock);
+   slock_lock(handle->lock);
    handle->alive = false;
-   handle->can_sleep = false;
-   slock_unlock(handle->cond_lock);
-
    scond_signal(handle->cond);
-   sthread_join(handle->thread);
-
-   slock_free(handle->lock);
-   slock_free(handle->cond_lock);
-   scond_free(handle->cond);
+   scond_signal(handle->space_cond);
+   slock_unlock(handle->lock);
 
+   sthread_join(handle->thread);
    handle->thread = NULL;
 }
 
 static void deinit_thread_buf(ffmpeg_t *handle)
 {
+   unsigned i;
+   struct ff_frame_queue *queue = &handle->video.queue;
+
    if (handle->audio_fifo)
    {
       fifo_free(handle->audio_fifo);
       handle->audio_fifo = NULL;
    }
-   
-   if (handle->attr_fifo)
+
+   if (queue->frames)
    {
-      fifo_free(handle->attr_fifo);
-      handle->attr_fifo = NULL;
+      for (i = 0; i < queue->size; i++)
+         av_free(queue->frames[i].buf);
+      free(queue->frames);
+      memset(queue, 0, sizeof(*queue));
    }
 
-   if (handle->video_fifo)
+   if (handle->lock)
    {
-      fifo_free(handle->video_fifo);
-      handle->video_fifo = NULL;
+      slock_free(handle->lock);
+      handle->lock = NULL;
+   }
+
+   if (handle->cond)
+   {
+      scond_free(handle->cond);
+      handle->cond = NULL;
+   }
+
+   if (handle->space_cond)
+   {
+      scond_free(handle->space_cond);
+      handle->space_cond = NULL;
    }
 }
 
@@ -728,6 +822,8 @@ static bool ffmpeg_push_video(void *data, const struct ffemu_video_data *video_d
    unsigned y;
    bool drop_frame;
    ffmpeg_t *handle = data;
+   struct ff_frame_queue *queue;
+   struct ff_frame *frame;
 
    if (!handle || !video_data)
       return false;
@@ -737,49 +833,79 @@ static bool ffmpeg_push_video(void *data, const struct ffemu_video_data *video_d
    handle->video.frame_drop_count %= handle->video.frame_drop_ratio;
 
    if (drop_frame)
+   {
+      if (!video_data->is_dupe)
+         handle->video.dropped_change = true;
       return true;
+   }
 
-   for (;;)
+   // A dupe of a dropped frame does not repeat the frame queued last.
+   struct ffemu_video_data video = *video_data;
+   if (video.is_dupe && video.data && handle->video.dropped_change)
+      video.is_dupe = false;
+   handle->video.dropped_change = false;
+   video_data = &video;
+
+   queue = &handle->video.queue;
+   slock_lock(handle->lock);
+
+   if (!handle->alive)
    {
-      slock_lock(handle->lock);
-      unsigned avail = fifo_write_avail(handle->attr_fifo);
       slock_unlock(handle->lock);
+      return false;
+   }
 
-      if (!handle->alive)
-         return false;
+   // Dupes, and frames dropped to keep up, repeat whatever frame was pushed last,
+   // so that video stays in sync with audio.
+   if (queue->count && (video_data->is_dupe ||
+            (queue->count == queue->size && handle->config.frame_queue_drop)))
+   {
+      queue->frames[(queue->head + queue->count - 1) % queue->size].refs++;
+      if (video_data->is_dupe)
+         queue->queued++;
+      else
+         queue->dropped++;
 
-      if (avail >= sizeof(*video_data))
-         break;
+      slock_unlock(handle->lock);
+      scond_signal(handle->cond);
+      return true;
+   }
+
+   if (queue->count == queue->size)
+   {
+      queue->blocked++;
+      while (queue->count == queue->size && handle->alive)
+         scond_wait(handle->space_cond, handle->lock);
 
-      slock_lock(handle->cond_lock);
-      if (handle->can_sleep)
+      if (!handle->alive)
       {
-         handle->can_sleep = false;
-         scond_wait(handle->cond, handle->cond_lock);
-         handle->can_sleep = true;
+         slock_unlock(handle->lock);
+         return false;
       }
-      else
-         scond_signal(handle->cond);
-
-      slock_unlock(handle->cond_lock);
    }
 
-   slock_lock(handle->lock);
+   // The encoder thread does not look at frames past count, so this one can be written without the lock.
+   frame = &queue->frames[(queue->head + queue->count) % queue->size];
+   slock_unlock(handle->lock);
 
    // Tightly pack our frame to conserve memory. libretro tends to use a very large pitch.
-   struct ffemu_video_data attr_data = *video_data;
+   frame->attr      = *video_data;
+   frame->attr.data = frame->buf;
+   frame->refs      = 1;
+   frame->encoded   = false;
 
-   if (attr_data.is_dupe)
-      attr_data.width = attr_data.height = attr_data.pitch = 0;
+   if (frame->attr.is_dupe)
+      frame->attr.width = frame->attr.height = frame->attr.pitch = 0;
    else
-      attr_data.pitch = attr_data.width * handle->video.pix_size;
-
-   fifo_write(handle->attr_fifo, &attr_data, sizeof(attr_data));
+      frame->attr.pitch = frame->attr.width * handle->video.pix_size;
 
-   int offset = 0;
-   for (y = 0; y < attr_data.height; y++, offset += video_data->pitch)
-      fifo_write(handle->video_fifo, (const uint8_t*)video_data->data + offset, attr_data.pitch);
+   for (y = 0; y < frame->attr.height; y++)
+      memcpy(frame->buf + y * frame->attr.pitch,
+            (const uint8_t*)video_data->data + y * video_data->pitch, frame->attr.pitch);
 
+   slock_lock(handle->lock);
+   queue->count++;
+   queue->queued++;
    slock_unlock(handle->lock);
    scond_signal(handle->cond);
 
@@ -796,37 +922,37 @@ static bool ffmpeg_push_audio(void *data, const struct ffemu_audio_data *audio_d
    if (!handle->config.audio_enable)
       return true;
 
-   for (;;)
-   {
-      slock_lock(handle->lock);
-      unsigned avail = fifo_write_avail(handle->audio_fifo);
-      slock_unlock(handle->lock);
-
-      if (!handle->alive)
-         return false;
+   const uint8_t *src = (const uint8_t*)audio_data->data;
+   size_t frame_size = handle->params.channels * sizeof(int16_t);
+   size_t size = audio_data->frames * frame_size;
+   bool blocked = false;
 
-      if (avail >= audio_data->frames * handle->params.channels * sizeof(int16_t))
-         break;
+   slock_lock(handle->lock);
 
-      slock_lock(handle->cond_lock);
-      if (handle->can_sleep)
+   // Written in pieces, as a push may be larger than the whole FIFO.
+   while (size && handle->alive)
+   {
+      size_t avail = fifo_write_avail(handle->audio_fifo);
+      avail -= avail % frame_size;
+      if (!avail)
       {
-         handle->can_sleep = false;
-         scond_wait(handle->cond, handle->cond_lock);
-         handle->can_sleep = true;
+         if (!blocked)
+            handle->audio.blocked++;
+         blocked = true;
+         scond_wait(handle->space_cond, handle->lock);
+         continue;
       }
-      else
-         scond_signal(handle->cond);
 
-      slock_unlock(handle->cond_lock);
+      if (avail > size)
+         avail = size;
+      fifo_write(handle->audio_fifo, src, avail);
+      src += avail;
+      size -= avail;
+      scond_signal(handle->cond);
    }
 
-   slock_lock(handle->lock);
-   fifo_write(handle->audio_fifo, audio_data->data, audio_data->frames * handle->params.channels * sizeof(int16_t));
    slock_unlock(handle->lock);
-   scond_signal(handle->cond);
-
-   return true;
+   return handle->alive;
 }
 
 static bool encode_video(ffmpeg_t *handle, AVPacket *pkt, AVFrame *frame)
@@ -891,6 +1017,7 @@ static void ffmpeg_scale_input(ffmpeg_t *handle, const struct ffemu_video_data *
          handle->video.scaler.out_width  = handle->params.out_width;
          handle->video.scaler.out_height = handle->params.out_height;
          handle->video.scaler.out_stride = handle->video.conv_frame->linesize[0];
+         handle->video.scaler.threads    = rarch_get_cpu_cores();
 
          scaler_ctx_gen_filter(&handle->video.scaler);
       }
@@ -920,6 +1047,42 @@ static bool ffmpeg_push_video_thread(ffmpeg_t *handle, const struct ffemu_video_
    return true;
 }
 
+// Encodes the oldest frame in the queue once. Returns false if the queue is empty.
+static bool ffmpeg_encode_queued_frame(ffmpeg_t *handle)
+{
+   struct ff_frame_queue *queue = &handle->video.queue;
+   struct ff_frame *frame;
+   struct ffemu_video_data attr;
+
+   slock_lock(handle->lock);
+   if (!queue->count)
+   {
+      slock_unlock(handle->lock);
+      return false;
+   }
+   frame = &queue->frames[queue->head];
+   attr = frame->attr;
+   slock_unlock(handle->lock);
+
+   // Further references just repeat the frame.
+   if (frame->encoded)
+      attr.is_dupe = true;
+   frame->encoded = true;
+
+   ffmpeg_push_video_thread(handle, &attr);
+
+   slock_lock(handle->lock);
+   if (--frame->refs == 0)
+   {
+      queue->head = (queue->head + 1) % queue->size;
+      queue->count--;
+      scond_signal(handle->space_cond);
+   }
+   slock_unlock(handle->lock);
+
+   return true;
+}
+
 static void planarize_float(float *out, const float *in, size_t frames)
 {
    size_t i;
@@ -1162,7 +1325,6 @@ static void ffmpeg_flush_video(ffmpeg_t *handle)
 
 static void ffmpeg_flush_buffers(ffmpeg_t *handle)
 {
-   void *video_buf = av_malloc(2 * handle->params.fb_width * handle->params.fb_height * handle->video.pix_size);
    size_t audio_buf_size = handle->config.audio_enable ? (handle->audio.codec->frame_size * handle->params.channels * sizeof(int16_t)) : 0;
    void *audio_buf = audio_buf_size ? av_malloc(audio_buf_size) : NULL;
 
@@ -1187,16 +1349,8 @@ static void ffmpeg_flush_buffers(ffmpeg_t *handle)
          }
       }
 
-      struct ffemu_video_data attr_buf;
-      if (fifo_read_avail(handle->attr_fifo) >= sizeof(attr_buf))
-      {
-         fifo_read(handle->attr_fifo, &attr_buf, sizeof(attr_buf));
-         fifo_read(handle->video_fifo, video_buf, attr_buf.height * attr_buf.pitch);
-         attr_buf.data = video_buf;
-         ffmpeg_push_video_thread(handle, &attr_buf);
-
+      if (ffmpeg_encode_queued_frame(handle))
          did_work = true;
-      }
    } while (did_work);
 
    // Flush out last audio.
@@ -1206,7 +1360,6 @@ static void ffmpeg_flush_buffers(ffmpeg_t *handle)
    // Flush out last video.
    ffmpeg_flush_video(handle);
 
-   av_free(video_buf);
    av_free(audio_buf);
 }
 
@@ -1222,6 +1375,10 @@ static bool ffmpeg_finalize(void *data)
    // Flush out data still in buffers (internal, and FFmpeg internal).
    ffmpeg_flush_buffers(handle);
 
+   RARCH_LOG("[FFmpeg]: Frames queued: %u, dropped: %u, blocked: %u. Audio blocked: %u.\n",
+         handle->video.queue.queued, handle->video.queue.dropped, handle->video.queue.blocked,
+         handle->audio.blocked);
+
    deinit_thread_buf(handle);
 
    // Write final data.
@@ -1234,63 +1391,45 @@ static void ffmpeg_thread(void *data)
 {
    ffmpeg_t *ff = data;
 
-   // For some reason, FFmpeg has a tendency to crash if we don't overallocate a bit. :s
-   void *video_buf = av_malloc(2 * ff->params.fb_width * ff->params.fb_height * ff->video.pix_size);
-   assert(video_buf);
-
    size_t audio_buf_size = ff->config.audio_enable ? (ff->audio.codec->frame_size * ff->params.channels * sizeof(int16_t)) : 0;
    void *audio_buf = audio_buf_size ? av_malloc(audio_buf_size) : NULL;
 
-   while (ff->alive)
+   for (;;)
    {
-      struct ffemu_video_data attr_buf;
-
       bool avail_video = false;
       bool avail_audio = false;
 
       slock_lock(ff->lock);
-      if (fifo_read_avail(ff->attr_fifo) >= sizeof(attr_buf))
-         avail_video = true;
-
-      if (ff->config.audio_enable)
-         if (fifo_read_avail(ff->audio_fifo) >= audio_buf_size)
-            avail_audio = true;
-      slock_unlock(ff->lock);
-
-      if (!avail_video && !avail_audio)
+      for (;;)
       {
-         slock_lock(ff->cond_lock);
-         if (ff->can_sleep)
-         {
-            ff->can_sleep = false;
-            scond_wait(ff->cond, ff->cond_lock);
-            ff->can_sleep = true;
-         }
-         else
-            scond_signal(ff->cond);
+         avail_video = ff->video.queue.count;
+         avail_audio = ff->config.audio_enable &&
+            fifo_read_avail(ff->audio_fifo) >= audio_buf_size;
 
-         slock_unlock(ff->cond_lock);
+         if (avail_video || avail_audio || !ff->alive)
+            break;
+
+         scond_wait(ff->cond, ff->lock);
       }
 
-      if (avail_video)
+      if (!ff->alive)
       {
-         slock_lock(ff->lock);
-         fifo_read(ff->attr_fifo, &attr_buf, sizeof(attr_buf));
-         fifo_read(ff->video_fifo, video_buf, attr_buf.height * attr_buf.pitch);
          slock_unlock(ff->lock);
-         scond_signal(ff->cond);
-
-         attr_buf.data = video_buf;
-         ffmpeg_push_video_thread(ff, &attr_buf);
+         break;
       }
 
       if (avail_audio)
       {
-         slock_lock(ff->lock);
          fifo_read(ff->audio_fifo, audio_buf, audio_buf_size);
-         slock_unlock(ff->lock);
-         scond_signal(ff->cond);
+         scond_signal(ff->space_cond);
+      }
+      slock_unlock(ff->lock);
 
+      if (avail_video)
+         ffmpeg_encode_queued_frame(ff);
+
+      if (avail_audio)
+      {
          struct ffemu_audio_data aud = {0};
          aud.frames = ff->audio.codec->frame_size;
          aud.data = audio_buf;
@@ -1299,7 +1438,6 @@ static void ffmpeg_thread(void *data)
       }
    }
 
-   av_free(video_buf);
    av_free(audio_buf);
 }
 
@@ -199,6 +199,23 @@ static void readjust_audio_input_rate()
 
    adjust = 1.0 + g_settings.audio.rate_control_delta * direction;
 
+   // Integral term. Converges on the clock skew between content and audio device,
+   // so the proportional term only has to deal with jitter around half buffer fill.
+   if (g_settings.audio.rate_control_integral > 0.0f)
+   {
+      double limit = g_settings.audio.rate_control_delta;
+      double integral = g_extern.audio_data.rate_control_integral +
+         limit * g_settings.audio.rate_control_integral * direction;
+
+      if (integral > limit)
+         integral = limit;
+      else if (integral < -limit)
+         integral = -limit;
+
+      g_extern.audio_data.rate_control_integral = integral;
+      adjust += integral;
+   }
+
    g_extern.audio_data.src_ratio = g_extern.audio_data.orig_src_ratio * adjust;
 
    //RARCH_LOG_OUTPUT("New rate: %lf, Orig rate: %lf\n",
@@ -300,6 +317,22 @@ static void init_recording()
       }
    }
 
+   switch (params.pix_fmt)
+   {
+      case FFEMU_PIX_BGR24:
+         g_extern.record_bpp = 3;
+         break;
+      case FFEMU_PIX_ARGB8888:
+         g_extern.record_bpp = sizeof(uint32_t);
+         break;
+      default:
+         g_extern.record_bpp = sizeof(uint16_t);
+         break;
+   }
+   free(g_extern.record_last_frame);
+   g_extern.record_last_frame = NULL;
+   g_extern.record_last_frame_size = 0;
+
    RARCH_LOG("Recording to %s @ %ux%u. (FB size: %ux%u pix_fmt: %u)\n",
          g_extern.record_path,
          params.out_width, params.out_height,
@@ -330,6 +363,48 @@ static void deinit_recording()
    if (g_extern.record_gpu_buffer)
       free(g_extern.record_gpu_buffer);
    g_extern.record_gpu_buffer = NULL;
+
+   free(g_extern.record_last_frame);
+   g_extern.record_last_frame = NULL;
+   g_extern.record_last_frame_size = 0;
+}
+
+// Returns false if a frame is the same as the last one recorded.
+// Rows which differ are copied, so that the copy always holds the last frame.
+static bool recording_frame_changed(const uint8_t *frame,
+      unsigned width, unsigned height, size_t pitch, unsigned bpp)
+{
+   size_t row_size = width * bpp;
+   size_t size = row_size * height;
+   bool resized = size != g_extern.record_last_frame_size;
+   bool changed = false;
+   unsigned y;
+
+   RARCH_PERFORMANCE_INIT(record_frame_compare);
+   RARCH_PERFORMANCE_START(record_frame_compare);
+
+   if (resized)
+   {
+      free(g_extern.record_last_frame);
+      g_extern.record_last_frame = (uint8_t*)malloc(size);
+      g_extern.record_last_frame_size = g_extern.record_last_frame ? size : 0;
+      changed = true;
+   }
+
+   for (y = 0; y < height && g_extern.record_last_frame; y++)
+   {
+      uint8_t *last = g_extern.record_last_frame + y * row_size;
+      const uint8_t *row = frame + y * pitch;
+      if (resized || memcmp(last, row, row_size))
+      {
+         memcpy(last, row, row_size);
+         changed = true;
+      }
+   }
+
+   RARCH_PERFORMANCE_STOP(record_frame_compare);
+
+   return changed;
 }
 
 static void recording_dump_frame(const void *data, unsigned width, unsigned height, size_t pitch)
@@ -386,14 +461,71 @@ static void recording_dump_frame(const void *data, unsigned width, unsigned heig
    if (!g_extern.record_gpu_buffer)
       ffemu_data.is_dupe = !data;
 
+   // Cores which draw the same frame over and over again would have the recorder
+   // scale and encode it every time. Frames which did not change are flagged as dupes.
+   // data is kept, as the recorder may not have seen the frame this one repeats.
+   if (g_settings.video.record_dupe_detect && !ffemu_data.is_dupe)
+   {
+      if (g_extern.record_gpu_buffer)
+         ffemu_data.is_dupe = !recording_frame_changed(g_extern.record_gpu_buffer,
+               ffemu_data.width, ffemu_data.height, ffemu_data.width * 3, 3);
+      else
+         ffemu_data.is_dupe = !recording_frame_changed((const uint8_t*)data,
+               width, height, pitch, g_extern.record_bpp);
+   }
+
    if (g_extern.rec_driver && g_extern.rec_driver->push_video)
       g_extern.rec_driver->push_video(g_extern.rec, &ffemu_data);
 }
 
-static void video_frame(const void *data, unsigned width, unsigned height, size_t pitch)
+// Maps a range of rows of a filter's input onto the rows of its output.
+static void video_frame_scale_rows(unsigned *first, unsigned *last,
+      unsigned height, unsigned out_height)
 {
+   if (!height)
+      return;
+   *first = (*first * out_height) / height;
+   *last = (*last * out_height + height - 1) / height;
+}
+
+// Grows [*first, *last) to cover [other_first, other_last) as well.
+static void video_frame_merge_rows(unsigned *first, unsigned *last,
+      unsigned other_first, unsigned other_last)
+{
+   if (other_first >= other_last)
+      return;
+   if (*first >= *last)
+   {
+      *first = other_first;
+      *last = other_last;
+      return;
+   }
+   *first = min(*first, other_first);
+   *last = max(*last, other_last);
+}
+
+// Time spent blocking on vsync, audio sync or the frame limiter
+// is not time the frontend and the core are behind by, see update_frameskip().
+static inline retro_time_t frameskip_block_start(void)
+{
+   return g_settings.video.auto_frameskip ? rarch_get_time_usec() : 0;
+}
+
+static inline void frameskip_block_end(retro_time_t start)
+{
+   if (start)
+      g_extern.frameskip.blocked += rarch_get_time_usec() - start;
+}
+
+static void video_frame_submit(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+   retro_time_t block_start;
    const char *msg;
 
+   // Rows which differ from the last frame. Work on the other rows is skipped,
+   // as the result of last frame is still around.
+   unsigned dirty_first = 0, dirty_last = height;
+
    if (!g_extern.video_active)
       return;
 
@@ -402,18 +534,45 @@ static void video_frame(const void *data, unsigned width, unsigned height, size_
    g_extern.frame_cache.height = height;
    g_extern.frame_cache.pitch  = pitch;
 
+   // The driver keeps showing the last frame, which all the work below would only lead up to.
+   if (g_extern.frameskip.skip)
+      return;
+
+   if (g_settings.video.dirty_rows && data && data != RETRO_HW_FRAME_BUFFER_VALID)
+   {
+      unsigned bpp = g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888 ? sizeof(uint32_t) : sizeof(uint16_t);
+      bool changed;
+
+      RARCH_PERFORMANCE_INIT(video_frame_hash);
+      RARCH_PERFORMANCE_START(video_frame_hash);
+      changed = rarch_dirty_rows_update(&g_extern.dirty_rows.hashes,
+            data, width, height, pitch, bpp, &dirty_first, &dirty_last);
+      RARCH_PERFORMANCE_STOP(video_frame_hash);
+
+      // Recording wants every frame, and some filters change their output every frame.
+      // A pipelined filter shows the change from the frame before on the dupe below.
+      if (!changed && !g_extern.rec &&
+            !(g_extern.filter.filter && rarch_softfilter_is_frame_dependent(g_extern.filter.filter)))
+         data = NULL; // Dupe.
+   }
+   else
+      rarch_dirty_rows_invalidate(&g_extern.dirty_rows.hashes);
+
    if (g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_0RGB1555 && data && data != RETRO_HW_FRAME_BUFFER_VALID)
    {
       RARCH_PERFORMANCE_INIT(video_frame_conv);
       RARCH_PERFORMANCE_START(video_frame_conv);
       driver.scaler.in_width = width;
-      driver.scaler.in_height = height;
+      driver.scaler.in_height = dirty_last - dirty_first;
       driver.scaler.out_width = width;
-      driver.scaler.out_height = height;
+      driver.scaler.out_height = dirty_last - dirty_first;
       driver.scaler.in_stride = pitch;
       driver.scaler.out_stride = width * sizeof(uint16_t);
 
-      scaler_ctx_scale(&driver.scaler, driver.scaler_out, data);
+      if (dirty_last > dirty_first)
+         scaler_ctx_scale(&driver.scaler,
+               (uint8_t*)driver.scaler_out + dirty_first * driver.scaler.out_stride,
+               (const uint8_t*)data + dirty_first * pitch);
       data = driver.scaler_out;
       pitch = driver.scaler.out_stride;
       RARCH_PERFORMANCE_STOP(video_frame_conv);
@@ -421,13 +580,119 @@ static void video_frame(const void *data, unsigned width, unsigned height, size_
 
    // Slightly messy code,
    // but we really need to do processing before blocking on VSync for best possible scheduling.
-   if (g_extern.rec && (!g_extern.filter.filter || !g_settings.video.post_filter_record || !data || g_extern.record_gpu_buffer))
+   if (g_extern.rec && (!g_extern.filter.filter || !g_settings.video.post_filter_record ||
+            (!data && !g_extern.filter.pending) || g_extern.record_gpu_buffer))
       recording_dump_frame(data, width, height, pitch);
 
    msg = msg_queue_pull(g_extern.msg_queue);
    driver.current_msg = msg;
 
-   if (g_extern.filter.filter && data)
+   if (g_extern.filter.filter && data && g_extern.filter.input_buffer)
+   {
+      unsigned owidth, oheight;
+      size_t opitch;
+      bool have_frame = g_extern.filter.pending;
+
+      RARCH_PERFORMANCE_INIT(softfilter_process);
+      RARCH_PERFORMANCE_START(softfilter_process);
+
+      // Collect the previous frame, then filter this one while the core runs the next.
+      rarch_softfilter_wait(g_extern.filter.filter);
+      if (have_frame)
+      {
+         void *tmp = g_extern.filter.buffer;
+         g_extern.filter.buffer = g_extern.filter.pending_buffer;
+         g_extern.filter.pending_buffer = tmp;
+      }
+
+      owidth = g_extern.filter.pending_width;
+      oheight = g_extern.filter.pending_height;
+      opitch = g_extern.filter.pending_pitch;
+
+      // The core is free to reuse its framebuffer, so filter from a copy.
+      // Clean rows are left over from the last copy.
+      // A frame rendered into input_spare is filtered where it is.
+      size_t row_size = width * g_extern.filter.in_bpp;
+      if (data == g_extern.filter.input_spare && pitch == row_size)
+      {
+         void *tmp = g_extern.filter.input_buffer;
+         g_extern.filter.input_buffer = g_extern.filter.input_spare;
+         g_extern.filter.input_spare = tmp;
+      }
+      else if (data != g_extern.filter.input_buffer || pitch != row_size)
+      {
+         const uint8_t *src = (const uint8_t*)data + dirty_first * pitch;
+         uint8_t *copy = (uint8_t*)g_extern.filter.input_buffer + dirty_first * row_size;
+         unsigned y;
+         for (y = dirty_first; y < dirty_last; y++, src += pitch, copy += row_size)
+            memcpy(copy, src, row_size);
+      }
+
+      rarch_softfilter_get_output_size(g_extern.filter.filter,
+            &g_extern.filter.pending_width, &g_extern.filter.pending_height, width, height);
+      g_extern.filter.pending_pitch = g_extern.filter.pending_width * g_extern.filter.out_bpp;
+
+      // pending_buffer holds the result from two frames ago,
+      // so it misses the changes of the last frame as well.
+      unsigned filter_first = dirty_first, filter_last = dirty_last;
+      video_frame_merge_rows(&filter_first, &filter_last,
+            g_extern.filter.dirty_first, g_extern.filter.dirty_last);
+      rarch_softfilter_set_dirty_rows(g_extern.filter.filter, filter_first, filter_last);
+      g_extern.filter.dirty_first = dirty_first;
+      g_extern.filter.dirty_last = dirty_last;
+
+      rarch_softfilter_process_async(g_extern.filter.filter,
+            g_extern.filter.pending_buffer, g_extern.filter.pending_pitch,
+            g_extern.filter.input_buffer, width, height, row_size);
+      g_extern.filter.pending = true;
+
+      // The frame shown now is the one filtered last time.
+      dirty_first = g_extern.filter.pending_first;
+      dirty_last = g_extern.filter.pending_last;
+      rarch_softfilter_get_processed_rows(g_extern.filter.filter,
+            &g_extern.filter.pending_first, &g_extern.filter.pending_last);
+      video_frame_scale_rows(&g_extern.filter.pending_first, &g_extern.filter.pending_last,
+            height, g_extern.filter.pending_height);
+
+      RARCH_PERFORMANCE_STOP(softfilter_process);
+
+      if (have_frame)
+      {
+         if (g_extern.rec && g_settings.video.post_filter_record)
+            recording_dump_frame(g_extern.filter.buffer, owidth, oheight, opitch);
+
+         data = g_extern.filter.buffer;
+         width = owidth;
+         height = oheight;
+         pitch = opitch;
+      }
+      else
+         data = NULL; // Nothing filtered yet, dupe.
+   }
+   else if (g_extern.filter.filter && !data && g_extern.filter.pending)
+   {
+      // Dupe while a frame is still being filtered. Show that one now,
+      // rather than the frame before it until the core sends another.
+      RARCH_PERFORMANCE_INIT(softfilter_process);
+      RARCH_PERFORMANCE_START(softfilter_process);
+      rarch_softfilter_wait(g_extern.filter.filter);
+      void *tmp = g_extern.filter.buffer;
+      g_extern.filter.buffer = g_extern.filter.pending_buffer;
+      g_extern.filter.pending_buffer = tmp;
+      g_extern.filter.pending = false;
+      RARCH_PERFORMANCE_STOP(softfilter_process);
+
+      data = g_extern.filter.buffer;
+      width = g_extern.filter.pending_width;
+      height = g_extern.filter.pending_height;
+      pitch = g_extern.filter.pending_pitch;
+      dirty_first = g_extern.filter.pending_first;
+      dirty_last = g_extern.filter.pending_last;
+
+      if (g_extern.rec && g_settings.video.post_filter_record)
+         recording_dump_frame(data, width, height, pitch);
+   }
+   else if (g_extern.filter.filter && data)
    {
       unsigned owidth, oheight, opitch = 0;
 
@@ -438,9 +703,12 @@ static void video_frame(const void *data, unsigned width, unsigned height, size_
 
       RARCH_PERFORMANCE_INIT(softfilter_process);
       RARCH_PERFORMANCE_START(softfilter_process);
+      rarch_softfilter_set_dirty_rows(g_extern.filter.filter, dirty_first, dirty_last);
       rarch_softfilter_process(g_extern.filter.filter,
             g_extern.filter.buffer, opitch,
             data, width, height, pitch);
+      rarch_softfilter_get_processed_rows(g_extern.filter.filter, &dirty_first, &dirty_last);
+      video_frame_scale_rows(&dirty_first, &dirty_last, height, oheight);
       RARCH_PERFORMANCE_STOP(softfilter_process);
 
       if (g_extern.rec && g_settings.video.post_filter_record)
@@ -452,8 +720,138 @@ static void video_frame(const void *data, unsigned width, unsigned height, size_
       pitch = opitch;
    }
 
+   g_extern.dirty_rows.first = dirty_first;
+   g_extern.dirty_rows.last = dirty_last;
+
+   block_start = frameskip_block_start();
    if (!video_frame_func(data, width, height, pitch, msg))
       g_extern.video_active = false;
+   frameskip_block_end(block_start);
+}
+
+static void video_frame(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+   // Frames come in through sw_fb_video_refresh() instead.
+   if (g_extern.sw_fb.enabled)
+      return;
+
+   video_frame_submit(data, width, height, pitch);
+}
+
+static unsigned sw_fb_bpp(void)
+{
+   return g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888 ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
+static bool sw_fb_set_format(void *ctx, enum retro_pixel_format pixel_format,
+      unsigned width, unsigned height)
+{
+   (void)ctx;
+
+   if (pixel_format != g_extern.system.pix_fmt ||
+         width > g_extern.sw_fb.max_width || height > g_extern.sw_fb.max_height)
+      return false;
+
+   g_extern.sw_fb.width = width;
+   g_extern.sw_fb.height = height;
+   g_extern.sw_fb.pitch = width * sw_fb_bpp();
+   return true;
+}
+
+// Lends the memory the frame would be copied into next, so that the copy goes away.
+// That is the input of a pipelined filter, or else the video driver's frame buffer.
+// Both only take frames as the core renders them, not converted ones.
+static bool sw_fb_get_current_addr(void *ctx, void **addr, size_t *pitch)
+{
+   size_t size = g_extern.sw_fb.pitch * g_extern.sw_fb.height;
+   bool native = g_extern.system.pix_fmt != RETRO_PIXEL_FORMAT_0RGB1555;
+   uint8_t *lent = NULL;
+   (void)ctx;
+
+   if (!g_extern.sw_fb.pitch)
+      return false;
+
+   if (g_extern.filter.input_buffer)
+   {
+      // The filter is busy with input_buffer until the core is done with the frame.
+      if (native && !g_extern.filter.input_spare)
+         g_extern.filter.input_spare = malloc(g_extern.filter.input_size);
+      if (native && size <= g_extern.filter.input_size)
+         lent = (uint8_t*)g_extern.filter.input_spare;
+   }
+   else if (native && !g_extern.filter.filter &&
+         driver.video_poke && driver.video_poke->get_frame_buffer && driver.video_data)
+      lent = (uint8_t*)driver.video_poke->get_frame_buffer(driver.video_data,
+            g_extern.sw_fb.height, g_extern.sw_fb.pitch);
+
+   if (!lent)
+   {
+      if (!g_extern.sw_fb.buffer)
+         g_extern.sw_fb.buffer = malloc(g_extern.sw_fb.max_width * g_extern.sw_fb.max_height * sizeof(uint32_t));
+      lent = (uint8_t*)g_extern.sw_fb.buffer;
+   }
+
+   if (!lent)
+      return false;
+
+   g_extern.sw_fb.lent = lent;
+   *addr = lent;
+   *pitch = g_extern.sw_fb.pitch;
+   return true;
+}
+
+static bool sw_fb_video_refresh(void *ctx, const struct retro_rectangle *rect)
+{
+   (void)ctx;
+
+   if (!rect)
+   {
+      video_frame_submit(NULL, g_extern.sw_fb.width, g_extern.sw_fb.height, g_extern.sw_fb.pitch);
+      return true;
+   }
+
+   if (!g_extern.sw_fb.lent ||
+         rect->x + rect->w > g_extern.sw_fb.width || rect->y + rect->h > g_extern.sw_fb.height)
+      return false;
+
+   video_frame_submit(g_extern.sw_fb.lent + rect->y * g_extern.sw_fb.pitch + rect->x * sw_fb_bpp(),
+         rect->w, rect->h, g_extern.sw_fb.pitch);
+   g_extern.sw_fb.lent = NULL;
+   return true;
+}
+
+bool rarch_sw_fb_config(struct retro_framebuffer_config *fb_cfg)
+{
+   if (!fb_cfg->max_width || !fb_cfg->max_height)
+   {
+      RARCH_LOG("Environ CONFIG_SOFTWARE_FRAMEBUFFER: disabled.\n");
+      memset(fb_cfg, 0, sizeof(*fb_cfg));
+      free(g_extern.sw_fb.buffer);
+      memset(&g_extern.sw_fb, 0, sizeof(g_extern.sw_fb));
+      return true;
+   }
+
+   // Frames have to be in memory, and netplay needs to see every one of them.
+   if (g_extern.system.hw_render_callback.context_type || g_extern.netplay_enable)
+      return false;
+
+   RARCH_LOG("Environ CONFIG_SOFTWARE_FRAMEBUFFER: %ux%u.\n", fb_cfg->max_width, fb_cfg->max_height);
+
+   free(g_extern.sw_fb.buffer);
+   memset(&g_extern.sw_fb, 0, sizeof(g_extern.sw_fb));
+   g_extern.sw_fb.enabled = true;
+   g_extern.sw_fb.max_width = fb_cfg->max_width;
+   g_extern.sw_fb.max_height = fb_cfg->max_height;
+
+   fb_cfg->framebuffer_context = &g_extern.sw_fb;
+   fb_cfg->set_format = sw_fb_set_format;
+   fb_cfg->get_current_addr = sw_fb_get_current_addr;
+   fb_cfg->video_refresh = sw_fb_video_refresh;
+
+   // Only the format frames are converted from. Set with SET_PIXEL_FORMAT beforehand.
+   fb_cfg->num_formats = 1;
+   fb_cfg->formats = &g_extern.system.pix_fmt;
+   return true;
 }
 
 void rarch_render_cached_frame()
@@ -470,7 +868,7 @@ void rarch_render_cached_frame()
    // Not 100% safe, since the library might have
    // freed the memory, but no known implementations do this :D
    // It would be really stupid at any rate ...
-   video_frame(frame,
+   video_frame_submit(frame,
          g_extern.frame_cache.width,
          g_extern.frame_cache.height,
          g_extern.frame_cache.pitch);
@@ -501,6 +899,11 @@ static bool audio_flush(const int16_t *data, size_t samples)
    if (!g_extern.audio_active)
       return false;
 
+   // Frames fast forward does not show are not heard either.
+   // Dropping them here saves the DSP and resampler the work.
+   if (g_extern.frameskip.skip && driver.nonblock_state)
+      return true;
+
    RARCH_PERFORMANCE_INIT(audio_convert_s16);
    RARCH_PERFORMANCE_START(audio_convert_s16);
    audio_convert_s16_to_float(g_extern.audio_data.data, data, samples,
@@ -551,11 +954,13 @@ static bool audio_flush(const int16_t *data, size_t samples)
       output_size = sizeof(int16_t);
    }
 
+   retro_time_t block_start = frameskip_block_start();
    if (audio_write_func(output_data, output_frames * output_size * 2) < 0)
    {
       RARCH_ERR("Audio backend failed to write. Will continue without sound.\n");
       return false;
    }
+   frameskip_block_end(block_start);
 
    return true;
 }
@@ -2724,6 +3129,9 @@ static void main_deinit_core()
    pretro_unload_game();
    pretro_deinit();
    uninit_libretro_sym();
+
+   free(g_extern.sw_fb.buffer);
+   memset(&g_extern.sw_fb, 0, sizeof(g_extern.sw_fb));
 }
 
 int rarch_main_init(int argc, char *argv[])
@@ -2863,26 +3271,91 @@ static inline void update_frame_time()
    g_extern.system.frame_time.callback(delta);
 }
 
+// Decides whether the frame the core is about to run gets shown.
+// Every frame which takes longer than the frame rate allows adds to a debt,
+// and frames are skipped while the debt is larger than half a frame.
+// Only work counts. Waiting for vsync or audio paces frames to the display
+// or the audio device, which dynamic rate control lets differ from the core's frame rate.
+static inline void update_frameskip()
+{
+   retro_time_t current = rarch_get_time_usec();
+   retro_time_t budget = (retro_time_t)roundf(1000000.0f / g_extern.system.av_info.timing.fps);
+   retro_time_t work;
+
+   // Fast forward only shows frames as fast as the display can.
+   if (driver.nonblock_state && g_settings.fastforward_decimate && !g_extern.rec)
+   {
+      retro_time_t interval = (retro_time_t)roundf(1000000.0f / g_settings.video.refresh_rate);
+
+      g_extern.frameskip.skip = current - g_extern.frameskip.shown < interval;
+      if (!g_extern.frameskip.skip)
+         g_extern.frameskip.shown = current;
+
+      g_extern.frameskip.debt = 0;
+      g_extern.frameskip.skipped = 0;
+      g_extern.frameskip.last = 0;
+      g_extern.frameskip.blocked = 0;
+      return;
+   }
+
+   // Fast forward and slowmotion are off the frame rate on purpose, and recording wants every frame.
+   if (!g_settings.video.auto_frameskip || driver.nonblock_state ||
+         g_extern.is_slowmotion || g_extern.rec || !g_extern.frameskip.last)
+   {
+      g_extern.frameskip.debt = 0;
+      g_extern.frameskip.skipped = 0;
+      g_extern.frameskip.last = g_settings.video.auto_frameskip ? current : 0;
+      g_extern.frameskip.blocked = 0;
+      return;
+   }
+
+   work = current - g_extern.frameskip.last - g_extern.frameskip.blocked;
+   g_extern.frameskip.last = current;
+   g_extern.frameskip.blocked = 0;
+
+   // A stall, e.g. loading or the menu, is not worth seconds of skipped frames.
+   if (work > 4 * budget)
+      g_extern.frameskip.debt = 0;
+   else
+      g_extern.frameskip.debt += work - budget;
+
+   if (g_extern.frameskip.debt < 0)
+      g_extern.frameskip.debt = 0;
+   else if (g_extern.frameskip.debt > 4 * budget)
+      g_extern.frameskip.debt = 4 * budget;
+
+   g_extern.frameskip.skip = g_extern.frameskip.debt > budget / 2 &&
+      g_extern.frameskip.skipped < g_settings.video.auto_frameskip;
+   g_extern.frameskip.skipped = g_extern.frameskip.skip ? g_extern.frameskip.skipped + 1 : 0;
+}
+
 static inline void limit_frame_time()
 {
-   retro_time_t current = 0, target = 0, to_sleep_ms = 0;
+   retro_time_t current = 0, target = 0;
 
    if (g_settings.fastforward_ratio < 0.0f)
       return;
 
+   RARCH_JITTER_INIT(limit_frame_time_jitter);
+
    g_extern.frame_limit.minimum_frame_time = (retro_time_t)roundf(1000000.0f / (g_extern.system.av_info.timing.fps * g_settings.fastforward_ratio));
 
    current = rarch_get_time_usec();
    target = g_extern.frame_limit.last_frame_time + g_extern.frame_limit.minimum_frame_time;
-   to_sleep_ms = (target - current) / 1000;
 
-   if (to_sleep_ms > 0)
+   if (target > current)
    {
-      rarch_sleep((unsigned int)to_sleep_ms);
-      g_extern.frame_limit.last_frame_time += g_extern.frame_limit.minimum_frame_time; // Combat jitter a bit.
+      // Frames are due at fixed intervals, however long waking up took last time.
+      retro_time_t block_start = frameskip_block_start();
+      rarch_sleep_until(target, g_settings.frame_limit_spin);
+      frameskip_block_end(block_start);
+      g_extern.frame_limit.last_frame_time = target;
    }
    else
-      g_extern.frame_limit.last_frame_time = rarch_get_time_usec();
+      g_extern.frame_limit.last_frame_time = current;
+
+   rarch_jitter_update(&limit_frame_time_jitter, rarch_get_time_usec(),
+         g_extern.frame_limit.minimum_frame_time);
 }
 
 //TODO - can we refactor command.c to do this? Should be local and not
@@ -3027,6 +3500,7 @@ bool rarch_main_iterate()
    {
       rarch_input_poll();
       rarch_sleep(10);
+      g_extern.frameskip.last = 0;
       return true;
    }
 
@@ -3051,7 +3525,9 @@ bool rarch_main_iterate()
    }
 
    update_frame_time();
+   update_frameskip();
    pretro_run();
+   g_extern.frameskip.skip = false;
    limit_frame_time();
 
    for (i = 0; i < MAX_PLAYERS; i++)
@@ -3117,6 +3593,7 @@ void rarch_main_deinit()
 #endif
 
    deinit_recording();
+   screenshot_deinit();
 
    save_files();
 
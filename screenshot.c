@@ -22,6 +22,8 @@
 #include "general.h"
 #include "file.h"
 #include "gfx/scaler/scaler.h"
+#include "performance.h"
+#include "thread.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -58,12 +60,6 @@ static bool write_header_bmp(FILE *file, unsigned width, unsigned height)
    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
 }
 
-static void dump_lines_file(FILE *file, uint8_t **lines, size_t line_size, unsigned height)
-{
-   for (unsigned i = 0; i < height; i++)
-      fwrite(lines[i], 1, line_size, file);
-}
-
 static void dump_line_bgr(uint8_t *line, const uint8_t *src, unsigned width)
 {
    memcpy(line, src, width * 3);
@@ -95,9 +91,9 @@ static void dump_line_32(uint8_t *line, const uint32_t *src, unsigned width)
 }
 
 static void dump_content(FILE *file, const void *frame,
-      int width, int height, int pitch, bool bgr24)
+      int width, int height, int pitch, bool bgr24, enum retro_pixel_format pix_fmt)
 {
-   int i, j;
+   int j;
    union
    {
       const uint8_t *u8;
@@ -106,60 +102,34 @@ static void dump_content(FILE *file, const void *frame,
    } u;
    u.u8 = frame;
 
-   uint8_t **lines = calloc(height, sizeof(uint8_t*));
-   if (!lines)
-      return;
-
+   // Lines are converted one by one into the same buffer. Padding stays zero.
    size_t line_size = (width * 3 + 3) & ~3;
+   uint8_t *line = calloc(1, line_size);
+   if (!line)
+      return;
 
-   for (i = 0; i < height; i++)
+   for (j = 0; j < height; j++, u.u8 += pitch)
    {
-      lines[i] = calloc(1, line_size);
-      if (!lines[i])
-         goto end;
-   }
+      if (bgr24) // BGR24 byte order. Can directly copy.
+         dump_line_bgr(line, u.u8, width);
+      else if (pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
+         dump_line_32(line, u.u32, width);
+      else // RGB565
+         dump_line_16(line, u.u16, width);
 
-   if (bgr24) // BGR24 byte order. Can directly copy.
-   {
-      for (j = 0; j < height; j++, u.u8 += pitch)
-         dump_line_bgr(lines[j], u.u8, width);
-   }
-   else if (g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
-   {
-      for (j = 0; j < height; j++, u.u8 += pitch)
-         dump_line_32(lines[j], u.u32, width);
+      fwrite(line, 1, line_size, file);
    }
-   else // RGB565
-   {
-      for (j = 0; j < height; j++, u.u8 += pitch)
-         dump_line_16(lines[j], u.u16, width);
-   }
-
-   dump_lines_file(file, lines, line_size, height);
 
-end:
-   for (i = 0; i < height; i++)
-      free(lines[i]);
-   free(lines);
+   free(line);
 }
 #endif
 
 // Take frame bottom-up.
-bool screenshot_dump(const char *folder, const void *frame,
-      unsigned width, unsigned height, int pitch, bool bgr24)
+// PNG encoding runs on the workers of pool as well, if there is one.
+static bool screenshot_write(const char *filename, const void *frame,
+      unsigned width, unsigned height, int pitch, bool bgr24, enum retro_pixel_format pix_fmt,
+      sthread_pool_t *pool)
 {
-   char filename[PATH_MAX];
-   char shotname[PATH_MAX];
-
-#ifdef HAVE_ZLIB_DEFLATE
-#define IMG_EXT "png"
-#else
-#define IMG_EXT "bmp"
-#endif
-
-   fill_dated_filename(shotname, IMG_EXT, sizeof(shotname));
-   fill_pathname_join(filename, folder, shotname, sizeof(filename));
-
 #ifdef HAVE_ZLIB_DEFLATE
    uint8_t *out_buffer = malloc(width * height * 3);
    if (!out_buffer)
@@ -174,10 +144,11 @@ bool screenshot_dump(const char *folder, const void *frame,
    scaler.out_stride = width * 3;
    scaler.out_fmt = SCALER_FMT_BGR24;
    scaler.scaler_type = SCALER_TYPE_POINT;
+   scaler.threads = rarch_get_cpu_cores();
 
    if (bgr24)
       scaler.in_fmt = SCALER_FMT_BGR24;
-   else if (g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
+   else if (pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
       scaler.in_fmt = SCALER_FMT_ARGB8888;
    else
       scaler.in_fmt = SCALER_FMT_RGB565;
@@ -187,7 +158,7 @@ bool screenshot_dump(const char *folder, const void *frame,
    scaler_ctx_gen_reset(&scaler);
 
    RARCH_LOG("Using RPNG for PNG screenshots.\n");
-   bool ret = rpng_save_image_bgr24(filename, out_buffer, width, height, width * 3);
+   bool ret = rpng_save_image_bgr24(filename, out_buffer, width, height, width * 3, pool);
    if (!ret)
       RARCH_ERR("Failed to take screenshot.\n");
    free(out_buffer);
@@ -203,7 +174,7 @@ bool screenshot_dump(const char *folder, const void *frame,
    bool ret = write_header_bmp(file, width, height);
 
    if (ret)
-      dump_content(file, frame, width, height, pitch, bgr24);
+      dump_content(file, frame, width, height, pitch, bgr24, pix_fmt);
    else
       RARCH_ERR("Failed to write image header.\n");
 
@@ -212,3 +183,210 @@ bool screenshot_dump(const char *folder, const void *frame,
 #endif
 }
 
+#if defined(HAVE_THREADS)
+// Screenshots are encoded and written by a thread of their own,
+// as PNG encoding in particular takes long enough to make the content hitch.
+// The frame is copied into one of a few buffers which are kept around.
+// If all of them are still waiting to be written, the screenshot is dropped rather than waited for.
+#define SCREENSHOT_QUEUE_SIZE 4
+
+struct screenshot_job
+{
+   char filename[PATH_MAX];
+   uint8_t *buffer;
+   size_t capacity;
+   unsigned width;
+   unsigned height;
+   int pitch;
+   bool bgr24;
+   enum retro_pixel_format pix_fmt;
+};
+
+static struct
+{
+   sthread_t *thread;
+   slock_t *lock;
+   scond_t *cond;
+   bool quit;
+
+   // Workers which help the screenshot thread encode, kept around between screenshots.
+   sthread_pool_t *pool;
+
+   struct screenshot_job jobs[SCREENSHOT_QUEUE_SIZE];
+   unsigned first; // Job being written, or next to be.
+   unsigned count; // Jobs queued, including the one being written.
+} screenshot_queue;
+
+static void screenshot_thread(void *data)
+{
+   (void)data;
+
+   for (;;)
+   {
+      struct screenshot_job *job;
+
+      slock_lock(screenshot_queue.lock);
+      while (!screenshot_queue.count && !screenshot_queue.quit)
+         scond_wait(screenshot_queue.cond, screenshot_queue.lock);
+
+      // Whatever was queued gets written before quitting.
+      if (!screenshot_queue.count)
+      {
+         slock_unlock(screenshot_queue.lock);
+         break;
+      }
+
+      job = &screenshot_queue.jobs[screenshot_queue.first];
+      slock_unlock(screenshot_queue.lock);
+
+      // The job stays counted until it is written, so its buffer is not handed out meanwhile.
+      screenshot_write(job->filename, job->buffer, job->width, job->height,
+            job->pitch, job->bgr24, job->pix_fmt, screenshot_queue.pool);
+
+      slock_lock(screenshot_queue.lock);
+      screenshot_queue.first = (screenshot_queue.first + 1) % SCREENSHOT_QUEUE_SIZE;
+      screenshot_queue.count--;
+      slock_unlock(screenshot_queue.lock);
+   }
+}
+
+static bool screenshot_queue_init(void)
+{
+   if (screenshot_queue.thread)
+      return true;
+
+   screenshot_queue.quit = false;
+   screenshot_queue.lock = slock_new();
+   screenshot_queue.cond = scond_new();
+   if (!screenshot_queue.lock || !screenshot_queue.cond)
+      goto error;
+
+#ifdef HAVE_ZLIB_DEFLATE
+   // Without the pool, screenshots are encoded by the screenshot thread alone.
+   if (rarch_get_cpu_cores() > 1)
+      screenshot_queue.pool = sthread_pool_new(rarch_get_cpu_cores() - 1, false);
+#endif
+
+   screenshot_queue.thread = sthread_create(screenshot_thread, NULL);
+   if (!screenshot_queue.thread)
+      goto error;
+
+   return true;
+
+error:
+   RARCH_WARN("Failed to start screenshot thread. Writing screenshots right away.\n");
+   screenshot_deinit();
+   return false;
+}
+
+// Copies the frame into a free job. Returns false if there is none.
+static bool screenshot_queue_push(const char *filename, const void *frame,
+      unsigned width, unsigned height, int pitch, bool bgr24)
+{
+   struct screenshot_job *job;
+   unsigned bpp, index;
+   size_t line_size, size;
+   const uint8_t *src = (const uint8_t*)frame;
+   unsigned y;
+
+   slock_lock(screenshot_queue.lock);
+   index = (screenshot_queue.first + screenshot_queue.count) % SCREENSHOT_QUEUE_SIZE;
+   bool full = screenshot_queue.count == SCREENSHOT_QUEUE_SIZE;
+   slock_unlock(screenshot_queue.lock);
+
+   if (full)
+   {
+      RARCH_WARN("Still writing earlier screenshots. Dropping this one.\n");
+      return false;
+   }
+
+   // Only we queue jobs, so the free one stays ours until we count it in.
+   job = &screenshot_queue.jobs[index];
+
+   if (bgr24)
+      bpp = 3;
+   else if (g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
+      bpp = sizeof(uint32_t);
+   else
+      bpp = sizeof(uint16_t);
+
+   line_size = width * bpp;
+   size = line_size * height;
+   if (size > job->capacity)
+   {
+      uint8_t *buffer = (uint8_t*)realloc(job->buffer, size);
+      if (!buffer)
+         return false;
+      job->buffer = buffer;
+      job->capacity = size;
+   }
+
+   // Keeps the lines in the order they come in, so the copy is bottom-up as well.
+   for (y = 0; y < height; y++, src += pitch)
+      memcpy(job->buffer + y * line_size, src, line_size);
+
+   strlcpy(job->filename, filename, sizeof(job->filename));
+   job->width = width;
+   job->height = height;
+   job->pitch = line_size;
+   job->bgr24 = bgr24;
+   job->pix_fmt = g_extern.system.pix_fmt;
+
+   slock_lock(screenshot_queue.lock);
+   screenshot_queue.count++;
+   scond_signal(screenshot_queue.cond);
+   slock_unlock(screenshot_queue.lock);
+   return true;
+}
+#endif
+
+// Take frame bottom-up.
+bool screenshot_dump(const char *folder, const void *frame,
+      unsigned width, unsigned height, int pitch, bool bgr24)
+{
+   char filename[PATH_MAX];
+   char shotname[PATH_MAX];
+
+#ifdef HAVE_ZLIB_DEFLATE
+#define IMG_EXT "png"
+#else
+#define IMG_EXT "bmp"
+#endif
+
+   fill_dated_filename(shotname, IMG_EXT, sizeof(shotname));
+   fill_pathname_join(filename, folder, shotname, sizeof(filename));
+
+#if defined(HAVE_THREADS)
+   if (screenshot_queue_init())
+      return screenshot_queue_push(filename, frame, width, height, pitch, bgr24);
+#endif
+
+   return screenshot_write(filename, frame, width, height, pitch, bgr24, g_extern.system.pix_fmt, NULL);
+}
+
+void screenshot_deinit(void)
+{
+#if defined(HAVE_THREADS)
+   unsigned i;
+
+   if (screenshot_queue.thread)
+   {
+      slock_lock(screenshot_queue.lock);
+      screenshot_queue.quit = true;
+      scond_signal(screenshot_queue.cond);
+      slock_unlock(screenshot_queue.lock);
+      sthread_join(screenshot_queue.thread);
+   }
+
+   sthread_pool_free(screenshot_queue.pool);
+
+   if (screenshot_queue.lock)
+      slock_free(screenshot_queue.lock);
+   if (screenshot_queue.cond)
+      scond_free(screenshot_queue.cond);
+
+   for (i = 0; i < SCREENSHOT_QUEUE_SIZE; i++)
+      free(screenshot_queue.jobs[i].buffer);
+   memset(&screenshot_queue, 0, sizeof(screenshot_queue));
+#endif
+}
@@ -20,9 +20,14 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+// With threads, the frame is copied, and encoded and written in the background.
+// Returns false if that could not even be started.
 bool screenshot_dump(const char *folder, const void *frame, 
       unsigned width, unsigned height, int pitch, bool bgr24);
 
+// Writes out screenshots still in the queue, and stops the screenshot thread.
+void screenshot_deinit(void);
+
 void screenshot_generate_filename(char *filename, size_t size);
 
 #endif
@@ -157,6 +157,7 @@ void config_set_defaults()
    g_settings.video.vsync = vsync;
    g_settings.video.hard_sync = hard_sync;
    g_settings.video.hard_sync_frames = hard_sync_frames;
+   g_settings.video.auto_frameskip = auto_frameskip;
    g_settings.video.black_frame_insertion = black_frame_insertion;
    g_settings.video.swap_interval = swap_interval;
    g_settings.video.threaded = video_threaded;
@@ -190,7 +191,10 @@ void config_set_defaults()
       g_settings.video.refresh_rate = g_defaults.settings.video_refresh_rate;
 
    g_settings.video.post_filter_record = post_filter_record;
+   g_settings.video.filter_async = video_filter_async;
+   g_settings.video.dirty_rows = video_dirty_rows;
    g_settings.video.gpu_record = gpu_record;
+   g_settings.video.record_dupe_detect = record_dupe_detect;
    g_settings.video.gpu_screenshot = gpu_screenshot;
    g_settings.video.rotation = ORIENTATION_NORMAL;
 
@@ -206,8 +210,10 @@ void config_set_defaults()
 
    g_settings.audio.latency = g_defaults.settings.out_latency;
    g_settings.audio.sync = audio_sync;
+   g_settings.audio.mmap = audio_mmap;
    g_settings.audio.rate_control = rate_control;
    g_settings.audio.rate_control_delta = rate_control_delta;
+   g_settings.audio.rate_control_integral = rate_control_integral;
    g_settings.audio.volume = audio_volume;
    g_extern.audio_data.volume_db   = g_settings.audio.volume;
    g_extern.audio_data.volume_gain = db_to_gain(g_settings.audio.volume);
@@ -217,6 +223,8 @@ void config_set_defaults()
    g_settings.rewind_granularity = rewind_granularity;
    g_settings.slowmotion_ratio = slowmotion_ratio;
    g_settings.fastforward_ratio = fastforward_ratio;
+   g_settings.fastforward_decimate = fastforward_decimate;
+   g_settings.frame_limit_spin = frame_limit_spin;
    g_settings.pause_nonactive = pause_nonactive;
    g_settings.autosave_interval = autosave_interval;
 
@@ -573,6 +581,8 @@ bool config_load_file(const char *path, bool set_defaults)
    if (g_settings.video.hard_sync_frames > 3)
       g_settings.video.hard_sync_frames = 3;
 
+   CONFIG_GET_INT(video.auto_frameskip, "video_auto_frameskip");
+
    CONFIG_GET_BOOL(video.black_frame_insertion, "video_black_frame_insertion");
    CONFIG_GET_INT(video.swap_interval, "video_swap_interval");
    g_settings.video.swap_interval = max(g_settings.video.swap_interval, 1);
@@ -616,11 +626,14 @@ bool config_load_file(const char *path, bool set_defaults)
 
    CONFIG_GET_BOOL(video.post_filter_record, "video_post_filter_record");
    CONFIG_GET_BOOL(video.gpu_record, "video_gpu_record");
+   CONFIG_GET_BOOL(video.record_dupe_detect, "video_record_dupe_detect");
    CONFIG_GET_BOOL(video.gpu_screenshot, "video_gpu_screenshot");
 
 #ifdef HAVE_DYLIB
    CONFIG_GET_PATH(video.filter_path, "video_filter");
 #endif
+   CONFIG_GET_BOOL(video.filter_async, "video_filter_async");
+   CONFIG_GET_BOOL(video.dirty_rows, "video_dirty_rows");
 
    CONFIG_GET_PATH(video.shader_dir, "video_shader_dir");
    if (!strcmp(g_settings.video.shader_dir, "default"))
@@ -660,8 +673,10 @@ bool config_load_file(const char *path, bool set_defaults)
    CONFIG_GET_STRING(audio.device, "audio_device");
    CONFIG_GET_INT(audio.latency, "audio_latency");
    CONFIG_GET_BOOL(audio.sync, "audio_sync");
+   CONFIG_GET_BOOL(audio.mmap, "audio_mmap");
    CONFIG_GET_BOOL(audio.rate_control, "audio_rate_control");
    CONFIG_GET_FLOAT(audio.rate_control_delta, "audio_rate_control_delta");
+   CONFIG_GET_FLOAT(audio.rate_control_integral, "audio_rate_control_integral");
    CONFIG_GET_FLOAT(audio.volume, "audio_volume");
    CONFIG_GET_STRING(audio.resampler, "audio_resampler");
    g_extern.audio_data.volume_db   = g_settings.audio.volume;
@@ -742,6 +757,8 @@ bool config_load_file(const char *path, bool set_defaults)
       g_settings.slowmotion_ratio = 1.0f;
 
    CONFIG_GET_FLOAT(fastforward_ratio, "fastforward_ratio");
+   CONFIG_GET_BOOL(fastforward_decimate, "fastforward_decimate");
+   CONFIG_GET_INT(frame_limit_spin, "frame_limit_spin");
 
    CONFIG_GET_BOOL(pause_nonactive, "pause_nonactive");
    CONFIG_GET_INT(autosave_interval, "autosave_interval");
@@ -1039,6 +1056,8 @@ bool config_save_file(const char *path)
    config_set_bool(conf,  "video_scale_integer", g_settings.video.scale_integer);
    config_set_bool(conf,  "video_smooth", g_settings.video.smooth);
    config_set_bool(conf,  "video_threaded", g_settings.video.threaded);
+   config_set_bool(conf,  "video_filter_async", g_settings.video.filter_async);
+   config_set_bool(conf,  "video_dirty_rows", g_settings.video.dirty_rows);
    config_set_bool(conf,  "video_shared_context", g_settings.video.shared_context);
    config_set_bool(conf,  "video_fullscreen", g_settings.video.fullscreen);
    config_set_float(conf, "video_refresh_rate", g_settings.video.refresh_rate);
@@ -1050,6 +1069,7 @@ bool config_save_file(const char *path)
    config_set_bool(conf,  "video_vsync", g_settings.video.vsync);
    config_set_bool(conf,  "video_hard_sync", g_settings.video.hard_sync);
    config_set_int(conf,   "video_hard_sync_frames", g_settings.video.hard_sync_frames);
+   config_set_int(conf,   "video_auto_frameskip", g_settings.video.auto_frameskip);
    config_set_bool(conf,  "video_black_frame_insertion", g_settings.video.black_frame_insertion);
    config_set_bool(conf,  "pause_nonactive", g_settings.pause_nonactive);
    config_set_int(conf, "video_swap_interval", g_settings.video.swap_interval);
@@ -1059,8 +1079,10 @@ bool config_save_file(const char *path)
    config_set_int(conf, "aspect_ratio_index", g_settings.video.aspect_ratio_idx);
    config_set_string(conf, "audio_device", g_settings.audio.device);
    config_set_string(conf, "audio_dsp_plugin", g_settings.audio.dsp_plugin);
+   config_set_bool(conf, "audio_mmap", g_settings.audio.mmap);
    config_set_bool(conf, "audio_rate_control", g_settings.audio.rate_control);
    config_set_float(conf, "audio_rate_control_delta", g_settings.audio.rate_control_delta);
+   config_set_float(conf, "audio_rate_control_integral", g_settings.audio.rate_control_integral);
    config_set_string(conf, "audio_driver", g_settings.audio.driver);
    config_set_bool(conf, "audio_enable", g_settings.audio.enable);
    config_set_int(conf, "audio_out_rate", g_settings.audio.out_rate);
@@ -1107,6 +1129,8 @@ bool config_save_file(const char *path)
    config_set_bool(conf, "savestate_auto_load", g_settings.savestate_auto_load);
 
    config_set_float(conf, "fastforward_ratio", g_settings.fastforward_ratio);
+   config_set_bool(conf, "fastforward_decimate", g_settings.fastforward_decimate);
+   config_set_int(conf, "frame_limit_spin", g_settings.frame_limit_spin);
    config_set_float(conf, "slowmotion_ratio", g_settings.slowmotion_ratio);
 
    // g_extern
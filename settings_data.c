@@ -810,6 +810,8 @@ static void general_read_handler(const void *data)
             g_settings.audio.rate_control_delta = *setting->value.fraction;
         }
     }
+    else if (!strcmp(setting->name, "audio_rate_control_integral"))
+       *setting->value.fraction = g_settings.audio.rate_control_integral;
     else if (!strcmp(setting->name, "audio_out_rate"))
         *setting->value.unsigned_integer = g_settings.audio.out_rate;
     else if (!strcmp(setting->name, "input_autodetect_enable"))
@@ -1069,6 +1071,8 @@ static void general_write_handler(const void *data)
          g_settings.audio.rate_control_delta = *setting->value.fraction;
       }
    }
+   else if (!strcmp(setting->name, "audio_rate_control_integral"))
+      g_settings.audio.rate_control_integral = *setting->value.fraction;
    else if (!strcmp(setting->name, "audio_out_rate"))
       g_settings.audio.out_rate = *setting->value.unsigned_integer;
    else if (!strcmp(setting->name, "input_autodetect_enable"))
@@ -1472,6 +1476,7 @@ rarch_setting_t* setting_data_get_list()
          CONFIG_BOOL(g_settings.audio.sync,                 "audio_sync",                 "Audio Sync Enable",                audio_sync, GROUP_NAME, SUBGROUP_NAME, general_write_handler, general_read_handler)
          CONFIG_UINT(g_settings.audio.latency,              "audio_latency",              "Audio Latency",                    g_defaults.settings.out_latency ? g_defaults.settings.out_latency : out_latency, GROUP_NAME, SUBGROUP_NAME, general_write_handler, general_read_handler)
          CONFIG_FLOAT(g_settings.audio.rate_control_delta,  "audio_rate_control_delta",   "Audio Rate Control Delta",         rate_control_delta, GROUP_NAME, SUBGROUP_NAME, general_write_handler, general_read_handler) WITH_RANGE(0, 0, 0.001, true, false)
+         CONFIG_FLOAT(g_settings.audio.rate_control_integral, "audio_rate_control_integral", "Audio Rate Control Integral", rate_control_integral, GROUP_NAME, SUBGROUP_NAME, general_write_handler, general_read_handler) WITH_RANGE(0, 1, 0.001, true, true)
          CONFIG_UINT(g_settings.audio.block_frames,         "audio_block_frames",         "Block Frames",               0, GROUP_NAME, SUBGROUP_NAME, general_write_handler, general_read_handler)
          END_SUB_GROUP()
 
@@ -173,6 +173,12 @@ bool scond_wait_timeout(scond_t *cond, slock_t *lock, int64_t timeout_us)
 
    now.tv_sec += seconds;
    now.tv_nsec += remainder * 1000LL;
+   // pthread_cond_timedwait() fails right away on an unnormalized timespec.
+   if (now.tv_nsec >= 1000000000L)
+   {
+      now.tv_sec++;
+      now.tv_nsec -= 1000000000L;
+   }
 
    ret = pthread_cond_timedwait(&cond->cond, &lock->lock, &now);
    return (ret == 0);
@@ -182,3 +188,206 @@ void scond_signal(scond_t *cond)
 {
    pthread_cond_signal(&cond->cond);
 }
+
+// Number of polls before a thread gives up spinning and goes to sleep.
+// Jobs such as filter tiles finish within microseconds, so most frames complete within the spin.
+#define POOL_SPIN_COUNT 4096
+
+#if defined(__i386__) || defined(__x86_64__)
+#define pool_cpu_relax() __builtin_ia32_pause()
+#else
+#define pool_cpu_relax() __sync_synchronize()
+#endif
+
+// New jobs are published by bumping the generation counter, after which every worker
+// claims job after job through an atomic counter until none are left.
+// Workers rather than jobs are counted when they finish, so no worker still claims
+// jobs of one generation once the caller has moved on to the next.
+// Both sides spin briefly before sleeping, and the lock/condition pair
+// is only touched when the other side has announced that it is sleeping.
+struct sthread_pool
+{
+   volatile unsigned generation;
+   volatile unsigned pending;
+   volatile unsigned next_job;
+   volatile unsigned sleeping_workers;
+   volatile unsigned sleeping_caller;
+   volatile bool die;
+   unsigned spin_count;
+
+   slock_t *lock;
+   scond_t *work_cond;
+   scond_t *done_cond;
+
+   sthread_t **threads;
+   unsigned workers;
+
+   sthread_pool_job_t job;
+   void *userdata;
+   unsigned num_jobs;
+};
+
+// Returns true if *val changed from 'old' within the spin period.
+// Polls are plain loads, so that spinning does not bounce the cache line around.
+// Once a change is seen, the atomic load orders everything after it behind the write.
+static bool pool_spin_changed(const sthread_pool_t *pool, volatile unsigned *val, unsigned old)
+{
+   unsigned i;
+   for (i = 0; i < pool->spin_count; i++)
+   {
+      if (*val != old)
+         return satomic_load(val) != old;
+      pool_cpu_relax();
+   }
+   return false;
+}
+
+// Returns true if *val reached zero within the spin period.
+static bool pool_spin_zero(const sthread_pool_t *pool, volatile unsigned *val)
+{
+   unsigned i;
+   for (i = 0; i < pool->spin_count; i++)
+   {
+      if (!*val)
+         return !satomic_load(val);
+      pool_cpu_relax();
+   }
+   return false;
+}
+
+static void pool_thread_loop(void *data)
+{
+   sthread_pool_t *pool = data;
+   unsigned generation = 0;
+
+   for (;;)
+   {
+      if (!pool_spin_changed(pool, &pool->generation, generation))
+      {
+         slock_lock(pool->lock);
+         satomic_add(&pool->sleeping_workers, 1);
+         while (satomic_load(&pool->generation) == generation && !pool->die)
+            scond_wait(pool->work_cond, pool->lock);
+         satomic_add(&pool->sleeping_workers, -1);
+         slock_unlock(pool->lock);
+      }
+
+      if (pool->die)
+         break;
+      generation = satomic_load(&pool->generation);
+      sthread_pool_help(pool);
+
+      if (satomic_add(&pool->pending, -1) == 0 &&
+            satomic_load(&pool->sleeping_caller))
+      {
+         slock_lock(pool->lock);
+         scond_signal(pool->done_cond);
+         slock_unlock(pool->lock);
+      }
+   }
+}
+
+sthread_pool_t *sthread_pool_new(unsigned workers, bool spin)
+{
+   unsigned i;
+   sthread_pool_t *pool = calloc(1, sizeof(*pool));
+   if (!pool)
+      return NULL;
+
+   pool->spin_count = spin ? POOL_SPIN_COUNT : 0;
+   pool->lock = slock_new();
+   pool->work_cond = scond_new();
+   pool->done_cond = scond_new();
+   pool->threads = calloc(workers ? workers : 1, sizeof(*pool->threads));
+   if (!pool->lock || !pool->work_cond || !pool->done_cond || !pool->threads)
+      goto error;
+
+   for (i = 0; i < workers; i++)
+   {
+      pool->threads[i] = sthread_create(pool_thread_loop, pool);
+      if (!pool->threads[i])
+         goto error;
+      pool->workers++;
+   }
+
+   return pool;
+
+error:
+   sthread_pool_free(pool);
+   return NULL;
+}
+
+void sthread_pool_free(sthread_pool_t *pool)
+{
+   unsigned i;
+   if (!pool)
+      return;
+
+   if (pool->workers)
+   {
+      slock_lock(pool->lock);
+      pool->die = true;
+      scond_broadcast(pool->work_cond);
+      slock_unlock(pool->lock);
+
+      for (i = 0; i < pool->workers; i++)
+         sthread_join(pool->threads[i]);
+   }
+   free(pool->threads);
+
+   if (pool->lock)
+      slock_free(pool->lock);
+   if (pool->work_cond)
+      scond_free(pool->work_cond);
+   if (pool->done_cond)
+      scond_free(pool->done_cond);
+   free(pool);
+}
+
+unsigned sthread_pool_workers(const sthread_pool_t *pool)
+{
+   return pool->workers;
+}
+
+void sthread_pool_start(sthread_pool_t *pool, sthread_pool_job_t job, void *userdata, unsigned num_jobs)
+{
+   pool->job = job;
+   pool->userdata = userdata;
+   pool->num_jobs = num_jobs;
+   pool->next_job = 0;
+   pool->pending = pool->workers;
+   satomic_add(&pool->generation, 1);
+   if (satomic_load(&pool->sleeping_workers))
+   {
+      slock_lock(pool->lock);
+      scond_broadcast(pool->work_cond);
+      slock_unlock(pool->lock);
+   }
+}
+
+void sthread_pool_help(sthread_pool_t *pool)
+{
+   unsigned i;
+   while ((i = satomic_add(&pool->next_job, 1) - 1) < pool->num_jobs)
+      pool->job(pool->userdata, i);
+}
+
+void sthread_pool_wait(sthread_pool_t *pool)
+{
+   if (pool_spin_zero(pool, &pool->pending))
+      return;
+
+   slock_lock(pool->lock);
+   satomic_add(&pool->sleeping_caller, 1);
+   while (satomic_load(&pool->pending))
+      scond_wait(pool->done_cond, pool->lock);
+   satomic_add(&pool->sleeping_caller, -1);
+   slock_unlock(pool->lock);
+}
+
+void sthread_pool_run(sthread_pool_t *pool, sthread_pool_job_t job, void *userdata, unsigned num_jobs)
+{
+   sthread_pool_start(pool, job, userdata, num_jobs);
+   sthread_pool_help(pool);
+   sthread_pool_wait(pool);
+}
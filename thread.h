@@ -49,4 +49,48 @@ bool scond_wait_timeout(scond_t *cond, slock_t *lock, int64_t timeout_us);
 int scond_broadcast(scond_t *cond);
 void scond_signal(scond_t *cond);
 
+// Pool of worker threads which run numbered jobs.
+// Every thread claims job after job until none are left, so threads which finish
+// early help out with the rest. The thread which starts jobs may claim them too.
+typedef struct sthread_pool sthread_pool_t;
+typedef void (*sthread_pool_job_t)(void *userdata, unsigned index);
+
+// Creates 'workers' threads. With 'spin', idle workers and a waiting caller poll for
+// a while before they go to sleep. This only pays off if every thread has a core of its own.
+sthread_pool_t *sthread_pool_new(unsigned workers, bool spin);
+void sthread_pool_free(sthread_pool_t *pool);
+unsigned sthread_pool_workers(const sthread_pool_t *pool);
+
+// Hands jobs [0, num_jobs) to the workers, and returns right away.
+// The previous jobs must have been waited for.
+void sthread_pool_start(sthread_pool_t *pool, sthread_pool_job_t job, void *userdata, unsigned num_jobs);
+// Runs jobs on the calling thread until all of them are claimed.
+void sthread_pool_help(sthread_pool_t *pool);
+// Blocks until every job handed out by sthread_pool_start() has finished.
+void sthread_pool_wait(sthread_pool_t *pool);
+// Runs jobs [0, num_jobs) on the workers and the calling thread, and waits for them.
+void sthread_pool_run(sthread_pool_t *pool, sthread_pool_job_t job, void *userdata, unsigned num_jobs);
+
+// Atomics on unsigned counters shared between threads. All of them are full barriers.
+static inline unsigned satomic_load(volatile unsigned *ptr)
+{
+   return __sync_add_and_fetch(ptr, 0);
+}
+
+// Returns the new value.
+static inline unsigned satomic_add(volatile unsigned *ptr, int val)
+{
+   return __sync_add_and_fetch(ptr, val);
+}
+
+// Returns the old value.
+// __sync_lock_test_and_set() would only be an acquire barrier.
+static inline unsigned satomic_swap(volatile unsigned *ptr, unsigned val)
+{
+   unsigned old = satomic_load(ptr), prev;
+   while ((prev = __sync_val_compare_and_swap(ptr, old, val)) != old)
+      old = prev;
+   return old;
+}
+
 #endif